@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#define DT_DRV_COMPAT adi_ds3231_counter
+
+#include <time.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(ds3231_counter, CONFIG_COUNTER_LOG_LEVEL);
+
+/* One channel per hardware alarm */
+#define DS3231_COUNTER_CHANNELS_MAX 2
+
+/* Alarm 2 has no seconds register and matches at the start of a minute */
+#define DS3231_COUNTER_A2_RES_S 60
+
+/*
+ * An alarm fires when the date, hours, minutes and seconds match, so a target more than the
+ * shortest month ahead first matches an earlier date. A match this much before the target
+ * is such an early one, rather than the time read lagging the chip.
+ */
+#define DS3231_COUNTER_EARLY_S 86400
+
+struct ds3231_counter_config {
+	struct counter_config_info info;
+	const struct device *parent;
+#ifdef CONFIG_COUNTER_DS3231_WAKEUP
+	/* Controller of the parent's int1-gpios, NULL without */
+	const struct device *int1_port;
+#endif /* CONFIG_COUNTER_DS3231_WAKEUP */
+};
+
+struct ds3231_counter_alarm {
+	counter_alarm_callback_t callback;
+	void *user_data;
+	/* Unix time the alarm is programmed to match */
+	int64_t target;
+};
+
+struct ds3231_counter_data {
+	struct k_mutex lock;
+	struct ds3231_counter_alarm alarms[DS3231_COUNTER_CHANNELS_MAX];
+};
+
+static void ds3231_counter_alarm_cfg(const struct ds3231_counter_alarm *alarm, uint16_t mask,
+				     struct ds3231_alarm_cfg *cfg)
+{
+	time_t seconds = alarm->target;
+
+	if (alarm->callback == NULL) {
+		return;
+	}
+
+	gmtime_r(&seconds, (struct tm *)&cfg->time);
+	cfg->mask = mask;
+	cfg->enable = true;
+}
+
+/* Program both channels in one transaction, called with the lock held */
+static int ds3231_counter_program(const struct device *dev)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	struct ds3231_counter_data *data = dev->data;
+	struct ds3231_alarm_cfg alarm1 = {0};
+	struct ds3231_alarm_cfg alarm2 = {0};
+
+	ds3231_counter_alarm_cfg(&data->alarms[0],
+				 RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+					 RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_MONTHDAY,
+				 &alarm1);
+	ds3231_counter_alarm_cfg(&data->alarms[1],
+				 RTC_ALARM_TIME_MASK_MINUTE | RTC_ALARM_TIME_MASK_HOUR |
+					 RTC_ALARM_TIME_MASK_MONTHDAY,
+				 &alarm2);
+
+	return ds3231_alarms_program(config->parent, &alarm1, &alarm2);
+}
+
+static void ds3231_counter_alarm_fired(const struct device *parent, uint16_t id, void *user_data)
+{
+	const struct device *dev = user_data;
+	struct ds3231_counter_data *data = dev->data;
+	struct ds3231_counter_alarm *alarm = &data->alarms[id];
+	counter_alarm_callback_t callback;
+	void *callback_data;
+	int64_t target;
+	int64_t now;
+	int err;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+
+	callback = alarm->callback;
+	if (callback == NULL) {
+		k_mutex_unlock(&data->lock);
+		return;
+	}
+
+	err = ds3231_get_epoch(parent, &now);
+	if (err == 0 && now + DS3231_COUNTER_EARLY_S < alarm->target) {
+		/* The registers still hold the target, they match again on its date */
+		k_mutex_unlock(&data->lock);
+		return;
+	}
+
+	callback_data = alarm->user_data;
+	target = alarm->target;
+	alarm->callback = NULL;
+	err = ds3231_counter_program(dev);
+	if (err != 0) {
+		LOG_ERR("failed to disable alarm %u (err %d)", id, err);
+	}
+
+	k_mutex_unlock(&data->lock);
+
+	callback(dev, id, (uint32_t)target, callback_data);
+}
+
+static int ds3231_counter_start(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	/* The oscillator runs from power-up */
+	return 0;
+}
+
+static int ds3231_counter_stop(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return -ENOTSUP;
+}
+
+static int ds3231_counter_get_value(const struct device *dev, uint32_t *ticks)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	int64_t seconds;
+	int err;
+
+	err = ds3231_get_epoch(config->parent, &seconds);
+	if (err != 0) {
+		return err;
+	}
+
+	/* Unix time modulo 2^32, which wraps in 2106 while the DS3231 counts up to 2199 */
+	*ticks = (uint32_t)seconds;
+
+	return 0;
+}
+
+static int ds3231_counter_set_alarm(const struct device *dev, uint8_t chan_id,
+				    const struct counter_alarm_cfg *alarm_cfg)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	struct ds3231_counter_data *data = dev->data;
+	struct ds3231_counter_alarm *alarm;
+	int64_t target;
+	int64_t now;
+	int err;
+
+	if (chan_id >= config->info.channels || alarm_cfg->callback == NULL) {
+		return -EINVAL;
+	}
+
+	alarm = &data->alarms[chan_id];
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+
+	if (alarm->callback != NULL) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	err = ds3231_get_epoch(config->parent, &now);
+	if (err != 0) {
+		goto out;
+	}
+
+	if ((alarm_cfg->flags & COUNTER_ALARM_CFG_ABSOLUTE) != 0U) {
+		/* Ticks within half the range after the current value are ahead, across a wrap */
+		target = now + (int32_t)(alarm_cfg->ticks - (uint32_t)now);
+	} else {
+		/* The current second started already, the earliest match is the next */
+		target = now + MAX(alarm_cfg->ticks, 1U);
+	}
+
+	if (target <= now) {
+		err = -ETIME;
+		if ((alarm_cfg->flags & COUNTER_ALARM_CFG_EXPIRE_WHEN_LATE) != 0U) {
+			k_mutex_unlock(&data->lock);
+			alarm_cfg->callback(dev, chan_id, (uint32_t)now, alarm_cfg->user_data);
+			return err;
+		}
+
+		goto out;
+	}
+
+	if (chan_id == 1U) {
+		target = ROUND_UP(target, DS3231_COUNTER_A2_RES_S);
+	}
+
+	alarm->callback = alarm_cfg->callback;
+	alarm->user_data = alarm_cfg->user_data;
+	alarm->target = target;
+
+	err = ds3231_counter_program(dev);
+	if (err != 0) {
+		alarm->callback = NULL;
+	}
+
+out:
+	k_mutex_unlock(&data->lock);
+
+	return err;
+}
+
+static int ds3231_counter_cancel_alarm(const struct device *dev, uint8_t chan_id)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	struct ds3231_counter_data *data = dev->data;
+	int err = 0;
+
+	if (chan_id >= config->info.channels) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+
+	if (data->alarms[chan_id].callback != NULL) {
+		data->alarms[chan_id].callback = NULL;
+		err = ds3231_counter_program(dev);
+	}
+
+	k_mutex_unlock(&data->lock);
+
+	return err;
+}
+
+static int ds3231_counter_set_top_value(const struct device *dev, const struct counter_top_cfg *cfg)
+{
+	ARG_UNUSED(dev);
+
+	/* Free-running over the whole 32 bits */
+	if (cfg->ticks != UINT32_MAX || cfg->callback != NULL) {
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+static uint32_t ds3231_counter_get_pending_int(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	/* Alarm interrupts are handled by the RTC driver */
+	return 0;
+}
+
+static uint32_t ds3231_counter_get_top_value(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return UINT32_MAX;
+}
+
+static const struct counter_driver_api ds3231_counter_driver_api = {
+	.start = ds3231_counter_start,
+	.stop = ds3231_counter_stop,
+	.get_value = ds3231_counter_get_value,
+	.set_alarm = ds3231_counter_set_alarm,
+	.cancel_alarm = ds3231_counter_cancel_alarm,
+	.set_top_value = ds3231_counter_set_top_value,
+	.get_pending_int = ds3231_counter_get_pending_int,
+	.get_top_value = ds3231_counter_get_top_value,
+};
+
+#ifdef CONFIG_COUNTER_DS3231_WAKEUP
+/* The DS3231 keeps matching its alarms while the system sleeps, its INT line wakes it */
+static int ds3231_counter_pm_action(const struct device *dev, enum pm_device_action action)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	struct ds3231_counter_data *data = dev->data;
+	bool enable = false;
+
+	switch (action) {
+	case PM_DEVICE_ACTION_SUSPEND:
+		for (uint8_t i = 0; i < config->info.channels; i++) {
+			enable |= data->alarms[i].callback != NULL;
+		}
+		break;
+	case PM_DEVICE_ACTION_RESUME:
+		break;
+	default:
+		return -ENOTSUP;
+	}
+
+	if (config->int1_port == NULL || !pm_device_wakeup_is_capable(config->int1_port)) {
+		return 0;
+	}
+
+	if (!pm_device_wakeup_enable(config->int1_port, enable)) {
+		LOG_WRN("failed to %s wakeup on INT", enable ? "enable" : "disable");
+	}
+
+	return 0;
+}
+#endif /* CONFIG_COUNTER_DS3231_WAKEUP */
+
+static int ds3231_counter_init(const struct device *dev)
+{
+	const struct ds3231_counter_config *config = dev->config;
+	struct ds3231_counter_data *data = dev->data;
+	int err;
+
+	if (!device_is_ready(config->parent)) {
+		LOG_ERR("parent RTC device not ready");
+		return -ENODEV;
+	}
+
+	k_mutex_init(&data->lock);
+
+	for (uint8_t i = 0; i < config->info.channels; i++) {
+		err = rtc_alarm_set_callback(config->parent, i, ds3231_counter_alarm_fired,
+					     (void *)dev);
+		if (err != 0) {
+			LOG_ERR("alarm %u callback not available (err %d)", i, err);
+			return err;
+		}
+	}
+
+#ifdef CONFIG_COUNTER_DS3231_WAKEUP
+	if (config->int1_port != NULL && !pm_device_wakeup_is_capable(config->int1_port)) {
+		LOG_WRN("%s is not a wakeup source", config->int1_port->name);
+	}
+#endif /* CONFIG_COUNTER_DS3231_WAKEUP */
+
+	return 0;
+}
+
+#define DS3231_COUNTER_INT1_PORT(inst)                                                             \
+	COND_CODE_1(DT_NODE_HAS_PROP(DT_INST_PARENT(inst), int1_gpios),                            \
+		    (DEVICE_DT_GET(DT_GPIO_CTLR(DT_INST_PARENT(inst), int1_gpios))), (NULL))
+
+#define DS3231_COUNTER_INIT(inst)                                                                  \
+	static const struct ds3231_counter_config ds3231_counter_config_##inst = {                 \
+		.info =                                                                            \
+			{                                                                          \
+				.max_top_value = UINT32_MAX,                                       \
+				.freq = 1,                                                         \
+				.flags = COUNTER_CONFIG_INFO_COUNT_UP,                             \
+				.channels = MIN(DT_PROP_OR(DT_INST_PARENT(inst), alarms_count, 0), \
+						DS3231_COUNTER_CHANNELS_MAX),                      \
+			},                                                                         \
+		.parent = DEVICE_DT_GET(DT_INST_PARENT(inst)),                                     \
+		IF_ENABLED(CONFIG_COUNTER_DS3231_WAKEUP,                                           \
+			   (.int1_port = DS3231_COUNTER_INT1_PORT(inst),))                         \
+	};                                                                                         \
+                                                                                                   \
+	static struct ds3231_counter_data ds3231_counter_data_##inst;                              \
+                                                                                                   \
+	IF_ENABLED(CONFIG_COUNTER_DS3231_WAKEUP,                                                   \
+		   (PM_DEVICE_DT_INST_DEFINE(inst, ds3231_counter_pm_action);))                    \
+                                                                                                   \
+	DEVICE_DT_INST_DEFINE(inst, &ds3231_counter_init,                                          \
+			      COND_CODE_1(CONFIG_COUNTER_DS3231_WAKEUP,                            \
+					  (PM_DEVICE_DT_INST_GET(inst)), (NULL)),                  \
+			      &ds3231_counter_data_##inst, &ds3231_counter_config_##inst,          \
+			      POST_KERNEL, CONFIG_COUNTER_DS3231_INIT_PRIORITY,                    \
+			      &ds3231_counter_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(DS3231_COUNTER_INIT)
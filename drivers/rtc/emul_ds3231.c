@@ -0,0 +1,543 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#define DT_DRV_COMPAT adi_ds3231
+
+/*
+ * I2C emulator of the DS3231 register file. The time registers count seconds from a
+ * kernel timer, scaled by the injected drift and the aging offset, and carry into
+ * minutes up to the century bit. Alarm matches set A1F/A2F, and INT/SQW drives the
+ * int1-gpios pin when it is on a GPIO emulator. Temperature conversions finish at once.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "rtc_ds3231_codec.h"
+
+LOG_MODULE_REGISTER(emul_ds3231, CONFIG_RTC_LOG_LEVEL);
+
+#define DS3231_EMUL_REG_SECONDS  0x00U
+#define DS3231_EMUL_REG_ALARM_1  0x07U
+#define DS3231_EMUL_REG_ALARM_2  0x0bU
+#define DS3231_EMUL_REG_CONTROL  0x0eU
+#define DS3231_EMUL_REG_STATUS   0x0fU
+#define DS3231_EMUL_REG_AGING    0x10U
+#define DS3231_EMUL_REG_TEMP_MSB 0x11U
+#define DS3231_EMUL_REG_TEMP_LSB 0x12U
+#define DS3231_EMUL_REGS         0x13U
+
+#define DS3231_EMUL_CONTROL_A1IE   BIT(0)
+#define DS3231_EMUL_CONTROL_A2IE   BIT(1)
+#define DS3231_EMUL_CONTROL_INTCN  BIT(2)
+#define DS3231_EMUL_CONTROL_CONV   BIT(5)
+#define DS3231_EMUL_STATUS_A1F     BIT(0)
+#define DS3231_EMUL_STATUS_A2F     BIT(1)
+#define DS3231_EMUL_STATUS_BSY     BIT(2)
+#define DS3231_EMUL_STATUS_EN32KHZ BIT(3)
+#define DS3231_EMUL_STATUS_OSF     BIT(7)
+#define DS3231_EMUL_STATUS_FLAGS                                                                   \
+	(DS3231_EMUL_STATUS_OSF | DS3231_EMUL_STATUS_A2F | DS3231_EMUL_STATUS_A1F)
+
+/* Power-on defaults: INTCN set, 1 Hz, 32 kHz output on, oscillator stop flagged */
+#define DS3231_EMUL_CONTROL_POR 0x1cU
+#define DS3231_EMUL_STATUS_POR  0x88U
+
+/* Frequency change per aging offset step */
+#define DS3231_EMUL_PPB_PER_AGING 100
+
+/* The timer runs at 2 Hz, seconds increment on even half periods */
+#define DS3231_EMUL_HALF_PERIOD_NS (NSEC_PER_SEC / 2)
+
+struct ds3231_emul_config {
+	struct gpio_dt_spec int1;
+};
+
+struct ds3231_emul_data {
+	const struct emul *target;
+	struct k_spinlock lock;
+	struct k_timer timer;
+	uint8_t regs[DS3231_EMUL_REGS];
+	uint8_t ptr;
+	bool second_half;
+	int32_t drift_ppb;
+	/* SCL frequency the transfers take time for, 0 for instant transfers */
+	uint32_t bus_hz;
+	/* Transfers still to fail, and their error */
+	uint32_t fault_count;
+	int fault_err;
+	/* Uptime of the last half period boundary and the remainder of its division */
+	int64_t event_ns;
+	uint64_t event_rem;
+	struct emul_ds3231_stats stats;
+};
+
+static int64_t ds3231_emul_uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+static uint8_t ds3231_emul_bcd_inc(uint8_t bcd)
+{
+	return ((bcd & 0x0fU) == 9U) ? (bcd & 0xf0U) + 0x10U : bcd + 1U;
+}
+
+static uint8_t ds3231_emul_month_days(uint8_t month, uint8_t year)
+{
+	static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	/* Like the chip, every fourth year is a leap year */
+	if (month == 2U && (year % 4U) == 0U) {
+		return 29U;
+	}
+
+	return days[month - 1U];
+}
+
+static void ds3231_emul_tick_date(uint8_t *regs)
+{
+	uint8_t month = ds3231_bcd2bin(regs[5] & (DS3231_MONTH_10 | DS3231_MONTHS_MASK));
+	uint8_t year = ds3231_bcd2bin(regs[6]);
+
+	regs[3] = (regs[3] & DS3231_DAYS_MASK) >= 7U ? 1U : regs[3] + 1U;
+
+	if (ds3231_bcd2bin(regs[4]) < ds3231_emul_month_days(month, year)) {
+		regs[4] = ds3231_emul_bcd_inc(regs[4]);
+		return;
+	}
+
+	regs[4] = 0x01U;
+	if (month < 12U) {
+		regs[5] = (regs[5] & DS3231_MONTH_CENTURY) | ds3231_bin2bcd(month + 1U);
+		return;
+	}
+
+	regs[5] = (regs[5] & DS3231_MONTH_CENTURY) | 0x01U;
+	if (year < 99U) {
+		regs[6] = ds3231_emul_bcd_inc(regs[6]);
+		return;
+	}
+
+	regs[6] = 0x00U;
+	regs[5] ^= DS3231_MONTH_CENTURY;
+}
+
+static void ds3231_emul_tick_hour(uint8_t *regs)
+{
+	uint8_t hours = regs[2];
+	uint8_t hour;
+
+	if ((hours & DS3231_HOURS_12_24) == 0U) {
+		if (hours == 0x23U) {
+			regs[2] = 0x00U;
+			ds3231_emul_tick_date(regs);
+		} else {
+			regs[2] = ds3231_emul_bcd_inc(hours);
+		}
+		return;
+	}
+
+	/* 12 hour mode counts 12, 1, ... 11 and toggles PM going from 11 to 12 */
+	hour = ds3231_bcd2bin(hours & (DS3231_HOURS_10 | DS3231_HOURS_MASK));
+	if (hour == 11U) {
+		regs[2] = (hours ^ DS3231_HOURS_AM_PM_20) & ~(DS3231_HOURS_10 | DS3231_HOURS_MASK);
+		regs[2] |= 0x12U;
+		if ((regs[2] & DS3231_HOURS_AM_PM_20) == 0U) {
+			ds3231_emul_tick_date(regs);
+		}
+	} else {
+		regs[2] = (hours & (DS3231_HOURS_12_24 | DS3231_HOURS_AM_PM_20)) |
+			  ds3231_bin2bcd(hour == 12U ? 1U : hour + 1U);
+	}
+}
+
+static void ds3231_emul_tick_second(uint8_t *regs)
+{
+	if (regs[0] != 0x59U) {
+		regs[0] = ds3231_emul_bcd_inc(regs[0]);
+		return;
+	}
+
+	regs[0] = 0x00U;
+	if (regs[1] != 0x59U) {
+		regs[1] = ds3231_emul_bcd_inc(regs[1]);
+		return;
+	}
+
+	regs[1] = 0x00U;
+	ds3231_emul_tick_hour(regs);
+}
+
+/* Compare one alarm register against a time register, unless its mask bit is set */
+static bool ds3231_emul_field_match(uint8_t alarm, uint8_t time)
+{
+	return (alarm & DS3231_ALARM_MATCH_DISABLE) != 0U ||
+	       (alarm & ~DS3231_ALARM_MATCH_DISABLE) == time;
+}
+
+/* Match minutes, hours and day or date, laid out alike for both alarms */
+static bool ds3231_emul_alarm_match(const uint8_t *alarm, const uint8_t *regs)
+{
+	uint8_t day_date = alarm[2];
+
+	if (!ds3231_emul_field_match(alarm[0], regs[1]) ||
+	    !ds3231_emul_field_match(alarm[1], regs[2])) {
+		return false;
+	}
+
+	if ((day_date & DS3231_ALARM_MATCH_DISABLE) != 0U) {
+		return true;
+	}
+
+	if ((day_date & DS3231_ALARM_1_DAY_DATE_DYDT) != 0U) {
+		return (day_date & DS3231_DAYS_MASK) == regs[3];
+	}
+
+	return (day_date & (DS3231_DATE_10 | DS3231_DATE_MASK)) == regs[4];
+}
+
+static void ds3231_emul_check_alarms(struct ds3231_emul_data *data)
+{
+	const uint8_t *a1 = &data->regs[DS3231_EMUL_REG_ALARM_1];
+	const uint8_t *a2 = &data->regs[DS3231_EMUL_REG_ALARM_2];
+
+	if (ds3231_emul_field_match(a1[0], data->regs[0]) &&
+	    ds3231_emul_alarm_match(&a1[1], data->regs)) {
+		data->regs[DS3231_EMUL_REG_STATUS] |= DS3231_EMUL_STATUS_A1F;
+	}
+
+	/* Alarm 2 has no seconds register and matches at 00 seconds */
+	if (data->regs[0] == 0x00U && ds3231_emul_alarm_match(a2, data->regs)) {
+		data->regs[DS3231_EMUL_REG_STATUS] |= DS3231_EMUL_STATUS_A2F;
+	}
+}
+
+/* Drive INT/SQW, a no-op until the driver configured the pin as input */
+static void ds3231_emul_update_int(const struct emul *target)
+{
+	const struct ds3231_emul_config *config = target->cfg;
+	struct ds3231_emul_data *data = target->data;
+	uint8_t control = data->regs[DS3231_EMUL_REG_CONTROL];
+	uint8_t status = data->regs[DS3231_EMUL_REG_STATUS];
+	bool active;
+
+	if (!IS_ENABLED(CONFIG_GPIO_EMUL) || config->int1.port == NULL) {
+		return;
+	}
+
+	if ((control & DS3231_EMUL_CONTROL_INTCN) == 0U) {
+		/* 1 Hz square wave, low for the first half of each second */
+		active = !data->second_half;
+	} else {
+		active = ((control & DS3231_EMUL_CONTROL_A1IE) != 0U &&
+			  (status & DS3231_EMUL_STATUS_A1F) != 0U) ||
+			 ((control & DS3231_EMUL_CONTROL_A2IE) != 0U &&
+			  (status & DS3231_EMUL_STATUS_A2F) != 0U);
+	}
+
+	/* INT/SQW is open-drain and active low */
+	(void)gpio_emul_input_set(config->int1.port, config->int1.pin, active ? 0 : 1);
+}
+
+/* Schedule the next half period boundary, at the rate set by drift and aging offset */
+static void ds3231_emul_schedule(struct ds3231_emul_data *data)
+{
+	int64_t ppb = data->drift_ppb - (int64_t)(int8_t)data->regs[DS3231_EMUL_REG_AGING] *
+						DS3231_EMUL_PPB_PER_AGING;
+	uint64_t den = NSEC_PER_SEC + ppb;
+
+	/* half period * 10^9 / (10^9 + ppb), carrying the remainder to the next one */
+	data->event_rem += (uint64_t)DS3231_EMUL_HALF_PERIOD_NS * NSEC_PER_SEC;
+	data->event_ns += data->event_rem / den;
+	data->event_rem %= den;
+
+	k_timer_start(&data->timer, K_TIMEOUT_ABS_NS(data->event_ns), K_NO_WAIT);
+}
+
+/* Writing the seconds register resets the countdown chain, delay_ns into the transfer */
+static void ds3231_emul_restart(struct ds3231_emul_data *data, int64_t delay_ns)
+{
+	data->event_ns = ds3231_emul_uptime_ns() + delay_ns;
+	data->event_rem = 0U;
+	data->second_half = false;
+	ds3231_emul_schedule(data);
+}
+
+static void ds3231_emul_timer_handler(struct k_timer *timer)
+{
+	struct ds3231_emul_data *data = CONTAINER_OF(timer, struct ds3231_emul_data, timer);
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	data->second_half = !data->second_half;
+	if (!data->second_half) {
+		ds3231_emul_tick_second(data->regs);
+		ds3231_emul_check_alarms(data);
+	}
+
+	ds3231_emul_update_int(data->target);
+	ds3231_emul_schedule(data);
+
+	k_spin_unlock(&data->lock, key);
+}
+
+static void ds3231_emul_write_reg(struct ds3231_emul_data *data, uint8_t reg, uint8_t value)
+{
+	uint8_t *regs = data->regs;
+
+	switch (reg) {
+	case DS3231_EMUL_REG_CONTROL:
+		/* Conversions complete instantly */
+		regs[reg] = value & ~DS3231_EMUL_CONTROL_CONV;
+		break;
+	case DS3231_EMUL_REG_STATUS:
+		/* Flags can only be cleared, BSY is read-only */
+		regs[reg] = (regs[reg] & value & DS3231_EMUL_STATUS_FLAGS) |
+			    (regs[reg] & DS3231_EMUL_STATUS_BSY) |
+			    (value & DS3231_EMUL_STATUS_EN32KHZ);
+		break;
+	case DS3231_EMUL_REG_AGING:
+		regs[reg] = value;
+		/* Takes effect with the next conversion, which is immediate here */
+		data->event_rem = 0U;
+		break;
+	case DS3231_EMUL_REG_TEMP_MSB:
+	case DS3231_EMUL_REG_TEMP_LSB:
+		break;
+	default:
+		regs[reg] = value;
+		break;
+	}
+}
+
+static int ds3231_emul_transfer(const struct emul *target, struct i2c_msg *msgs, int num_msgs,
+				int addr)
+{
+	struct ds3231_emul_data *data = target->data;
+	bool restart = false;
+	bool addressed = false;
+	uint32_t restart_bytes = 0U;
+	uint32_t bus_hz;
+	uint32_t bytes = 0U;
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(addr);
+
+	key = k_spin_lock(&data->lock);
+
+	data->stats.transactions++;
+
+	if (data->fault_count > 0U) {
+		int err = data->fault_err;
+
+		if (data->fault_count != UINT32_MAX) {
+			data->fault_count--;
+		}
+		bus_hz = data->bus_hz;
+		k_spin_unlock(&data->lock, key);
+
+		/* The address byte went unacknowledged */
+		if (bus_hz != 0U) {
+			k_busy_wait(9U * USEC_PER_SEC / bus_hz);
+		}
+
+		return err;
+	}
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+		uint32_t j = 0U;
+
+		data->stats.messages++;
+
+		/* Each START or RESTART is followed by the address byte */
+		if (i == 0 || (msg->flags & I2C_MSG_RESTART) != 0U) {
+			bytes++;
+		}
+
+		if ((msg->flags & I2C_MSG_READ) != 0U) {
+			data->stats.bytes_read += msg->len;
+			for (; j < msg->len; j++) {
+				msg->buf[j] = data->regs[data->ptr];
+				data->ptr = (data->ptr + 1U) % DS3231_EMUL_REGS;
+			}
+			bytes += msg->len;
+			addressed = false;
+			continue;
+		}
+
+		data->stats.bytes_written += msg->len;
+
+		/* The first byte after (RE)START is the register address */
+		if (!addressed || (msg->flags & I2C_MSG_RESTART) != 0U) {
+			if (msg->len == 0U) {
+				continue;
+			}
+
+			if (msg->buf[0] >= DS3231_EMUL_REGS) {
+				k_spin_unlock(&data->lock, key);
+				LOG_ERR("register 0x%02x out of range", msg->buf[0]);
+				return -EIO;
+			}
+
+			data->ptr = msg->buf[j++];
+			addressed = true;
+		}
+
+		for (; j < msg->len; j++) {
+			if (data->ptr == DS3231_EMUL_REG_SECONDS) {
+				restart = true;
+				restart_bytes = bytes + j + 1U;
+			}
+
+			ds3231_emul_write_reg(data, data->ptr, msg->buf[j]);
+			data->ptr = (data->ptr + 1U) % DS3231_EMUL_REGS;
+		}
+
+		bytes += msg->len;
+	}
+
+	bus_hz = data->bus_hz;
+
+	/* The chain restarts once the seconds byte is clocked in, nine clocks per byte */
+	if (restart) {
+		ds3231_emul_restart(data, (bus_hz != 0U)
+						  ? (int64_t)restart_bytes * 9 * NSEC_PER_SEC / bus_hz
+						  : 0);
+	}
+
+	ds3231_emul_update_int(target);
+
+	k_spin_unlock(&data->lock, key);
+
+	/* Nine clocks per byte, ISRs and threads they wake may preempt the transfer */
+	if (bus_hz != 0U) {
+		k_busy_wait((uint64_t)bytes * 9U * USEC_PER_SEC / bus_hz);
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api ds3231_emul_api_i2c = {
+	.transfer = ds3231_emul_transfer,
+};
+
+void emul_ds3231_get_stats(const struct emul *target, struct emul_ds3231_stats *stats)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	*stats = data->stats;
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_reset_stats(const struct emul *target)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	memset(&data->stats, 0, sizeof(data->stats));
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_set_drift(const struct emul *target, int32_t ppb)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	/* Applies from the next half period on */
+	data->drift_ppb = ppb;
+	data->event_rem = 0U;
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_set_temp(const struct emul *target, int32_t temp_mdegc)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+	int32_t quarters = temp_mdegc / 250;
+
+	/* Two's complement, degrees in the MSB and quarter degrees in bits 7:6 of the LSB */
+	data->regs[DS3231_EMUL_REG_TEMP_MSB] = (uint8_t)(quarters >> 2);
+	data->regs[DS3231_EMUL_REG_TEMP_LSB] = (uint8_t)((quarters & 0x3) << 6);
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_set_bus_speed(const struct emul *target, uint32_t hz)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	data->bus_hz = hz;
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_inject_fault(const struct emul *target, uint32_t count, int err)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	data->fault_count = count;
+	data->fault_err = err;
+
+	k_spin_unlock(&data->lock, key);
+}
+
+void emul_ds3231_stop_osc(const struct emul *target)
+{
+	struct ds3231_emul_data *data = target->data;
+	k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+	data->regs[DS3231_EMUL_REG_STATUS] |= DS3231_EMUL_STATUS_OSF;
+
+	k_spin_unlock(&data->lock, key);
+}
+
+static int ds3231_emul_init(const struct emul *target, const struct device *parent)
+{
+	struct ds3231_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	data->target = target;
+	memset(data->regs, 0, sizeof(data->regs));
+
+	/* Power-on state: 2000-01-01 00:00:00, a Saturday */
+	data->regs[3] = 6U;
+	data->regs[4] = 0x01U;
+	data->regs[5] = 0x01U;
+	data->regs[DS3231_EMUL_REG_CONTROL] = DS3231_EMUL_CONTROL_POR;
+	data->regs[DS3231_EMUL_REG_STATUS] = DS3231_EMUL_STATUS_POR;
+	emul_ds3231_set_temp(target, 25000);
+
+	k_timer_init(&data->timer, ds3231_emul_timer_handler, NULL);
+	ds3231_emul_restart(data, 0);
+
+	return 0;
+}
+
+#define DS3231_EMUL(inst)                                                                          \
+	static const struct ds3231_emul_config ds3231_emul_config_##inst = {                       \
+		.int1 = GPIO_DT_SPEC_INST_GET_OR(inst, int1_gpios, {0}),                           \
+	};                                                                                         \
+                                                                                                   \
+	static struct ds3231_emul_data ds3231_emul_data_##inst;                                    \
+                                                                                                   \
+	EMUL_DT_INST_DEFINE(inst, ds3231_emul_init, &ds3231_emul_data_##inst,                      \
+			    &ds3231_emul_config_##inst, &ds3231_emul_api_i2c, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(DS3231_EMUL)
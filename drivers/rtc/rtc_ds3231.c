@@ -8,8 +8,20 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/stats/stats.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/rb.h>
 #include <zephyr/sys/util.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rtc_ds3231_codec.h"
 
 #define PRINTF_BINARY_PATTERN_INT8 "%c%c%c%c%c%c%c%c"
 #define PRINTF_BYTE_TO_BINARY_INT8(i)                                                              \
@@ -51,51 +63,6 @@ LOG_MODULE_REGISTER(ds3231, CONFIG_RTC_LOG_LEVEL);
 #define DS3231_ALARM_2_DAY_DATE 0x0dU
 
 /* Time and date register bits */
-#define DS3231_SECONDS_10                GENMASK(6, 4)
-#define DS3231_SECONDS_MASK              GENMASK(3, 0)
-#define DS3231_MINUTES_10                GENMASK(6, 4)
-#define DS3231_MINUTES_MASK              GENMASK(3, 0)
-#define DS3231_HOURS_12_24               BIT(6)
-#define DS3231_HOURS_AM_PM_20            BIT(5)
-#define DS3231_HOURS_10                  BIT(4)
-#define DS3231_HOURS_MASK                GENMASK(3, 0)
-#define DS3231_DAYS_MASK                 GENMASK(2, 0)
-#define DS3231_DATE_10                   GENMASK(5, 4)
-#define DS3231_DATE_MASK                 GENMASK(3, 0)
-#define DS3231_MONTH_CENTURY             BIT(7)
-#define DS3231_MONTH_10                  BIT(4)
-#define DS3231_MONTHS_MASK               GENMASK(3, 0)
-#define DS3231_YEAR_10                   GENMASK(7, 4)
-#define DS3231_YEARS_MASK                GENMASK(3, 0)
-#define DS3231_ALARM_1_SECONDS_A1M1      BIT(7)
-#define DS3231_ALARM_1_SECONDS_10        GENMASK(6, 4)
-#define DS3231_ALARM_1_SECONDS_SECONDS   GENMASK(3, 0)
-#define DS3231_ALARM_1_MINUTES_A1M2      BIT(7)
-#define DS3231_ALARM_1_MINUTES_10        GENMASK(6, 4)
-#define DS3231_ALARM_1_MINUTES_MINUTES   GENMASK(3, 0)
-#define DS3231_ALARM_1_HOURS_A1M3        BIT(7)
-#define DS3231_ALARM_1_HOURS_12_24       BIT(6)
-#define DS3231_ALARM_1_HOURS_AM_PM_20    BIT(5)
-#define DS3231_ALARM_1_HOURS_10          BIT(4)
-#define DS3231_ALARM_1_HOURS_HOURS       GENMASK(3, 0)
-#define DS3231_ALARM_1_DAY_DATE_A1M4     BIT(7)
-#define DS3231_ALARM_1_DAY_DATE_DYDT     BIT(6)
-#define DS3231_ALARM_1_DAY_DATE_10       GENMASK(5, 4)
-#define DS3231_ALARM_1_DAY_DATE_MASK     GENMASK(3, 0)
-
-#define DS3231_ALARM_2_MINUTES_A2M2    BIT(7)
-#define DS3231_ALARM_2_MINUTES_10      GENMASK(6, 4)
-#define DS3231_ALARM_2_MINUTES_MINUTES GENMASK(3, 0)
-#define DS3231_ALARM_2_HOURS_A2M3      BIT(7)
-#define DS3231_ALARM_2_HOURS_12_24     BIT(6)
-#define DS3231_ALARM_2_HOURS_AM_PM_20  BIT(5)
-#define DS3231_ALARM_2_HOURS_10        BIT(4)
-#define DS3231_ALARM_2_HOURS_HOURS     GENMASK(3, 0)
-#define DS3231_ALARM_2_DAY_DATE_A2M4   BIT(7)
-#define DS3231_ALARM_2_DAY_DATE_DYDT   BIT(6)
-#define DS3231_ALARM_2_DAY_DATE_10     GENMASK(5, 4)
-#define DS3231_ALARM_2_DAY_DATE_MASK   GENMASK(3, 0)
-
 #define DS3231_CONTROL_EOSC  BIT(7)
 #define DS3231_CONTROL_BBSQW BIT(6)
 #define DS3231_CONTROL_CONV  BIT(5)
@@ -110,6 +77,7 @@ LOG_MODULE_REGISTER(ds3231, CONFIG_RTC_LOG_LEVEL);
 #define DS3231_STATUS_BSY     BIT(2)
 #define DS3231_STATUS_A2F     BIT(1)
 #define DS3231_STATUS_A1F     BIT(0)
+#define DS3231_STATUS_FLAGS   (DS3231_STATUS_OSF | DS3231_STATUS_A2F | DS3231_STATUS_A1F)
 
 #define DS3231_AGING_OFFSET_SIGN BIT(7)
 #define DS3231_AGING_OFFSET_DATA GENMASK(6, 0)
@@ -126,424 +94,3783 @@ LOG_MODULE_REGISTER(ds3231, CONFIG_RTC_LOG_LEVEL);
 	(RTC_ALARM_TIME_MASK_MINUTE | RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_WEEKDAY |     \
 	 RTC_ALARM_TIME_MASK_MONTHDAY)
 
-/* The DS3231 enumerates months 1 to 12, RTC API uses 0 to 11 */
-#define DS3231_MONTHS_OFFSET 1
+/* CONTROL, STATUS and AGING_OFFSET are shadowed in register order */
+#define DS3231_SHADOW_IDX(addr) ((addr) - DS3231_CONTROL)
+#define DS3231_SHADOW_SIZE      (DS3231_AGING_OFFSET - DS3231_CONTROL + 1)
 
-/* The DS3231 only supports two-digit years, calculate offset to use */
-#define DS3231_YEARS_OFFSET (2000 - 1900)
+/* Alarm 1 and alarm 2 are cached in register order */
+#define DS3231_ALARM_IDX(addr) ((addr) - DS3231_ALARM_1_SECONDS)
+#define DS3231_ALARM_REGS      (DS3231_CONTROL - DS3231_ALARM_1_SECONDS)
+
+/* Aligned time writes sleep until this close to the write, then busy wait */
+#define DS3231_ALIGN_BUSY_WAIT_NS ((int64_t)2 * NSEC_PER_MSEC)
+/* The seconds edge after an aligned write is looked for this far either side of the target */
+#define DS3231_ALIGN_WINDOW_NS    ((int64_t)10 * NSEC_PER_MSEC)
+/* Pause between time reads while looking for the edge */
+#define DS3231_ALIGN_POLL_US      100
 
 /* Macro for interrupt pin code */
-#if DT_ANY_INST_HAS_PROP_STATUS_OKAY(int1_gpios)
+#if DT_ANY_INST_HAS_PROP_STATUS_OKAY(int1_gpios) &&                                               \
+	(defined(CONFIG_RTC_ALARM) || defined(CONFIG_RTC_UPDATE))
 #define DS3231_INT1_GPIOS_IN_USE 1
 #endif
 
+#if DS3231_INT1_GPIOS_IN_USE
+static int ds3231_int1_enable(const struct device *dev);
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+
+/* interrupt-mode enum indices */
+#define DS3231_INT_MODE_ALARM_UPDATE 0
+#define DS3231_INT_MODE_ALARM        1
+#define DS3231_INT_MODE_UPDATE       2
+
+/* Instances with INT/SQW wired that take update callbacks */
+#define DS3231_INST_UPDATE(inst)                                                                   \
+	|| (DT_INST_NODE_HAS_PROP(inst, int1_gpios) &&                                             \
+	    DT_INST_ENUM_IDX(inst, interrupt_mode) != DS3231_INT_MODE_ALARM)
+
+#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_UPDATE) &&                                    \
+	(0 DT_INST_FOREACH_STATUS_OKAY(DS3231_INST_UPDATE))
+#define DS3231_UPDATE_IN_USE 1
+#endif
+
+/* Instances with a time cache, see time-cache-resync-ms */
+#define DS3231_INST_TIME_CACHE(inst) || DT_INST_PROP_OR(inst, time_cache_resync_ms, 1) != 0
+
+#if defined(CONFIG_RTC_DS3231_TIME_CACHE) &&                                                     \
+	(0 DT_INST_FOREACH_STATUS_OKAY(DS3231_INST_TIME_CACHE))
+#define DS3231_TIME_CACHE_IN_USE 1
+#endif
+
+#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_ALARM) && defined(CONFIG_RTC_DS3231_VALARM)
+#define DS3231_VALARM_IN_USE 1
+
+#define DS3231_VALARM_DISARMED INT64_MIN
+
+/* Reasons to check the virtual alarms for due ones, or'ed into valarm_kick */
+#define DS3231_VALARM_KICK       BIT(0)
+#define DS3231_VALARM_KICK_ALARM BIT(1)
+#endif
+
+/* 1 Hz square wave edges are timestamped as calibration reference */
+#if defined(DS3231_UPDATE_IN_USE) && defined(CONFIG_RTC_DS3231_CALIBRATION)
+#define DS3231_SQW_EDGES_IN_USE 1
+#endif
+
+/* 1 Hz square wave edges are timestamped with the cycle counter for sub-second time */
+#if defined(DS3231_UPDATE_IN_USE) && defined(CONFIG_RTC_DS3231_TIMESTAMP)
+#define DS3231_TIMESTAMP_IN_USE 1
+
+/* Fraction bits of the averaged square wave period in cycles */
+#define DS3231_TS_FRAC_BITS 16
+
+/* Edge intervals further than this from whole seconds of the nominal clock are glitches */
+#define DS3231_TS_TOLERANCE_PPM 10000
+
+/* Weight of a new period in the running average, as a power of two */
+#define DS3231_TS_AVG_SHIFT 3
+#endif
+
 struct ds3231_config {
 	const struct i2c_dt_spec i2c;
+#ifdef CONFIG_RTC_DS3231_GROUP
+	/* Controller of the bus, the parent bus when the instance is behind an I2C mux */
+	const struct device *root_bus;
+#endif /* CONFIG_RTC_DS3231_GROUP */
+	/* CONTROL and STATUS bits set from devicetree, and which bits those are */
+	uint8_t control;
+	uint8_t control_mask;
+	uint8_t status;
+	uint8_t status_mask;
+	/* Aging offset programmed when the chip lost power */
+	bool aging_offset_set;
+	int8_t aging_offset;
+#ifdef DS3231_TIME_CACHE_IN_USE
+	/* Time cache resync interval, 0 when this instance is not cached */
+	uint32_t cache_resync_ms;
+#endif /* DS3231_TIME_CACHE_IN_USE */
 
 #ifdef DS3231_INT1_GPIOS_IN_USE
 	struct gpio_dt_spec int1;
+	/* Events delivered through INT1, DS3231_INT_MODE_* */
+	uint8_t int1_mode;
+#ifdef CONFIG_RTC_DS3231_INT_OWN_THREAD
+	/* Only instances with int1-gpios have a thread stack */
+	k_thread_stack_t *int1_stack;
+#endif /* CONFIG_RTC_DS3231_INT_OWN_THREAD */
 #endif /* DS3231_INT1_GPIOS_IN_USE */
 };
+#ifdef CONFIG_RTC_DS3231_STATS
+STATS_SECT_START(ds3231)
+STATS_SECT_ENTRY32(transactions)
+STATS_SECT_ENTRY32(bytes_written)
+STATS_SECT_ENTRY32(bytes_read)
+STATS_SECT_ENTRY32(errors)
+STATS_SECT_ENTRY32(retries)
+STATS_SECT_ENTRY32(recoveries)
+STATS_SECT_ENTRY32(reloads)
+STATS_SECT_ENTRY32(cache_hits)
+STATS_SECT_ENTRY32(cache_misses)
+STATS_SECT_ENTRY32(interrupts)
+STATS_SECT_ENTRY32(alarms)
+STATS_SECT_END;
+
+STATS_NAME_START(ds3231)
+STATS_NAME(ds3231, transactions)
+STATS_NAME(ds3231, bytes_written)
+STATS_NAME(ds3231, bytes_read)
+STATS_NAME(ds3231, errors)
+STATS_NAME(ds3231, retries)
+STATS_NAME(ds3231, recoveries)
+STATS_NAME(ds3231, reloads)
+STATS_NAME(ds3231, cache_hits)
+STATS_NAME(ds3231, cache_misses)
+STATS_NAME(ds3231, interrupts)
+STATS_NAME(ds3231, alarms)
+STATS_NAME_END(ds3231);
+
+#define DS3231_STATS_INC(data, var)     STATS_INC((data)->stats, var)
+#define DS3231_STATS_INCN(data, var, n) STATS_INCN((data)->stats, var, n)
+#else
+#define DS3231_STATS_INC(data, var)
+#define DS3231_STATS_INCN(data, var, n)
+#endif /* CONFIG_RTC_DS3231_STATS */
+
 struct ds3231_data {
+	const struct device *dev;
 	struct k_mutex lock;
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	struct k_spinlock queue_lock;
+	sys_slist_t queue;
+	/* Transfers that cannot start from the caller or the I2C callback */
+	struct k_work_delayable xfer_work;
+	/* The bus has no callback transfers, e.g. an I2C mux channel */
+	bool bus_blocking;
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+	uint8_t shadow[DS3231_SHADOW_SIZE];
+	bool shadow_valid;
+#ifdef CONFIG_RTC_ALARM
+	/* Alarm 1 and alarm 2 registers as last read or written */
+	uint8_t alarm_regs[DS3231_ALARM_REGS];
+	bool alarm_regs_valid;
+	/* Schedules the alarm masks cannot repeat, re-armed after each occurrence, by id */
+	uint32_t alarm_rearm_s[2];
+	uint16_t alarm_rearm_mask[2];
+	int64_t alarm_next[2];
+#endif /* CONFIG_RTC_ALARM */
+	/* Day and date registers of the last epoch conversion and their day number */
+	struct k_spinlock date_lock;
+	bool date_valid;
+	uint32_t date_regs;
+	int32_t date_days;
+#ifdef CONFIG_RTC_DS3231_SNAPSHOT
+	/* Latest values seen on the bus, in two copies selected by the sequence count */
+	atomic_t snap_seq;
+	struct ds3231_snapshot snap[2];
+	struct ds3231_snapshot snap_next;
+#endif /* CONFIG_RTC_DS3231_SNAPSHOT */
+#ifdef CONFIG_RTC_DS3231_STATS
+	STATS_SECT_DECL(ds3231) stats;
+	struct k_spinlock stats_lock;
+	struct ds3231_latency_hist latency[DS3231_STATS_OP_COUNT];
+#endif /* CONFIG_RTC_DS3231_STATS */
+#ifdef DS3231_TIME_CACHE_IN_USE
+	struct k_spinlock cache_lock;
+	bool cache_valid;
+	/* Estimated chip time in Unix milliseconds and the uptime it was estimated at */
+	int64_t cache_ms;
+	int64_t cache_anchor_ms;
+	/* The estimate is exact, from a time write or a 1 Hz edge, else a lower bound */
+	bool cache_aligned;
+	/* Latest time served, the cache never goes back behind it */
+	int64_t cache_served_ms;
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+	uint32_t cache_stale;
+	/* The latest time read was extrapolated past the resync interval */
+	bool time_stale;
+#endif /* DS3231_TIME_CACHE_IN_USE */
 #if DS3231_INT1_GPIOS_IN_USE
 	struct gpio_callback int1_callback;
+	/* INT/SQW edges not yet processed */
+	atomic_t int1_edges;
+#ifdef CONFIG_RTC_DS3231_STATS
+	/* Cycle counter at the latest edge, where the alarm dispatch latency starts */
+	uint32_t int1_cycles;
+#endif /* CONFIG_RTC_DS3231_STATS */
+#ifdef CONFIG_RTC_DS3231_INT_OWN_THREAD
 	struct k_thread int1_thread;
 	struct k_sem int1_sem;
-
-	K_KERNEL_STACK_MEMBER(int1_stack, CONFIG_RTC_DS3231_THREAD_STACK_SIZE);
+#else
+	struct k_work int1_work;
+#endif /* CONFIG_RTC_DS3231_INT_OWN_THREAD */
 #ifdef CONFIG_RTC_ALARM
-	rtc_alarm_callback alarm_callback;
-	void *alarm_user_data;
+	rtc_alarm_callback alarm_callback[2];
+	void *alarm_user_data[2];
+	/* Alarms that fired without a callback, by id */
+	atomic_t alarm_pending;
 #endif /* CONFIG_RTC_ALARM */
-#ifdef CONFIG_RTC_UPDATE
+#ifdef DS3231_VALARM_IN_USE
+	struct k_mutex valarm_lock;
+	/* Virtual alarms ordered by time, the earliest one is programmed into alarm 1 */
+	struct rbtree valarm_tree;
+	int64_t valarm_armed;
+	/* Set when the virtual alarms must be checked for due ones, see DS3231_VALARM_KICK */
+	atomic_t valarm_kick;
+#endif /* DS3231_VALARM_IN_USE */
+#ifdef DS3231_UPDATE_IN_USE
 	rtc_update_callback update_callback;
 	void *update_user_data;
-#endif /* CONFIG_RTC_UPDATE */
+	/* INT/SQW carries the 1 Hz square wave rather than alarm interrupts */
+	bool sqw_enabled;
+#ifdef DS3231_SQW_EDGES_IN_USE
+	/* Edges since the square wave was enabled and uptime of the latest one */
+	struct k_spinlock sqw_lock;
+	uint32_t sqw_edges;
+	int64_t sqw_edge_ticks;
+#endif /* DS3231_SQW_EDGES_IN_USE */
+#ifdef DS3231_TIMESTAMP_IN_USE
+	struct k_spinlock ts_lock;
+	/* Cycle counter at the latest edge and the number of seconds counted by edges */
+	uint64_t ts_edge_cycles;
+	uint32_t ts_edges;
+	/* Averaged square wave period in cycles, and the mean deviation from it */
+	uint64_t ts_period;
+	uint64_t ts_period_dev;
+	uint32_t ts_periods;
+	/* RTC second started by edge ts_anchor_edge, valid once anchored */
+	int64_t ts_anchor_seconds;
+	uint32_t ts_anchor_edge;
+	bool ts_anchored;
+	/* Latest timestamp handed out, later ones never go back before it */
+	int64_t ts_last_ns;
+#ifndef CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER
+	/* Extends the 32 bit cycle counter, which wraps far less often than once a second */
+	uint32_t ts_cycles_last;
+	uint32_t ts_cycles_high;
+#endif /* CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER */
+#endif /* DS3231_TIMESTAMP_IN_USE */
+#endif /* DS3231_UPDATE_IN_USE */
 #endif /* DS3231_INT1_GPIOS_IN_USE */
 };
 
-static int ds3231_read_regs(const struct device *dev, uint8_t addr, void *buf, size_t len)
+#ifdef CONFIG_RTC_DS3231_SNAPSHOT
+/*
+ * Publish snap_next. While the sequence count is odd readers use copy 1 and copy 0 is
+ * updated, then readers use copy 0 and copy 1 is updated. A reader always finds a stable
+ * copy, even one that interrupted the writer, and only retries when a whole publication
+ * overlapped its read. Only request completions publish, and they never run concurrently.
+ */
+static void ds3231_snapshot_publish(struct ds3231_data *data)
 {
-	const struct ds3231_config *config = dev->config;
-	int err;
+	atomic_inc(&data->snap_seq);
+	data->snap[0] = data->snap_next;
+	atomic_inc(&data->snap_seq);
+	data->snap[1] = data->snap_next;
+}
 
-	err = i2c_write_read_dt(&config->i2c, &addr, sizeof(addr), buf, len);
-	if (err != 0) {
-		LOG_ERR("failed to read reg addr 0x%02x, len %d (err %d)", addr, len, err);
-		return err;
-	}
+static void ds3231_snapshot_time(struct ds3231_data *data, int64_t seconds)
+{
+	data->snap_next.seconds = seconds;
+	data->snap_next.uptime_ms = k_uptime_get();
+	data->snap_next.valid |= DS3231_SNAPSHOT_TIME;
+	ds3231_snapshot_publish(data);
+}
 
-	return 0;
+static void ds3231_snapshot_temp(struct ds3231_data *data, int32_t temp_mdegc)
+{
+	data->snap_next.temp_mdegc = temp_mdegc;
+	data->snap_next.valid |= DS3231_SNAPSHOT_TEMP;
+	ds3231_snapshot_publish(data);
 }
 
-/* static int ds3231_read_reg8(const struct device *dev, uint8_t addr, uint8_t *val) */
-/* { */
-/*	return ds3231_read_regs(dev, addr, val, sizeof(*val)); */
-/* } */
+static void ds3231_snapshot_status(struct ds3231_data *data)
+{
+	data->snap_next.status = data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)];
+	data->snap_next.valid |= DS3231_SNAPSHOT_STATUS;
+	ds3231_snapshot_publish(data);
+}
 
-static int ds3231_write_regs(const struct device *dev, uint8_t addr, void *buf, size_t len)
+int ds3231_snapshot_get(const struct device *dev, struct ds3231_snapshot *snap)
 {
-	const struct ds3231_config *config = dev->config;
-	uint8_t block[sizeof(addr) + len];
-	int err;
+	struct ds3231_data *data = dev->data;
+	atomic_val_t seq;
 
-	block[0] = addr;
-	memcpy(&block[1], buf, len);
+	do {
+		seq = atomic_get(&data->snap_seq);
+		*snap = data->snap[seq & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&data->snap_seq) != seq);
 
-	err = i2c_write_dt(&config->i2c, block, sizeof(block));
-	if (err != 0) {
-		LOG_ERR("failed to write reg addr 0x%02x, len %d (err %d)", addr, len, err);
-		return err;
-	}
+	return (snap->valid != 0U) ? 0 : -EAGAIN;
+}
+#else
+static void ds3231_snapshot_time(struct ds3231_data *data, int64_t seconds)
+{
+	ARG_UNUSED(data);
+	ARG_UNUSED(seconds);
+}
 
-	return 0;
+static void ds3231_snapshot_temp(struct ds3231_data *data, int32_t temp_mdegc)
+{
+	ARG_UNUSED(data);
+	ARG_UNUSED(temp_mdegc);
 }
 
-/* static int ds3231_write_reg8(const struct device *dev, uint8_t addr, uint8_t val) */
-/* { */
-/*	return ds3231_write_regs(dev, addr, &val, sizeof(val)); */
-/* } */
+static void ds3231_snapshot_status(struct ds3231_data *data)
+{
+	ARG_UNUSED(data);
+}
 
-static int ds3231_set_time(const struct device *dev, const struct rtc_time *timeptr)
+int ds3231_snapshot_get(const struct device *dev, struct ds3231_snapshot *snap)
 {
-	int ret = 0;
-	uint8_t raw_time[7] = {0};
-	raw_time[0] = (bin2bcd(timeptr->tm_sec / 10) << 4) + bin2bcd(timeptr->tm_sec % 10);
-	raw_time[1] = (bin2bcd(timeptr->tm_min / 10) << 4) + bin2bcd(timeptr->tm_min % 10);
-	raw_time[2] = (bin2bcd(timeptr->tm_hour / 10) << 4) + bin2bcd(timeptr->tm_hour % 10);
-	raw_time[3] = bin2bcd(timeptr->tm_wday);
-	raw_time[4] = (bin2bcd(timeptr->tm_mday / 10) << 4) + bin2bcd(timeptr->tm_mday % 10);
-	raw_time[5] = bin2bcd(timeptr->tm_mon + DS3231_MONTHS_OFFSET);
-	raw_time[6] = bin2bcd(timeptr->tm_year - DS3231_YEARS_OFFSET);
-
-	ret = ds3231_write_regs(dev, DS3231_SECONDS, raw_time, sizeof(raw_time));
-	if (ret) {
-		LOG_ERR("Error when setting time: %i", ret);
-		return ret;
-	}
+	ARG_UNUSED(dev);
+	ARG_UNUSED(snap);
 
-	return 0;
+	return -ENOTSUP;
 }
+#endif /* CONFIG_RTC_DS3231_SNAPSHOT */
 
-static int ds3231_get_time(const struct device *dev, struct rtc_time *timeptr)
+#ifdef CONFIG_RTC_DS3231_STATS
+/* Add a latency to the histogram of op, bucket n holds 2^(n-1) us to below 2^n us */
+static void ds3231_stats_latency(struct ds3231_data *data, enum ds3231_stats_op op,
+				 uint32_t start_cycles)
 {
-	uint8_t regs[7];
-	int err;
-	err = ds3231_read_regs(dev, DS3231_SECONDS, &regs, sizeof(regs));
-	if (err != 0) {
-		return err;
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cycles);
+	struct ds3231_latency_hist *hist = &data->latency[op];
+	k_spinlock_key_t key = k_spin_lock(&data->stats_lock);
+
+	hist->buckets[MIN(LOG2(us) + 1, DS3231_STATS_BUCKETS - 1)]++;
+	hist->count++;
+	hist->max_us = MAX(hist->max_us, us);
+	k_spin_unlock(&data->stats_lock, key);
+}
+
+/* Count the transfer of one request step */
+static void ds3231_stats_xfer(struct ds3231_data *data, const struct ds3231_async_req *req,
+			      int result)
+{
+	DS3231_STATS_INC(data, transactions);
+
+	for (uint8_t i = 0; i < req->num_msgs; i++) {
+		if ((req->msgs[i].flags & I2C_MSG_READ) != 0U) {
+			DS3231_STATS_INCN(data, bytes_read, req->msgs[i].len);
+		} else {
+			DS3231_STATS_INCN(data, bytes_written, req->msgs[i].len);
+		}
 	}
-	memset(timeptr, 0U, sizeof(*timeptr));
-	timeptr->tm_sec =
-		bcd2bin(regs[0] & DS3231_SECONDS_MASK) + bcd2bin(regs[0] & DS3231_SECONDS_10);
-	timeptr->tm_min =
-		bcd2bin(regs[1] & DS3231_MINUTES_MASK) + bcd2bin(regs[1] & DS3231_MINUTES_10);
-	timeptr->tm_hour =
-		bcd2bin(regs[2] & DS3231_HOURS_MASK) + bcd2bin(regs[2] & DS3231_HOURS_10);
-	timeptr->tm_wday = bcd2bin(regs[3] & DS3231_DAYS_MASK);
-	timeptr->tm_mday = bcd2bin(regs[4] & DS3231_DATE_MASK) + bcd2bin(regs[4] & DS3231_DATE_10);
-	timeptr->tm_mon = bcd2bin(regs[5] & DS3231_MONTHS_MASK) +
-			  bcd2bin(regs[5] & DS3231_MONTH_10) - DS3231_MONTHS_OFFSET;
-	timeptr->tm_year = bcd2bin(regs[6] & DS3231_YEARS_MASK) +
-			   bcd2bin(regs[6] & DS3231_YEAR_10) + DS3231_YEARS_OFFSET;
-	LOG_DBG("get time: year = %d, mon = %d, mday = %d, wday = %d, hour = %d, "
-		"min = %d, sec = %d",
-		timeptr->tm_year, timeptr->tm_mon, timeptr->tm_mday, timeptr->tm_wday,
-		timeptr->tm_hour, timeptr->tm_min, timeptr->tm_sec);
 
-	return 0;
+	if (result != 0) {
+		DS3231_STATS_INC(data, errors);
+	}
 }
-#ifdef CONFIG_RTC_ALARM
-static int ds3231_alarm_get_supported_fields(const struct device *dev, uint16_t id, uint16_t *mask)
+
+static void ds3231_stats_req_op(struct ds3231_async_req *req, enum ds3231_stats_op op)
 {
+	req->op = op;
+}
 
-	if (id == 0U) {
-		*mask = DS3231_RTC_ALARM_1_TIME_MASK;
-	} else if (id == 1U) {
-		*mask = DS3231_RTC_ALARM_2_TIME_MASK;
-	} else {
-		LOG_ERR("invalid ID %d", id);
+#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_ALARM)
+/* Count an alarm callback about to run, timed from the INT/SQW edge that raised it */
+static void ds3231_stats_alarm(struct ds3231_data *data)
+{
+	DS3231_STATS_INC(data, alarms);
+	ds3231_stats_latency(data, DS3231_STATS_ALARM_DISPATCH, data->int1_cycles);
+}
+#endif /* DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_ALARM) */
+
+static void ds3231_stats_req_done(struct ds3231_data *data, const struct ds3231_async_req *req)
+{
+	ds3231_stats_latency(data, req->op, req->start_cycles);
+}
+
+int ds3231_stats_latency_get(const struct device *dev, enum ds3231_stats_op op,
+			     struct ds3231_latency_hist *hist)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key;
+
+	if (op < 0 || op >= DS3231_STATS_OP_COUNT) {
 		return -EINVAL;
 	}
-	LOG_INF("Supported mask is " PRINTF_BINARY_PATTERN_INT16,
-		PRINTF_BYTE_TO_BINARY_INT16(*mask));
+
+	key = k_spin_lock(&data->stats_lock);
+	*hist = data->latency[op];
+	k_spin_unlock(&data->stats_lock, key);
+
 	return 0;
 }
 
-static int ds3231_alarm_get_time(const struct device *dev, uint16_t id, uint16_t *mask,
-				 struct rtc_time *timeptr)
+int ds3231_stats_reset(const struct device *dev)
 {
-	int err;
-	uint8_t regs_0[4];
-	uint8_t regs_1[3];
-	if (id == 0u) {
-		err = ds3231_read_regs(dev, DS3231_ALARM_1_SECONDS, &regs_0, sizeof(regs_0));
-		if (err != 0) {
-			return err;
-		}
-		memset(timeptr, 0U, sizeof(*timeptr));
-		timeptr->tm_sec = bcd2bin(regs_0[0] & DS3231_ALARM_1_SECONDS_SECONDS) +
-				  bcd2bin(regs_0[0] & DS3231_ALARM_1_SECONDS_10);
-		timeptr->tm_min = bcd2bin(regs_0[1] & DS3231_ALARM_1_MINUTES_MINUTES) +
-				  bcd2bin(regs_0[1] & DS3231_ALARM_1_MINUTES_10);
-		timeptr->tm_hour = bcd2bin(regs_0[2] & DS3231_ALARM_1_HOURS_HOURS) +
-				   bcd2bin(regs_0[2] & DS3231_ALARM_1_HOURS_10) +
-				   bcd2bin(regs_0[2] & DS3231_ALARM_1_HOURS_AM_PM_20);
-		timeptr->tm_mday = bcd2bin(regs_0[3] & DS3231_ALARM_1_DAY_DATE_MASK) +
-				   bcd2bin(regs_0[3] & DS3231_ALARM_1_DAY_DATE_10);
-	} // endif id=0
-	else if (id==1U){
-		err = ds3231_read_regs(dev, DS3231_ALARM_2_MINUTES, &regs_1, sizeof(regs_1));
-		if (err != 0) {
-			return err;
-		}
-		memset(timeptr, 0U, sizeof(*timeptr));
-		timeptr->tm_min = bcd2bin(regs_1[0] & DS3231_ALARM_2_MINUTES_MINUTES) +
-				  bcd2bin(regs_1[0] & DS3231_ALARM_2_MINUTES_10);
-		timeptr->tm_hour = bcd2bin(regs_1[1] & DS3231_ALARM_2_HOURS_HOURS) +
-				   bcd2bin(regs_1[1] & DS3231_ALARM_2_HOURS_10) +
-				   bcd2bin(regs_1[1] & DS3231_ALARM_2_HOURS_AM_PM_20);
-		timeptr->tm_mday = bcd2bin(regs_1[2] & DS3231_ALARM_2_DAY_DATE_MASK) +
-				   bcd2bin(regs_1[2] & DS3231_ALARM_2_DAY_DATE_10);
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->stats_lock);
+
+	stats_reset(&data->stats.s_hdr);
+	memset(data->latency, 0, sizeof(data->latency));
+	k_spin_unlock(&data->stats_lock, key);
 
-	}
 	return 0;
 }
+#else
+static void ds3231_stats_xfer(struct ds3231_data *data, const struct ds3231_async_req *req,
+			      int result)
+{
+	ARG_UNUSED(data);
+	ARG_UNUSED(req);
+	ARG_UNUSED(result);
+}
 
-static int ds3231_alarm_is_pending(const struct device *dev, uint16_t id)
+static void ds3231_stats_req_op(struct ds3231_async_req *req, enum ds3231_stats_op op)
 {
-	return 0;
+	ARG_UNUSED(req);
+	ARG_UNUSED(op);
 }
 
-static int ds3231_alarm_set_time(const struct device *dev, uint16_t id, uint16_t mask,
-				 const struct rtc_time *timeptr)
+#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_ALARM)
+static void ds3231_stats_alarm(struct ds3231_data *data)
 {
-	uint8_t regs_0[4];
-	uint8_t regs_1[3]; // We only need 3 for Alarm 2
-	uint8_t reg_INT;
-	int ret;
-	LOG_INF("Mask is " PRINTF_BINARY_PATTERN_INT16, PRINTF_BYTE_TO_BINARY_INT16(mask));
+	ARG_UNUSED(data);
+}
+#endif /* DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_ALARM) */
 
-	if (id == 0U) {
-		/* Clear set alarms */
-		reg_INT = 0; /* TODO should we only clear the A1F flag here? */
-		ret = ds3231_write_regs(dev, DS3231_STATUS, &reg_INT, sizeof(reg_INT));
+static void ds3231_stats_req_done(struct ds3231_data *data, const struct ds3231_async_req *req)
+{
+	ARG_UNUSED(data);
+	ARG_UNUSED(req);
+}
 
-		if ((mask & ~(DS3231_RTC_ALARM_1_TIME_MASK)) != 0U) {
-			LOG_ERR("unsupported alarm field mask 0x%04x", mask);
-			return -EINVAL;
-		}
+int ds3231_stats_latency_get(const struct device *dev, enum ds3231_stats_op op,
+			     struct ds3231_latency_hist *hist)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(op);
+	ARG_UNUSED(hist);
 
-		if ((mask & RTC_ALARM_TIME_MASK_SECOND) != 0U) {
-			regs_0[0] = (bin2bcd(timeptr->tm_sec / 10) << 4) +
-				    bin2bcd(timeptr->tm_sec % 10);
+	return -ENOTSUP;
+}
 
-		} else {
-			regs_0[0] = DS3231_ALARM_1_SECONDS_A1M1;
-		}
+int ds3231_stats_reset(const struct device *dev)
+{
+	ARG_UNUSED(dev);
 
-		if ((mask & RTC_ALARM_TIME_MASK_MINUTE) != 0U) {
-			regs_0[1] = (bin2bcd(timeptr->tm_min / 10) << 4) +
-				    bin2bcd(timeptr->tm_min % 10);
-		} else {
-			regs_0[1] = DS3231_ALARM_1_MINUTES_A1M2;
-		}
+	return -ENOTSUP;
+}
+#endif /* CONFIG_RTC_DS3231_STATS */
 
-		if ((mask & RTC_ALARM_TIME_MASK_HOUR) != 0U) {
-			regs_0[2] = (bin2bcd(timeptr->tm_hour / 10) << 4) +
-				    bin2bcd(timeptr->tm_hour % 10);
-		} else {
-			regs_0[2] = DS3231_ALARM_1_HOURS_A1M3;
-		}
+/*
+ * All bus access is expressed as requests. A request's optional prepare hook builds its
+ * messages right before the transfer starts, and its complete hook post-processes the data
+ * once it succeeded. Requests are executed one at a time in submission order, either from a
+ * per-instance queue driven by I2C completion callbacks (CONFIG_RTC_DS3231_ASYNC), or
+ * inline under the instance lock. Hooks therefore see a consistent register shadow, and
+ * the shadow and the snapshot are only modified from hooks. A sequence of transfers that
+ * must not be interleaved with other requests is one request whose complete hook returns
+ * -EAGAIN to run the next step.
+ */
+static void ds3231_req_init(struct ds3231_async_req *req,
+			    void (*prepare)(const struct device *, struct ds3231_async_req *),
+			    int (*complete)(const struct device *, struct ds3231_async_req *))
+{
+	req->prepare = prepare;
+	req->complete = complete;
+	req->num_msgs = 0;
+	req->reload = false;
+	ds3231_stats_req_op(req, DS3231_STATS_OTHER);
+}
 
-		if ((mask & RTC_ALARM_TIME_MASK_MONTHDAY) != 0U) {
-			regs_0[3] = (bin2bcd(timeptr->tm_mday / 10) << 4) +
-				    bin2bcd(timeptr->tm_mday % 10);
-		} else {
-			regs_0[3] = DS3231_ALARM_1_DAY_DATE_A1M4;
-		}
+static void ds3231_req_read(struct ds3231_async_req *req, uint8_t addr, void *buf, size_t len)
+{
+	req->wire[0] = addr;
+	req->msgs[0].buf = req->wire;
+	req->msgs[0].len = 1U;
+	req->msgs[0].flags = I2C_MSG_WRITE;
+	req->msgs[1].buf = buf;
+	req->msgs[1].len = len;
+	req->msgs[1].flags = I2C_MSG_RESTART | I2C_MSG_READ | I2C_MSG_STOP;
+	req->num_msgs = 2;
+}
+
+/*
+ * Write len registers starting at addr. The address byte and the values go out as one
+ * message, so no controller has to merge consecutive write messages into one transaction.
+ */
+static void ds3231_req_write(struct ds3231_async_req *req, uint8_t addr, const void *buf,
+			     size_t len)
+{
+	__ASSERT_NO_MSG(len < sizeof(req->wire));
+
+	req->wire[0] = addr;
+	memcpy(&req->wire[1], buf, len);
+	req->msgs[0].buf = req->wire;
+	req->msgs[0].len = len + 1U;
+	req->msgs[0].flags = I2C_MSG_WRITE | I2C_MSG_STOP;
+	req->num_msgs = 1;
+}
 
-		ret = ds3231_write_regs(dev, DS3231_ALARM_1_SECONDS, regs_0, sizeof(regs_0));
+/* Replace the request's transfer with a reload of a stale shadow, it is re-run afterwards */
+static bool ds3231_req_reload(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
 
-		// Write bits to enable interrupt generation on alarm 1 (A1E and INTCN)
-		reg_INT = DS3231_CONTROL_A1IE + DS3231_CONTROL_INTCN;
-		ret = ds3231_write_regs(dev, DS3231_CONTROL, &reg_INT, sizeof(reg_INT));
+	if (data->shadow_valid) {
+		return false;
+	}
 
-		return 0;
-	} else if (id == 1U) {
-		if ((mask & ~(DS3231_RTC_ALARM_2_TIME_MASK)) != 0U) {
-			LOG_ERR("unsupported alarm field mask 0x%04x", mask);
-			return -EINVAL;
-		}
-		if ((mask & RTC_ALARM_TIME_MASK_MINUTE) != 0U) {
-			regs_1[0] = (bin2bcd(timeptr->tm_min / 10) << 4) +
-				    bin2bcd(timeptr->tm_min % 10);
-		} else {
-			regs_1[0] = DS3231_ALARM_2_MINUTES_A2M2;
-		}
+	ds3231_req_read(req, DS3231_CONTROL, data->shadow, sizeof(data->shadow));
+	req->reload = true;
 
-		if ((mask & RTC_ALARM_TIME_MASK_HOUR) != 0U) {
-			regs_1[1] = (bin2bcd(timeptr->tm_hour / 10) << 4) +
-				    bin2bcd(timeptr->tm_hour % 10);
-		} else {
-			regs_1[1] = DS3231_ALARM_2_HOURS_A2M3;
-		}
+	return true;
+}
 
-		if ((mask & RTC_ALARM_TIME_MASK_MONTHDAY) != 0U) {
-			regs_1[2] = (bin2bcd(timeptr->tm_mday / 10) << 4) +
-				    bin2bcd(timeptr->tm_mday % 10);
-		} else {
-			regs_1[2] = DS3231_ALARM_2_DAY_DATE_A2M4;
-		}
+/* Returns -EAGAIN when the request must be prepared and transferred once more */
+static int ds3231_req_complete(const struct device *dev, struct ds3231_async_req *req,
+			       int result)
+{
+	struct ds3231_data *data = dev->data;
 
-		ret = ds3231_write_regs(dev, DS3231_ALARM_2_MINUTES, regs_1, sizeof(regs_1));
+	if (req->num_msgs > 0) {
+		ds3231_stats_xfer(data, req, result);
+	}
 
-		// Write bits to enable interrupt generation on alarm 2 (A2E and INTCN)
-		reg_INT = DS3231_CONTROL_A2IE + DS3231_CONTROL_INTCN;
-		ret = ds3231_write_regs(dev, DS3231_CONTROL, &reg_INT, sizeof(reg_INT));
+	/* A bus driver's -EAGAIN must not be taken for a request asking to run again */
+	if (result != 0) {
+		return (result == -EAGAIN) ? -ETIMEDOUT : result;
+	}
 
-		return 0;
-	} else {
-		LOG_ERR("invalid ID %d", id);
-		return -EINVAL;
+	if (req->reload) {
+		req->reload = false;
+		data->shadow_valid = true;
+		DS3231_STATS_INC(data, reloads);
+		ds3231_snapshot_status(data);
+		return -EAGAIN;
 	}
+
+	return (req->complete != NULL) ? req->complete(dev, req) : 0;
 }
-#if DS3231_INT1_GPIOS_IN_USE
-static void ds3231_int1_callback_handler(const struct device *port, struct gpio_callback *cb,
-					 gpio_port_pins_t pins)
+
+static void ds3231_req_finish(const struct device *dev, struct ds3231_async_req *req,
+			      int result)
 {
-	struct ds3231_data *data = CONTAINER_OF(cb, struct ds3231_data, int1_callback);
-	LOG_INF("inside callback handler");
-	ARG_UNUSED(port);
-	ARG_UNUSED(pins);
+	ds3231_async_cb_t cb = req->cb;
 
-	k_sem_give(&data->int1_sem);
+	req->result = result;
+	if (cb != NULL) {
+		cb(dev, req, result, req->user_data);
+	}
 }
 
-static int ds3231_update_set_callback(const struct device *dev, rtc_update_callback callback,
-				      void *user_data)
+/* Stamp a request on submission, without CONFIG_RTC_DS3231_DEADLINE_MS it has no deadline */
+static void ds3231_req_start(struct ds3231_async_req *req)
 {
-	return 0;
+#ifdef CONFIG_RTC_DS3231_STATS
+	req->start_cycles = k_cycle_get_32();
+#endif /* CONFIG_RTC_DS3231_STATS */
+	req->deadline = (CONFIG_RTC_DS3231_DEADLINE_MS > 0)
+				? k_uptime_get() + CONFIG_RTC_DS3231_DEADLINE_MS
+				: INT64_MAX;
 }
 
-static int ds3231_int1_enable(const struct device *dev, bool enable)
+/* Time left until the request's deadline */
+static k_timeout_t ds3231_req_timeout(const struct ds3231_async_req *req)
 {
-	int err = 0;
-	const struct ds3231_config *config = dev->config;
-	err = gpio_pin_interrupt_configure_dt(&config->int1, GPIO_INT_EDGE_TO_ACTIVE);
-	return 0;
+	if (req->deadline == INT64_MAX) {
+		return K_FOREVER;
+	}
+
+	return K_MSEC(MAX(req->deadline - k_uptime_get(), 0));
 }
 
-static void ds3231_int1_thread(const struct device *dev)
+/* NACK, bus busy or timeout, which the next attempt may get past */
+static bool ds3231_bus_fault(int err)
 {
+	return err == -EIO || err == -EBUSY || err == -ETIMEDOUT || err == -EAGAIN;
 }
 
-static int ds3231_alarm_set_callback(const struct device *dev, uint16_t id,
-				     rtc_alarm_callback callback, void *user_data)
+/*
+ * Decide whether a failed transfer is attempted again, and count the retry. It is not after
+ * CONFIG_RTC_DS3231_RETRIES retries, nor when the retry would start past the request's
+ * deadline.
+ */
+static bool ds3231_req_retry(const struct device *dev, struct ds3231_async_req *req, int err)
 {
-	const struct ds3231_config *config = dev->config;
 	struct ds3231_data *data = dev->data;
-	/* uint8_t control_1; */
-	int err = 0;
+	const uint32_t backoff_us = (uint32_t)CONFIG_RTC_DS3231_RETRY_BACKOFF_US << req->tries;
 
-	/* Check if int1 pin is assigned */
-	if (config->int1.port == NULL) {
-		LOG_INF("int1 port is null!");
-		return -ENOTSUP;
+	if (!ds3231_bus_fault(err) || req->tries >= CONFIG_RTC_DS3231_RETRIES ||
+	    k_uptime_get() + DIV_ROUND_UP(backoff_us, USEC_PER_MSEC) > req->deadline) {
+		return false;
 	}
-	/* Check if valid ID */
-	if (id != 0 && id != 1) {
-		LOG_ERR("Invalid ID %d - should be 0 or 1", id);
-		return -EINVAL;
+
+	LOG_DBG("transfer failed (err %d), retry %u", err, req->tries + 1U);
+	ds3231_stats_xfer(data, req, err);
+	DS3231_STATS_INC(data, retries);
+	req->tries++;
+
+	return true;
+}
+
+/* Retry n waits RETRY_BACKOFF_US << (n - 1) */
+static uint32_t ds3231_req_backoff_us(const struct ds3231_async_req *req)
+{
+	return (uint32_t)CONFIG_RTC_DS3231_RETRY_BACKOFF_US << (req->tries - 1U);
+}
+
+/*
+ * Recover the bus before the second and later retries, as a target holding SDA low fails
+ * every transfer until it is clocked out.
+ */
+static void ds3231_req_recover(const struct device *dev, const struct ds3231_async_req *req)
+{
+#ifdef CONFIG_RTC_DS3231_BUS_RECOVERY
+	if (req->tries > 1U) {
+		const struct ds3231_config *config = dev->config;
+		int ret = i2c_recover_bus(config->i2c.bus);
+
+		DS3231_STATS_INC((struct ds3231_data *)dev->data, recoveries);
+		if (ret != 0) {
+			LOG_DBG("bus recovery failed (err %d)", ret);
+		}
 	}
-	/* Enable gpio interrupt settings */
-	ds3231_int1_enable(dev, callback != NULL);
-	return err;
+#else
+	ARG_UNUSED(dev);
+	ARG_UNUSED(req);
+#endif /* CONFIG_RTC_DS3231_BUS_RECOVERY */
 }
-#endif /* DS3231_INT1_GPIOS_IN_USE */
-#endif /* CONFIG_RTC_ALARM */
 
-static const struct rtc_driver_api ds3231_driver_api = {
-	.set_time = ds3231_set_time,
-	.get_time = ds3231_get_time,
-#ifdef CONFIG_RTC_ALARM
-	.alarm_get_supported_fields = ds3231_alarm_get_supported_fields,
-	.alarm_set_time = ds3231_alarm_set_time,
-	.alarm_get_time = ds3231_alarm_get_time,
-	.alarm_is_pending = ds3231_alarm_is_pending,
-#if DS3231_INT1_GPIOS_IN_USE
-	.alarm_set_callback = ds3231_alarm_set_callback,
-#endif /* DS3231_INT1_GPIOS_IN_USE */
-#endif /* CONFIG_RTC_ALARM */
+#ifdef CONFIG_RTC_DS3231_ASYNC
+/* Shared by all instances, only bus work runs here so it never waits for other requests */
+static K_KERNEL_STACK_DEFINE(ds3231_bus_q_stack, CONFIG_RTC_DS3231_BUS_WQ_STACK_SIZE);
+static struct k_work_q ds3231_bus_q;
 
-#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_UPDATE)
-	.update_set_callback = ds3231_update_set_callback,
-#endif /* DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_UPDATE) */
-};
+static void ds3231_i2c_callback(const struct device *bus, int result, void *user_data);
 
-static int ds3231_init(const struct device *dev)
+/* Pop the completed head request and return the next one to start, if any */
+static struct ds3231_async_req *ds3231_queue_pop(const struct device *dev,
+						 struct ds3231_async_req *req, int result)
 {
-	const struct ds3231_config *config = dev->config;
 	struct ds3231_data *data = dev->data;
-	int err;
-	LOG_INF("Initializing the ds3231 driver");
-
-	k_mutex_init(&data->lock);
+	sys_snode_t *node;
+	k_spinlock_key_t key;
 
-	if (!i2c_is_ready_dt(&config->i2c)) {
-		LOG_ERR("I2C bus not ready");
-		return -ENODEV;
+	result = ds3231_req_complete(dev, req, result);
+	if (result == -EAGAIN) {
+		return req;
 	}
-#if DS3231_INT1_GPIOS_IN_USE
-	k_tid_t tid;
 
-	LOG_INF("Setting up interrupt thread and gpio");
+	key = k_spin_lock(&data->queue_lock);
+	(void)sys_slist_get(&data->queue);
+	node = sys_slist_peek_head(&data->queue);
+	k_spin_unlock(&data->queue_lock, key);
 
-	if (config->int1.port != NULL) {
-		k_sem_init(&data->int1_sem, 0, INT_MAX);
+	ds3231_stats_req_done(data, req);
 
-		if (!gpio_is_ready_dt(&config->int1)) {
-			LOG_ERR("GPIO not ready");
-			return -ENODEV;
-		}
-		LOG_INF("gpio is ready");
-		err = gpio_pin_configure_dt(&config->int1, GPIO_INPUT);
-		if (err != 0) {
-			LOG_ERR("failed to configure GPIO (err %d)", err);
-			return -ENODEV;
-		}
-		LOG_INF("gpio configured as input");
-		gpio_init_callback(&data->int1_callback, ds3231_int1_callback_handler,
-				   BIT(config->int1.pin));
+	/* The request is off the queue, so the callback may reuse or release it */
+	ds3231_req_finish(dev, req, result);
 
-		err = gpio_add_callback_dt(&config->int1, &data->int1_callback);
-		if (err != 0) {
-			LOG_ERR("failed to add GPIO callback (err %d)", err);
-			return -ENODEV;
-		}
-		LOG_INF("gpio callback added");
-		tid = k_thread_create(&data->int1_thread, data->int1_stack,
-				      K_THREAD_STACK_SIZEOF(data->int1_stack),
+	return (node != NULL) ? CONTAINER_OF(node, struct ds3231_async_req, node) : NULL;
+}
+
+/* Retry the failed transfer from the work queue once its backoff expired */
+static bool ds3231_queue_retry(const struct device *dev, struct ds3231_async_req *req, int err)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (!ds3231_req_retry(dev, req, err)) {
+		return false;
+	}
+
+	(void)k_work_reschedule_for_queue(&ds3231_bus_q, &data->xfer_work,
+					  K_USEC(ds3231_req_backoff_us(req)));
+
+	return true;
+}
+
+/* Start the request's transfer, 0 when it is in flight */
+static int ds3231_queue_transfer(const struct device *dev, struct ds3231_async_req *req)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	int err;
+
+	if (data->bus_blocking) {
+		(void)k_work_reschedule_for_queue(&ds3231_bus_q, &data->xfer_work, K_NO_WAIT);
+		return 0;
+	}
+
+	err = i2c_transfer_cb_dt(&config->i2c, req->msgs, req->num_msgs, ds3231_i2c_callback,
+				 data);
+	if (err == -ENOSYS) {
+		LOG_INF("%s: no I2C callbacks, transferring from the work queue", dev->name);
+		data->bus_blocking = true;
+		(void)k_work_reschedule_for_queue(&ds3231_bus_q, &data->xfer_work, K_NO_WAIT);
+		return 0;
+	}
+
+	if (err != 0 && ds3231_queue_retry(dev, req, err)) {
+		return 0;
+	}
+
+	return err;
+}
+
+/* Start requests from the head of the queue until one is in flight or the queue drained */
+static void ds3231_queue_run(const struct device *dev, struct ds3231_async_req *req)
+{
+	int err;
+
+	while (req != NULL) {
+		if (req->prepare != NULL) {
+			req->prepare(dev, req);
+		}
+
+		err = 0;
+		req->tries = 0U;
+		if (k_uptime_get() > req->deadline) {
+			/* Queued behind others for too long, no transfer starts past the deadline */
+			LOG_WRN("bus not available before the deadline");
+			err = -ETIMEDOUT;
+		} else if (req->num_msgs > 0) {
+			err = ds3231_queue_transfer(dev, req);
+			if (err == 0) {
+				return;
+			}
+		}
+
+		req = ds3231_queue_pop(dev, req, err);
+	}
+}
+
+/* Drop a request that is still waiting behind others, the head one has started */
+static bool ds3231_queue_cancel(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->queue_lock);
+	bool waiting = sys_slist_peek_head(&data->queue) != &req->node &&
+		       sys_slist_find_and_remove(&data->queue, &req->node);
+
+	k_spin_unlock(&data->queue_lock, key);
+
+	return waiting;
+}
+
+static void ds3231_i2c_callback(const struct device *bus, int result, void *user_data)
+{
+	struct ds3231_data *data = user_data;
+	const struct device *dev = data->dev;
+	sys_snode_t *node = sys_slist_peek_head(&data->queue);
+	struct ds3231_async_req *req = CONTAINER_OF(node, struct ds3231_async_req, node);
+
+	ARG_UNUSED(bus);
+
+	if (result != 0 && ds3231_queue_retry(dev, req, result)) {
+		return;
+	}
+
+	ds3231_queue_run(dev, ds3231_queue_pop(dev, req, result));
+}
+
+/*
+ * Start a retry after its backoff, recovering the bus first, or a transfer on a bus without
+ * callbacks. A blocking transfer completes as the I2C callback would.
+ */
+static void ds3231_xfer_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct ds3231_data *data = CONTAINER_OF(dwork, struct ds3231_data, xfer_work);
+	const struct device *dev = data->dev;
+	const struct ds3231_config *config = dev->config;
+	sys_snode_t *node = sys_slist_peek_head(&data->queue);
+	struct ds3231_async_req *req = CONTAINER_OF(node, struct ds3231_async_req, node);
+	int err;
+
+	ds3231_req_recover(dev, req);
+
+	if (data->bus_blocking) {
+		ds3231_i2c_callback(config->i2c.bus,
+				    i2c_transfer_dt(&config->i2c, req->msgs, req->num_msgs), data);
+		return;
+	}
+
+	err = ds3231_queue_transfer(dev, req);
+	if (err != 0) {
+		ds3231_queue_run(dev, ds3231_queue_pop(dev, req, err));
+	}
+}
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+
+static void ds3231_req_submit(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	k_spinlock_key_t key;
+	bool idle;
+
+	ds3231_req_start(req);
+
+	key = k_spin_lock(&data->queue_lock);
+	idle = sys_slist_is_empty(&data->queue);
+
+	sys_slist_append(&data->queue, &req->node);
+	k_spin_unlock(&data->queue_lock, key);
+
+	if (idle) {
+		ds3231_queue_run(dev, req);
+	}
+#else
+	const struct ds3231_config *config = dev->config;
+	int err;
+
+	ds3231_req_start(req);
+
+	/* The wait for other callers counts against the deadline */
+	if (k_mutex_lock(&data->lock, ds3231_req_timeout(req)) != 0) {
+		LOG_WRN("bus not available before the deadline");
+		ds3231_stats_req_done(data, req);
+		ds3231_req_finish(dev, req, -ETIMEDOUT);
+		return;
+	}
+
+	do {
+		if (req->prepare != NULL) {
+			req->prepare(dev, req);
+		}
+
+		err = 0;
+		req->tries = 0U;
+		if (req->num_msgs > 0) {
+			for (;;) {
+				err = i2c_transfer_dt(&config->i2c, req->msgs, req->num_msgs);
+				if (err == 0 || !ds3231_req_retry(dev, req, err)) {
+					break;
+				}
+
+				k_usleep(ds3231_req_backoff_us(req));
+				ds3231_req_recover(dev, req);
+			}
+		}
+
+		err = ds3231_req_complete(dev, req, err);
+	} while (err == -EAGAIN);
+
+	k_mutex_unlock(&data->lock);
+
+	ds3231_stats_req_done(data, req);
+	ds3231_req_finish(dev, req, err);
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+}
+
+#ifdef CONFIG_RTC_DS3231_ASYNC
+static void ds3231_req_wake(const struct device *dev, struct ds3231_async_req *req, int result,
+			    void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(req);
+	ARG_UNUSED(result);
+
+	k_sem_give(user_data);
+}
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+
+/* Submit a request and block until it completed, this is what the synchronous API uses */
+static int ds3231_req_wait(const struct device *dev, struct ds3231_async_req *req)
+{
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	struct k_sem done;
+
+	k_sem_init(&done, 0, 1);
+	req->cb = ds3231_req_wake;
+	req->user_data = &done;
+	ds3231_req_submit(dev, req);
+
+	/*
+	 * The wait behind other requests counts against the deadline. A started request is
+	 * waited for, its retries do not start past the deadline either.
+	 */
+	if (k_sem_take(&done, ds3231_req_timeout(req)) != 0) {
+		if (ds3231_queue_cancel(dev, req)) {
+			LOG_WRN("bus not available before the deadline");
+			ds3231_stats_req_done(dev->data, req);
+			return -ETIMEDOUT;
+		}
+
+		k_sem_take(&done, K_FOREVER);
+	}
+#else
+	req->cb = NULL;
+	ds3231_req_submit(dev, req);
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+
+	return req->result;
+}
+
+int ds3231_shadow_invalidate(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+
+	data->shadow_valid = false;
+#ifdef CONFIG_RTC_ALARM
+	data->alarm_regs_valid = false;
+#endif /* CONFIG_RTC_ALARM */
+
+	return 0;
+}
+
+/* Masked update of a shadowed register, skipping the write when nothing changes */
+static void ds3231_shadow_update_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+	uint8_t shadow;
+
+	if (ds3231_req_reload(dev, req)) {
+		return;
+	}
+
+	shadow = data->shadow[DS3231_SHADOW_IDX(req->reg)];
+	req->buf[0] = (shadow & ~req->ctrl_mask) | (req->ctrl_value & req->ctrl_mask);
+	if (req->buf[0] == shadow) {
+		req->num_msgs = 0;
+	} else {
+		ds3231_req_write(req, req->reg, req->buf, 1);
+	}
+}
+
+static int ds3231_shadow_update_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	data->shadow[DS3231_SHADOW_IDX(req->reg)] = req->buf[0];
+
+	return 0;
+}
+
+static int ds3231_shadow_update(const struct device *dev, uint8_t addr, uint8_t mask,
+				uint8_t value)
+{
+	struct ds3231_async_req req;
+
+	ds3231_req_init(&req, ds3231_shadow_update_prepare, ds3231_shadow_update_complete);
+	req.reg = addr;
+	req.ctrl_mask = mask;
+	req.ctrl_value = value;
+
+	return ds3231_req_wait(dev, &req);
+}
+
+#ifdef DS3231_UPDATE_IN_USE
+static int ds3231_update_control(const struct device *dev, uint8_t mask, uint8_t value)
+{
+	return ds3231_shadow_update(dev, DS3231_CONTROL, mask, value);
+}
+#endif /* DS3231_UPDATE_IN_USE */
+
+/* Copy a shadowed register into req->buf[0], reloading the shadow if it is stale */
+static void ds3231_shadow_get_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (ds3231_req_reload(dev, req)) {
+		return;
+	}
+
+	req->buf[0] = data->shadow[DS3231_SHADOW_IDX(req->reg)];
+	req->num_msgs = 0;
+}
+
+int ds3231_aging_offset_get(const struct device *dev, int8_t *offset)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_init(&req, ds3231_shadow_get_prepare, NULL);
+	req.reg = DS3231_AGING_OFFSET;
+
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		return err;
+	}
+
+	*offset = (int8_t)req.buf[0];
+
+	return 0;
+}
+
+int ds3231_aging_offset_set(const struct device *dev, int8_t offset)
+{
+	return ds3231_shadow_update(dev, DS3231_AGING_OFFSET, 0xffU, (uint8_t)offset);
+}
+
+/*
+ * The STATUS flags are set by the chip and can only be written to 0, writing 1 leaves them
+ * unchanged. Clearing therefore always writes, but needs no read.
+ */
+static void ds3231_status_clear_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (ds3231_req_reload(dev, req)) {
+		return;
+	}
+
+	req->buf[0] = (data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] | DS3231_STATUS_FLAGS) &
+		      ~req->clear_flags;
+	ds3231_req_write(req, DS3231_STATUS, req->buf, 1);
+}
+
+static int ds3231_status_clear_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] &= ~req->clear_flags;
+	ds3231_snapshot_status(data);
+
+	return 0;
+}
+
+/* STATUS.OSF as last seen, the time is not valid until it is set again */
+static bool ds3231_osf(struct ds3231_data *data)
+{
+	return data->shadow_valid &&
+	       (data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] & DS3231_STATUS_OSF) != 0U;
+}
+
+#ifdef CONFIG_RTC_ALARM
+/* Read STATUS first, then clear those of req->clear_flags that are set */
+static void ds3231_status_take_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	if (req->len == 0U) {
+		ds3231_req_read(req, DS3231_STATUS, req->buf, 1);
+		return;
+	}
+
+	ds3231_status_clear_prepare(dev, req);
+}
+
+static int ds3231_status_take_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (req->len != 0U) {
+		return ds3231_status_clear_complete(dev, req);
+	}
+
+	data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] = req->buf[0];
+	ds3231_snapshot_status(data);
+
+	req->clear_flags &= req->buf[0];
+	if (req->clear_flags == 0U) {
+		return 0;
+	}
+
+	req->len = 1U;
+
+	return -EAGAIN;
+}
+
+/*
+ * Test and clear STATUS flags. Both steps are one request, so a flag set once is taken
+ * by exactly one caller. On return flags holds the flags that were set.
+ */
+static int ds3231_status_take(const struct device *dev, uint8_t *flags)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_init(&req, ds3231_status_take_prepare, ds3231_status_take_complete);
+	req.len = 0U;
+	req.clear_flags = *flags;
+
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		return err;
+	}
+
+	*flags = req.clear_flags;
+
+	return 0;
+}
+
+/*
+ * INTCN routes alarms to INT/SQW. It stays cleared while the 1 Hz square wave is in use, and
+ * while no alarm is enabled on an instance with a sqw-frequency square wave.
+ */
+static uint8_t ds3231_control_intcn(const struct device *dev, uint8_t control)
+{
+	const struct ds3231_config *config = dev->config;
+#ifdef DS3231_UPDATE_IN_USE
+	struct ds3231_data *data = dev->data;
+
+	if (data->update_callback != NULL) {
+		return 0U;
+	}
+#endif /* DS3231_UPDATE_IN_USE */
+
+	if ((control & (DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE)) == 0U) {
+		return config->control & DS3231_CONTROL_INTCN;
+	}
+
+	return DS3231_CONTROL_INTCN;
+}
+#endif /* CONFIG_RTC_ALARM */
+
+/*
+ * Unix time of the time registers. Consecutive reads mostly share the date, so the
+ * calendar is only converted when the day or date registers changed.
+ */
+static int64_t ds3231_epoch_decode(const struct device *dev, const uint8_t *regs)
+{
+	struct ds3231_data *data = dev->data;
+	uint32_t date = sys_get_le32(&regs[3]);
+	k_spinlock_key_t key = k_spin_lock(&data->date_lock);
+	bool hit = data->date_valid && data->date_regs == date;
+	int32_t days = data->date_days;
+
+	k_spin_unlock(&data->date_lock, key);
+
+	if (!hit) {
+		days = ds3231_codec_days_decode(regs);
+
+		key = k_spin_lock(&data->date_lock);
+		data->date_regs = date;
+		data->date_days = days;
+		data->date_valid = true;
+		k_spin_unlock(&data->date_lock, key);
+	}
+
+	return (int64_t)days * DS3231_SECONDS_PER_DAY + ds3231_codec_sod_decode(regs);
+}
+
+/* Encode Unix time into the time registers, reusing the date of the last conversion */
+static int ds3231_epoch_encode(const struct device *dev, int64_t seconds, uint8_t *regs)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key;
+	int32_t days;
+	uint32_t date;
+	bool hit;
+
+	if (seconds < DS3231_EPOCH_MIN || seconds > DS3231_EPOCH_MAX) {
+		return -EINVAL;
+	}
+
+	days = seconds / DS3231_SECONDS_PER_DAY;
+	ds3231_codec_sod_encode(seconds % DS3231_SECONDS_PER_DAY, regs);
+
+	key = k_spin_lock(&data->date_lock);
+	hit = data->date_valid && data->date_days == days;
+	date = data->date_regs;
+	k_spin_unlock(&data->date_lock, key);
+
+	if (hit) {
+		sys_put_le32(date, &regs[3]);
+		return 0;
+	}
+
+	ds3231_codec_days_encode(days, regs);
+
+	key = k_spin_lock(&data->date_lock);
+	data->date_regs = sys_get_le32(&regs[3]);
+	data->date_days = days;
+	data->date_valid = true;
+	k_spin_unlock(&data->date_lock, key);
+
+	return 0;
+}
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+/* A stale read extrapolates past the resync interval, when the chip could not be read */
+static bool ds3231_time_cache_get_ms(const struct device *dev, int64_t *ms, bool stale)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key;
+	int64_t elapsed;
+
+	if (config->cache_resync_ms == 0U) {
+		return false;
+	}
+
+	key = k_spin_lock(&data->cache_lock);
+	elapsed = k_uptime_get() - data->cache_anchor_ms;
+
+	if (!data->cache_valid || elapsed < 0 ||
+	    (!stale && elapsed >= config->cache_resync_ms)) {
+		if (!stale) {
+			data->cache_misses++;
+			DS3231_STATS_INC(data, cache_misses);
+		}
+		k_spin_unlock(&data->cache_lock, key);
+		return false;
+	}
+
+	/* A resync may move the estimate back by the drift of the uptime against the chip */
+	*ms = MAX(data->cache_ms + elapsed, data->cache_served_ms);
+	data->cache_served_ms = *ms;
+	if (stale) {
+		data->cache_stale++;
+	} else {
+		data->cache_hits++;
+		DS3231_STATS_INC(data, cache_hits);
+	}
+	data->time_stale = stale;
+	k_spin_unlock(&data->cache_lock, key);
+
+	if (stale) {
+		LOG_WRN("chip not readable, time extrapolated over %lld ms", elapsed);
+	}
+
+	return true;
+}
+
+static bool ds3231_time_cache_get(const struct device *dev, struct rtc_time *timeptr,
+				  bool stale)
+{
+	time_t seconds;
+	int64_t ms;
+
+	if (!ds3231_time_cache_get_ms(dev, &ms, stale)) {
+		return false;
+	}
+
+	seconds = (time_t)(ms / MSEC_PER_SEC);
+	memset(timeptr, 0U, sizeof(*timeptr));
+	gmtime_r(&seconds, (struct tm *)timeptr);
+
+	return true;
+}
+
+/*
+ * Anchor the cache to a time written to the chip, aligned, or read from it. A read only tells
+ * that the chip is somewhere within that second. An estimate that falls within it is kept,
+ * along with its alignment, else the start of the second is the new, lagging, estimate.
+ */
+static void ds3231_time_cache_put(const struct device *dev, int64_t seconds, bool aligned)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->cache_lock);
+	int64_t now = k_uptime_get();
+	int64_t start_ms = seconds * MSEC_PER_SEC;
+	int64_t estimate_ms = data->cache_ms + now - data->cache_anchor_ms;
+
+	if (aligned) {
+		/* A write may set the time back */
+		data->cache_ms = start_ms;
+		data->cache_served_ms = start_ms;
+		data->cache_aligned = true;
+	} else if (data->cache_valid && estimate_ms >= start_ms &&
+		   estimate_ms < start_ms + MSEC_PER_SEC) {
+		data->cache_ms = estimate_ms;
+	} else {
+		data->cache_ms = start_ms;
+		data->cache_aligned = false;
+		if (!data->cache_valid) {
+			data->cache_served_ms = start_ms;
+		}
+	}
+	data->cache_anchor_ms = now;
+	data->cache_valid = true;
+	data->time_stale = false;
+	k_spin_unlock(&data->cache_lock, key);
+}
+
+#ifdef DS3231_UPDATE_IN_USE
+/* Re-anchor the cache on a 1 Hz edge, which marks the exact start of a second */
+static void ds3231_time_cache_edge(struct ds3231_data *data)
+{
+	k_spinlock_key_t key = k_spin_lock(&data->cache_lock);
+	int64_t now = k_uptime_get();
+	int64_t elapsed = now - data->cache_anchor_ms;
+
+	int64_t estimate_ms = data->cache_ms + elapsed;
+
+	if (data->cache_valid && elapsed >= 0) {
+		/*
+		 * An aligned estimate is off by the drift only, the edge is the nearest second.
+		 * Otherwise it lags the chip by up to a second, which the edge ends.
+		 */
+		if (data->cache_aligned) {
+			data->cache_ms = (estimate_ms + MSEC_PER_SEC / 2) / MSEC_PER_SEC *
+					 MSEC_PER_SEC;
+		} else {
+			data->cache_ms = (estimate_ms + MSEC_PER_SEC - 1) / MSEC_PER_SEC *
+					 MSEC_PER_SEC;
+		}
+		data->cache_anchor_ms = now;
+		data->cache_aligned = true;
+	}
+	k_spin_unlock(&data->cache_lock, key);
+}
+#endif /* DS3231_UPDATE_IN_USE */
+
+int ds3231_time_cache_invalidate(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->cache_lock);
+
+	data->cache_valid = false;
+	k_spin_unlock(&data->cache_lock, key);
+
+	return 0;
+}
+
+int ds3231_time_cache_get_stats(const struct device *dev, struct ds3231_time_cache_stats *stats)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->cache_lock);
+
+	stats->hits = data->cache_hits;
+	stats->misses = data->cache_misses;
+	stats->stale = data->cache_stale;
+	k_spin_unlock(&data->cache_lock, key);
+
+	return 0;
+}
+
+int ds3231_time_cache_stale(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+
+	return data->time_stale ? 1 : 0;
+}
+#else
+int ds3231_time_cache_invalidate(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return -ENOTSUP;
+}
+
+int ds3231_time_cache_get_stats(const struct device *dev, struct ds3231_time_cache_stats *stats)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(stats);
+
+	return -ENOTSUP;
+}
+
+int ds3231_time_cache_stale(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return -ENOTSUP;
+}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+/* Cycle counter extended to 64 bits, called with ts_lock held */
+static uint64_t ds3231_ts_cycles(struct ds3231_data *data)
+{
+#ifdef CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER
+	ARG_UNUSED(data);
+
+	return k_cycle_get_64();
+#else
+	uint32_t now = k_cycle_get_32();
+
+	if (now < data->ts_cycles_last) {
+		data->ts_cycles_high++;
+	}
+	data->ts_cycles_last = now;
+
+	return ((uint64_t)data->ts_cycles_high << 32) | now;
+#endif /* CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER */
+}
+
+/*
+ * Forget the edge to second mapping when the square wave phase moves. The period estimate
+ * stays valid. A time set by the user may go back, so that also resets monotonicity.
+ */
+static void ds3231_ts_reset(struct ds3231_data *data, bool set)
+{
+	k_spinlock_key_t key = k_spin_lock(&data->ts_lock);
+
+	data->ts_anchored = false;
+	data->ts_edges = 0U;
+	if (set) {
+		data->ts_last_ns = INT64_MIN;
+	}
+	k_spin_unlock(&data->ts_lock, key);
+}
+
+/* Timestamp a square wave edge and refine the period estimate, called from the ISR */
+static void ds3231_ts_edge(struct ds3231_data *data)
+{
+	k_spinlock_key_t key = k_spin_lock(&data->ts_lock);
+	uint64_t nominal = sys_clock_hw_cycles_per_sec();
+	uint64_t now = ds3231_ts_cycles(data);
+	uint64_t delta = now - data->ts_edge_cycles;
+	uint64_t seconds = (delta + nominal / 2U) / nominal;
+	uint64_t period;
+	uint64_t dev;
+
+	data->ts_edge_cycles = now;
+
+	if (data->ts_edges == 0U) {
+		/* First edge since the square wave started, nothing to measure against */
+		data->ts_edges = 1U;
+		k_spin_unlock(&data->ts_lock, key);
+		return;
+	}
+
+	if (seconds == 0U || seconds > UINT16_MAX ||
+	    (delta > seconds * nominal ? delta - seconds * nominal : seconds * nominal - delta) >
+		    seconds * nominal * DS3231_TS_TOLERANCE_PPM / 1000000U) {
+		/* Not a whole number of seconds, a glitch or a counter wrap went unnoticed */
+		data->ts_anchored = false;
+		data->ts_edges = 1U;
+		k_spin_unlock(&data->ts_lock, key);
+		return;
+	}
+
+	/* Missed edges still count the seconds, but only single periods are averaged */
+	data->ts_edges += seconds;
+	if (seconds == 1U) {
+		period = delta << DS3231_TS_FRAC_BITS;
+		if (data->ts_periods == 0U) {
+			data->ts_period = period;
+			data->ts_period_dev = 0U;
+		} else {
+			dev = (period > data->ts_period) ? period - data->ts_period
+							 : data->ts_period - period;
+			data->ts_period_dev = data->ts_period_dev -
+					      (data->ts_period_dev >> DS3231_TS_AVG_SHIFT) +
+					      (dev >> DS3231_TS_AVG_SHIFT);
+			/* Plain average until the running average has enough history */
+			if (data->ts_periods < BIT(DS3231_TS_AVG_SHIFT)) {
+				data->ts_period = (data->ts_period * data->ts_periods + period) /
+						  (data->ts_periods + 1U);
+			} else {
+				data->ts_period = data->ts_period -
+						  (data->ts_period >> DS3231_TS_AVG_SHIFT) +
+						  (period >> DS3231_TS_AVG_SHIFT);
+			}
+		}
+		data->ts_periods++;
+	}
+	k_spin_unlock(&data->ts_lock, key);
+}
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+/* Write the time registers encoded in req->buf, then clear a flagged oscillator stop */
+static void ds3231_set_time_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	if (req->len == 0U) {
+		ds3231_req_write(req, DS3231_SECONDS, req->buf, DS3231_TIME_REGS);
+		return;
+	}
+
+	ds3231_status_clear_prepare(dev, req);
+}
+
+static int ds3231_set_time_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	int64_t seconds;
+
+	if (req->len != 0U) {
+		return ds3231_status_clear_complete(dev, req);
+	}
+
+	seconds = ds3231_epoch_decode(dev, req->buf);
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+	/* Writing the seconds register restarts the countdown chain, so the anchor is exact */
+	ds3231_time_cache_put(dev, seconds, true);
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+	/* The restarted countdown chain also moves the square wave edges */
+	ds3231_ts_reset(dev->data, true);
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+	ds3231_snapshot_time(dev->data, seconds);
+
+	if (ds3231_osf(dev->data)) {
+		req->len = 1U;
+		req->clear_flags = DS3231_STATUS_OSF;
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+static void ds3231_req_set_regs(struct ds3231_async_req *req)
+{
+	ds3231_req_init(req, ds3231_set_time_prepare, ds3231_set_time_complete);
+	ds3231_stats_req_op(req, DS3231_STATS_SET_TIME);
+	req->len = 0U;
+}
+
+static int ds3231_req_set_time(struct ds3231_async_req *req, const struct rtc_time *timeptr)
+{
+	int err;
+
+	err = ds3231_codec_time_encode(timeptr, req->buf);
+	if (err != 0) {
+		LOG_ERR("invalid time");
+		return err;
+	}
+
+	ds3231_req_set_regs(req);
+
+	return 0;
+}
+
+static int ds3231_get_time_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct rtc_time *timeptr = &req->time;
+	int64_t seconds;
+
+	if (ds3231_osf(dev->data)) {
+		return -ENODATA;
+	}
+
+	seconds = ds3231_epoch_decode(dev, req->buf);
+
+	ds3231_codec_time_decode(req->buf, timeptr);
+	LOG_DBG("get time: year = %d, mon = %d, mday = %d, wday = %d, hour = %d, "
+		"min = %d, sec = %d",
+		timeptr->tm_year, timeptr->tm_mon, timeptr->tm_mday, timeptr->tm_wday,
+		timeptr->tm_hour, timeptr->tm_min, timeptr->tm_sec);
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+	ds3231_time_cache_put(dev, seconds, false);
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+	ds3231_snapshot_time(dev->data, seconds);
+
+	return 0;
+}
+
+static void ds3231_req_get_time(struct ds3231_async_req *req)
+{
+	ds3231_req_init(req, NULL, ds3231_get_time_complete);
+	ds3231_stats_req_op(req, DS3231_STATS_GET_TIME);
+	ds3231_req_read(req, DS3231_SECONDS, req->buf, DS3231_TIME_REGS);
+}
+
+static int ds3231_set_time(const struct device *dev, const struct rtc_time *timeptr)
+{
+	struct ds3231_async_req req;
+	int ret;
+
+	ret = ds3231_req_set_time(&req, timeptr);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = ds3231_req_wait(dev, &req);
+	if (ret) {
+		LOG_ERR("Error when setting time: %i", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int ds3231_get_time(const struct device *dev, struct rtc_time *timeptr)
+{
+	struct ds3231_async_req req;
+	int err;
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+	if (ds3231_time_cache_get(dev, timeptr, false)) {
+		return 0;
+	}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+	ds3231_req_get_time(&req);
+	err = ds3231_req_wait(dev, &req);
+#ifdef DS3231_TIME_CACHE_IN_USE
+	if (err != 0 && err != -ENODATA && ds3231_time_cache_get(dev, timeptr, true)) {
+		return 0;
+	}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+	if (err != 0) {
+		return err;
+	}
+
+	*timeptr = req.time;
+
+	return 0;
+}
+
+static int ds3231_get_epoch_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	if (ds3231_osf(dev->data)) {
+		return -ENODATA;
+	}
+
+	req->seconds = ds3231_epoch_decode(dev, req->buf);
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+	ds3231_time_cache_put(dev, req->seconds, false);
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+	ds3231_snapshot_time(dev->data, req->seconds);
+
+	return 0;
+}
+
+/* Read the time from the chip, bypassing the time cache */
+static int ds3231_read_epoch(const struct device *dev, int64_t *seconds)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_init(&req, NULL, ds3231_get_epoch_complete);
+	ds3231_stats_req_op(&req, DS3231_STATS_GET_TIME);
+	ds3231_req_read(&req, DS3231_SECONDS, req.buf, DS3231_TIME_REGS);
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		return err;
+	}
+
+	*seconds = req.seconds;
+
+	return 0;
+}
+
+int ds3231_get_epoch_ms(const struct device *dev, int64_t *ms)
+{
+#ifdef DS3231_TIMESTAMP_IN_USE
+	struct ds3231_timestamp ts;
+#endif /* DS3231_TIMESTAMP_IN_USE */
+	int64_t seconds;
+	int err;
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+	/* Interpolated between the seconds edges, the closest to the chip there is */
+	if (ds3231_timestamp_get(dev, &ts) == 0) {
+		*ms = ts.ns / NSEC_PER_MSEC;
+		return 0;
+	}
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+#ifdef DS3231_TIME_CACHE_IN_USE
+	if (ds3231_time_cache_get_ms(dev, ms, false)) {
+		return 0;
+	}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+	err = ds3231_read_epoch(dev, &seconds);
+#ifdef DS3231_TIME_CACHE_IN_USE
+	if (err != 0 && err != -ENODATA && ds3231_time_cache_get_ms(dev, ms, true)) {
+		return 0;
+	}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+	if (err != 0) {
+		return err;
+	}
+
+	*ms = seconds * MSEC_PER_SEC;
+
+	return 0;
+}
+
+int ds3231_get_epoch(const struct device *dev, int64_t *seconds)
+{
+	int64_t ms;
+	int err;
+
+	err = ds3231_get_epoch_ms(dev, &ms);
+	if (err != 0) {
+		return err;
+	}
+
+	*seconds = ms / MSEC_PER_SEC;
+
+	return 0;
+}
+
+int ds3231_set_epoch(const struct device *dev, int64_t seconds)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	err = ds3231_epoch_encode(dev, seconds, req.buf);
+	if (err != 0) {
+		LOG_ERR("invalid time");
+		return err;
+	}
+
+	ds3231_req_set_regs(&req);
+
+	return ds3231_req_wait(dev, &req);
+}
+
+static int64_t ds3231_uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+/* Bus clock of the instance, the standard rate if the controller does not tell */
+static uint32_t ds3231_bus_hz(const struct device *dev)
+{
+	const struct ds3231_config *config = dev->config;
+	uint32_t i2c_cfg;
+
+	if (i2c_get_config(config->i2c.bus, &i2c_cfg) != 0) {
+		return I2C_BITRATE_STANDARD;
+	}
+
+	switch (I2C_SPEED_GET(i2c_cfg)) {
+	case I2C_SPEED_FAST:
+		return I2C_BITRATE_FAST;
+	case I2C_SPEED_FAST_PLUS:
+		return I2C_BITRATE_FAST_PLUS;
+	case I2C_SPEED_HIGH:
+		return I2C_BITRATE_HIGH;
+	case I2C_SPEED_ULTRA:
+		return I2C_BITRATE_ULTRA;
+	default:
+		return I2C_BITRATE_STANDARD;
+	}
+}
+
+/*
+ * Measure the time from starting a time write to the seconds register being written, from
+ * a time read through the same request path. The read is address, register, address and 7
+ * data bytes. The seconds register is written with the third byte of the write, after
+ * address and register. Whatever the read took beyond its bytes is call overhead, which the
+ * write pays as well.
+ */
+static int ds3231_align_latency(const struct device *dev, int64_t *latency_ns)
+{
+	int64_t byte_ns = (int64_t)9 * NSEC_PER_SEC / ds3231_bus_hz(dev);
+	int64_t duration_ns;
+	uint32_t start;
+	int64_t seconds;
+	int err;
+
+	start = k_cycle_get_32();
+	err = ds3231_read_epoch(dev, &seconds);
+	duration_ns = k_cyc_to_ns_floor64(k_cycle_get_32() - start);
+	if (err != 0 && err != -ENODATA) {
+		return err;
+	}
+
+	*latency_ns = MAX(duration_ns - (DS3231_TIME_REGS + 3) * byte_ns, 0) + 3 * byte_ns;
+
+	return 0;
+}
+
+/* Sleep until close to the uptime, then busy wait for the rest */
+static void ds3231_align_wait(int64_t uptime_ns)
+{
+	int64_t wait_ns = uptime_ns - ds3231_uptime_ns();
+
+	if (wait_ns > DS3231_ALIGN_BUSY_WAIT_NS) {
+		k_sleep(K_NSEC(wait_ns - DS3231_ALIGN_BUSY_WAIT_NS));
+		wait_ns = uptime_ns - ds3231_uptime_ns();
+	}
+
+	if (wait_ns > 0) {
+		k_busy_wait(wait_ns / NSEC_PER_USEC);
+	}
+}
+
+/*
+ * Measure the seconds edge expected at edge_ns after an aligned write. A timestamped square
+ * wave edge costs no bus traffic, otherwise the time registers are polled across the window.
+ */
+static int ds3231_align_verify(const struct device *dev, int64_t seconds, int64_t edge_ns,
+			       struct ds3231_align_result *res)
+{
+	int64_t prev_ns = -1;
+	int64_t read_ns;
+	int64_t before;
+	int64_t now;
+	int err;
+
+#ifdef DS3231_SQW_EDGES_IN_USE
+	uint32_t count;
+
+	ds3231_align_wait(edge_ns + DS3231_ALIGN_WINDOW_NS);
+	if (ds3231_sqw_edge_get(dev, &count, &read_ns) == 0 &&
+	    read_ns > edge_ns - NSEC_PER_SEC / 2) {
+		res->phase_ns = read_ns - edge_ns;
+		res->phase_error_ns = k_ticks_to_ns_ceil32(1);
+		return (llabs(res->phase_ns) <= DS3231_ALIGN_WINDOW_NS) ? 0 : -ERANGE;
+	}
+#endif /* DS3231_SQW_EDGES_IN_USE */
+
+	ds3231_align_wait(edge_ns - DS3231_ALIGN_WINDOW_NS);
+
+	do {
+		before = ds3231_uptime_ns();
+		err = ds3231_read_epoch(dev, &now);
+		if (err != 0) {
+			return err;
+		}
+
+		read_ns = before + (ds3231_uptime_ns() - before) / 2;
+
+		if (now != seconds) {
+			/* An edge before the first read lies outside the window */
+			if (now != seconds + 1 || prev_ns < 0) {
+				res->phase_ns = -DS3231_ALIGN_WINDOW_NS;
+				res->phase_error_ns = 0U;
+				return -ERANGE;
+			}
+
+			res->phase_ns = prev_ns + (read_ns - prev_ns) / 2 - edge_ns;
+			res->phase_error_ns = (read_ns - prev_ns) / 2;
+			return 0;
+		}
+
+		prev_ns = read_ns;
+		k_busy_wait(DS3231_ALIGN_POLL_US);
+	} while (read_ns < edge_ns + DS3231_ALIGN_WINDOW_NS);
+
+	res->phase_ns = DS3231_ALIGN_WINDOW_NS;
+	res->phase_error_ns = 0U;
+
+	return -ERANGE;
+}
+
+int ds3231_set_time_aligned(const struct device *dev, int64_t ref_ns, int64_t ref_uptime_ns,
+			    struct ds3231_align_result *res)
+{
+	int64_t latency_ns;
+	int64_t write_ns;
+	int64_t seconds;
+	int err;
+
+	err = ds3231_align_latency(dev, &latency_ns);
+	if (err != 0) {
+		return err;
+	}
+
+	/* The next reference second boundary the write can still be scheduled for */
+	seconds = (ref_ns + (ds3231_uptime_ns() - ref_uptime_ns) + latency_ns +
+		   DS3231_ALIGN_BUSY_WAIT_NS) / NSEC_PER_SEC + 1;
+	write_ns = ref_uptime_ns + (seconds * NSEC_PER_SEC - ref_ns) - latency_ns;
+
+	ds3231_align_wait(write_ns);
+
+	err = ds3231_set_epoch(dev, seconds);
+	if (err != 0 || res == NULL) {
+		return err;
+	}
+
+	res->latency_ns = latency_ns;
+
+	/* The restarted second ends one second after the write landed */
+	return ds3231_align_verify(dev, seconds, write_ns + latency_ns + NSEC_PER_SEC, res);
+}
+
+int ds3231_set_epoch_ms(const struct device *dev, int64_t ms)
+{
+	/* The chip counts whole seconds, so the write waits for the next one to start */
+	return ds3231_set_time_aligned(dev, ms * NSEC_PER_MSEC, ds3231_uptime_ns(), NULL);
+}
+
+/* 10-bit two's complement in 0.25 degC steps, left-aligned in MSB:LSB */
+static int32_t ds3231_temp_decode(const uint8_t *regs)
+{
+	return ((int8_t)regs[0] * 4 + FIELD_GET(DS3231_TEMP_LSB_DATA, regs[1])) * 250;
+}
+
+static int ds3231_get_temp_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	req->temp_mdegc = ds3231_temp_decode(req->buf);
+	ds3231_snapshot_temp(dev->data, req->temp_mdegc);
+
+	return 0;
+}
+
+int ds3231_get_time_async(const struct device *dev, struct ds3231_async_req *req,
+			  ds3231_async_cb_t cb, void *user_data)
+{
+#ifdef DS3231_TIME_CACHE_IN_USE
+	if (ds3231_time_cache_get(dev, &req->time, false)) {
+		req->cb = cb;
+		req->user_data = user_data;
+		ds3231_req_finish(dev, req, 0);
+		return 0;
+	}
+#endif /* DS3231_TIME_CACHE_IN_USE */
+
+	ds3231_req_get_time(req);
+	req->cb = cb;
+	req->user_data = user_data;
+	ds3231_req_submit(dev, req);
+
+	return 0;
+}
+
+int ds3231_set_time_async(const struct device *dev, struct ds3231_async_req *req,
+			  const struct rtc_time *timeptr, ds3231_async_cb_t cb, void *user_data)
+{
+	int err;
+
+	err = ds3231_req_set_time(req, timeptr);
+	if (err != 0) {
+		return err;
+	}
+
+	req->cb = cb;
+	req->user_data = user_data;
+	ds3231_req_submit(dev, req);
+
+	return 0;
+}
+
+static void ds3231_req_get_temp(struct ds3231_async_req *req)
+{
+	ds3231_req_init(req, NULL, ds3231_get_temp_complete);
+	ds3231_stats_req_op(req, DS3231_STATS_GET_TEMP);
+	ds3231_req_read(req, DS3231_TEMP_MSB, req->buf, 2);
+}
+
+int ds3231_get_temp_async(const struct device *dev, struct ds3231_async_req *req,
+			  ds3231_async_cb_t cb, void *user_data)
+{
+	ds3231_req_get_temp(req);
+	req->cb = cb;
+	req->user_data = user_data;
+	ds3231_req_submit(dev, req);
+
+	return 0;
+}
+
+int ds3231_get_temp(const struct device *dev, int32_t *temp_mdegc)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_get_temp(&req);
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		return err;
+	}
+
+	*temp_mdegc = req.temp_mdegc;
+
+	return 0;
+}
+
+/* Refresh the shadow, the alarm registers, the time and the temperature from one burst */
+static int ds3231_reg_dump_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+	const uint8_t *regs = req->msgs[1].buf;
+
+	memcpy(data->shadow, &regs[DS3231_CONTROL], sizeof(data->shadow));
+	data->shadow_valid = true;
+	ds3231_snapshot_status(data);
+
+#ifdef CONFIG_RTC_ALARM
+	memcpy(data->alarm_regs, &regs[DS3231_ALARM_1_SECONDS], sizeof(data->alarm_regs));
+	data->alarm_regs_valid = true;
+#endif /* CONFIG_RTC_ALARM */
+
+	req->temp_mdegc = ds3231_temp_decode(&regs[DS3231_TEMP_MSB]);
+	ds3231_snapshot_temp(data, req->temp_mdegc);
+
+	if (ds3231_osf(data)) {
+		return 0;
+	}
+
+	req->seconds = ds3231_epoch_decode(dev, regs);
+#ifdef DS3231_TIME_CACHE_IN_USE
+	ds3231_time_cache_put(dev, req->seconds, false);
+#endif /* DS3231_TIME_CACHE_IN_USE */
+	ds3231_snapshot_time(data, req->seconds);
+
+	return 0;
+}
+
+int ds3231_reg_dump(const struct device *dev, struct ds3231_reg_dump *dump)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_init(&req, NULL, ds3231_reg_dump_complete);
+	ds3231_req_read(&req, DS3231_SECONDS, dump->regs, sizeof(dump->regs));
+
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		LOG_ERR("failed to read registers (err %d)", err);
+		return err;
+	}
+
+	dump->time_valid = (dump->regs[DS3231_STATUS] & DS3231_STATUS_OSF) == 0U;
+	dump->seconds = dump->time_valid ? req.seconds : 0;
+	dump->temp_mdegc = req.temp_mdegc;
+
+	return 0;
+}
+
+#ifdef CONFIG_RTC_DS3231_GROUP
+#define DS3231_GROUP_END UINT16_MAX
+
+static const struct device *ds3231_group_root(const struct ds3231_group *group, uint16_t idx)
+{
+	const struct ds3231_config *config = group->devs[idx]->config;
+
+	return config->root_bus;
+}
+
+static const struct device *ds3231_group_bus(const struct ds3231_group *group, uint16_t idx)
+{
+	const struct ds3231_config *config = group->devs[idx]->config;
+
+	return config->i2c.bus;
+}
+
+/* Devices on the same root bus are adjacent, and within them those on the same channel */
+static bool ds3231_group_before(const struct ds3231_group *group, uint16_t a, uint16_t b)
+{
+	uintptr_t root_a = (uintptr_t)ds3231_group_root(group, a);
+	uintptr_t root_b = (uintptr_t)ds3231_group_root(group, b);
+
+	if (root_a != root_b) {
+		return root_a < root_b;
+	}
+
+	return (uintptr_t)ds3231_group_bus(group, a) < (uintptr_t)ds3231_group_bus(group, b);
+}
+
+/* The time registers, or all registers in one burst for the temperature as well */
+static void ds3231_group_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_group_sample *sample = CONTAINER_OF(req, struct ds3231_group_sample, req);
+
+	ARG_UNUSED(dev);
+
+	sample->uptime_ns = ds3231_uptime_ns();
+
+	if ((sample->group->flags & DS3231_GROUP_TEMP) != 0U) {
+		ds3231_req_read(req, DS3231_SECONDS, sample->regs, sizeof(sample->regs));
+	} else {
+		ds3231_req_read(req, DS3231_SECONDS, req->buf, DS3231_TIME_REGS);
+	}
+}
+
+static int ds3231_group_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_group_sample *sample = CONTAINER_OF(req, struct ds3231_group_sample, req);
+
+	sample->uptime_ns += (ds3231_uptime_ns() - sample->uptime_ns) / 2;
+
+	if (req->msgs[1].buf != sample->regs) {
+		return ds3231_get_epoch_complete(dev, req);
+	}
+
+	(void)ds3231_reg_dump_complete(dev, req);
+	sample->temp_mdegc = req->temp_mdegc;
+
+	return ds3231_osf(dev->data) ? -ENODATA : 0;
+}
+
+static void ds3231_group_submit(struct ds3231_group *group, uint16_t idx);
+
+static void ds3231_group_done(const struct device *dev, struct ds3231_async_req *req, int result,
+			      void *user_data)
+{
+	struct ds3231_group_sample *sample = user_data;
+	struct ds3231_group *group = sample->group;
+
+	ARG_UNUSED(dev);
+
+	sample->err = result;
+	if (result == 0) {
+		sample->seconds = req->seconds;
+	}
+
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	/* The next device on the same root bus follows, other root buses run their own chains */
+	if (sample->next != DS3231_GROUP_END) {
+		ds3231_group_submit(group, sample->next);
+	}
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+
+	k_sem_give(&group->done);
+}
+
+static void ds3231_group_submit(struct ds3231_group *group, uint16_t idx)
+{
+	struct ds3231_group_sample *sample = &group->samples[idx];
+	struct ds3231_async_req *req = &sample->req;
+
+	ds3231_req_init(req, ds3231_group_prepare, ds3231_group_complete);
+	ds3231_stats_req_op(req, DS3231_STATS_GET_TIME);
+	req->cb = ds3231_group_done;
+	req->user_data = sample;
+	ds3231_req_submit(group->devs[idx], req);
+}
+
+int ds3231_group_init(struct ds3231_group *group, const struct device *const *devs,
+		      struct ds3231_group_sample *samples, size_t count)
+{
+	size_t j;
+
+	if (count == 0U || count >= DS3231_GROUP_END) {
+		return -EINVAL;
+	}
+
+	group->devs = devs;
+	group->samples = samples;
+	group->count = count;
+	group->reverse = false;
+	k_sem_init(&group->done, 0, count);
+
+	/* samples[k].order is the k-th device to read, sorted by bus */
+	for (size_t i = 0; i < count; i++) {
+		if (!device_is_ready(devs[i])) {
+			return -ENODEV;
+		}
+
+		samples[i].group = group;
+
+		for (j = i; j > 0 && ds3231_group_before(group, i, samples[j - 1].order); j--) {
+			samples[j].order = samples[j - 1].order;
+		}
+		samples[j].order = i;
+	}
+
+	return 0;
+}
+
+/* Index of the k-th device to read, the direction alternates between reads */
+static uint16_t ds3231_group_nth(const struct ds3231_group *group, uint16_t k)
+{
+	return group->samples[group->reverse ? group->count - 1U - k : k].order;
+}
+
+int ds3231_group_read(struct ds3231_group *group, uint32_t flags)
+{
+	struct ds3231_group_sample *samples = group->samples;
+	uint16_t prev = DS3231_GROUP_END;
+	uint16_t idx;
+	int err = 0;
+
+	group->flags = flags;
+	k_sem_reset(&group->done);
+
+	/*
+	 * Each mux channel is selected once per read. As the direction alternates, a read
+	 * starts on the channel the previous one left the mux on.
+	 */
+	for (uint16_t k = 0; k < group->count; k++) {
+		idx = ds3231_group_nth(group, k);
+		samples[idx].next = DS3231_GROUP_END;
+
+		if (prev != DS3231_GROUP_END &&
+		    ds3231_group_root(group, prev) == ds3231_group_root(group, idx)) {
+			samples[prev].next = idx;
+		}
+		prev = idx;
+	}
+
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	/* One chain per root bus, started once all are linked as a chain may complete at once */
+	prev = DS3231_GROUP_END;
+	for (uint16_t k = 0; k < group->count; k++) {
+		idx = ds3231_group_nth(group, k);
+
+		if (prev == DS3231_GROUP_END ||
+		    ds3231_group_root(group, prev) != ds3231_group_root(group, idx)) {
+			ds3231_group_submit(group, idx);
+		}
+		prev = idx;
+	}
+#else
+	for (uint16_t k = 0; k < group->count; k++) {
+		ds3231_group_submit(group, ds3231_group_nth(group, k));
+	}
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+
+	for (uint16_t k = 0; k < group->count; k++) {
+		(void)k_sem_take(&group->done, K_FOREVER);
+	}
+
+	group->reverse = !group->reverse;
+
+	for (uint16_t i = 0; i < group->count && err == 0; i++) {
+		err = samples[i].err;
+	}
+
+	return err;
+}
+
+#else
+
+int ds3231_group_init(struct ds3231_group *group, const struct device *const *devs,
+		      struct ds3231_group_sample *samples, size_t count)
+{
+	ARG_UNUSED(group);
+	ARG_UNUSED(devs);
+	ARG_UNUSED(samples);
+	ARG_UNUSED(count);
+
+	return -ENOTSUP;
+}
+
+int ds3231_group_read(struct ds3231_group *group, uint32_t flags)
+{
+	ARG_UNUSED(group);
+	ARG_UNUSED(flags);
+
+	return -ENOTSUP;
+}
+#endif /* CONFIG_RTC_DS3231_GROUP */
+
+/*
+ * A conversion is running while CONV (forced) or BSY (automatic TCXO cycle) is set. CONV
+ * clears itself, so it is never kept in the shadow.
+ */
+static bool ds3231_temp_busy_regs(struct ds3231_data *data, const uint8_t *ctrl_stat)
+{
+	data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] = ctrl_stat[0] & ~DS3231_CONTROL_CONV;
+	data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] = ctrl_stat[1];
+	ds3231_snapshot_status(data);
+
+	return (ctrl_stat[0] & DS3231_CONTROL_CONV) != 0U ||
+	       (ctrl_stat[1] & DS3231_STATUS_BSY) != 0U;
+}
+
+/* Read CONTROL and STATUS first, and only force a conversion if none is running */
+static void ds3231_temp_convert_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (req->len == 0U) {
+		ds3231_req_read(req, DS3231_CONTROL, req->buf, 2);
+		return;
+	}
+
+	req->buf[2] = data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] | DS3231_CONTROL_CONV;
+	ds3231_req_write(req, DS3231_CONTROL, &req->buf[2], 1);
+}
+
+static int ds3231_temp_convert_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	if (req->len != 0U) {
+		return 0;
+	}
+
+	if (ds3231_temp_busy_regs(dev->data, req->buf)) {
+		return -EBUSY;
+	}
+
+	req->len = 1U;
+
+	return -EAGAIN;
+}
+
+int ds3231_temp_convert(const struct device *dev)
+{
+	struct ds3231_async_req req;
+
+	ds3231_req_init(&req, ds3231_temp_convert_prepare, ds3231_temp_convert_complete);
+	req.len = 0U;
+
+	return ds3231_req_wait(dev, &req);
+}
+
+static int ds3231_temp_busy_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	req->len = ds3231_temp_busy_regs(dev->data, req->buf) ? 1U : 0U;
+
+	return 0;
+}
+
+int ds3231_temp_busy(const struct device *dev)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	ds3231_req_init(&req, NULL, ds3231_temp_busy_complete);
+	ds3231_req_read(&req, DS3231_CONTROL, req.buf, 2);
+
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		return err;
+	}
+
+	return req.len;
+}
+
+#ifdef CONFIG_RTC_ALARM
+static int ds3231_alarm_get_supported_fields(const struct device *dev, uint16_t id, uint16_t *mask)
+{
+
+	if (id == 0U) {
+		*mask = DS3231_RTC_ALARM_1_TIME_MASK;
+	} else if (id == 1U) {
+		*mask = DS3231_RTC_ALARM_2_TIME_MASK;
+	} else {
+		LOG_ERR("invalid ID %d", id);
+		return -EINVAL;
+	}
+	LOG_DBG("Supported mask is " PRINTF_BINARY_PATTERN_INT16,
+		PRINTF_BYTE_TO_BINARY_INT16(*mask));
+	return 0;
+}
+
+/* Copy the alarm registers into req->buf, reading them only if they are not cached */
+static void ds3231_alarm_get_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (data->alarm_regs_valid) {
+		memcpy(req->buf, data->alarm_regs, sizeof(data->alarm_regs));
+		req->num_msgs = 0;
+		return;
+	}
+
+	ds3231_req_read(req, DS3231_ALARM_1_SECONDS, req->buf, DS3231_ALARM_REGS);
+}
+
+static int ds3231_alarm_get_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	memcpy(data->alarm_regs, req->buf, sizeof(data->alarm_regs));
+	data->alarm_regs_valid = true;
+
+	return 0;
+}
+
+static int ds3231_alarm_get_time(const struct device *dev, uint16_t id, uint16_t *mask,
+				 struct rtc_time *timeptr)
+{
+	struct ds3231_async_req req;
+	int err;
+
+	if (id > 1U) {
+		LOG_ERR("invalid ID %d", id);
+		return -EINVAL;
+	}
+
+	ds3231_req_init(&req, ds3231_alarm_get_prepare, ds3231_alarm_get_complete);
+	ds3231_stats_req_op(&req, DS3231_STATS_ALARM_GET);
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		LOG_ERR("failed to read alarm registers (err %d)", err);
+		return err;
+	}
+
+	ds3231_codec_alarm_decode(
+		id, &req.buf[DS3231_ALARM_IDX((id == 0U) ? DS3231_ALARM_1_SECONDS
+							 : DS3231_ALARM_2_MINUTES)],
+		mask, timeptr);
+
+	return 0;
+}
+
+static int ds3231_alarm_encode(uint16_t id, uint16_t mask, const struct rtc_time *timeptr,
+			       uint8_t *regs)
+{
+	uint16_t supported;
+	int err;
+
+	if (id == 0U) {
+		supported = DS3231_RTC_ALARM_1_TIME_MASK;
+	} else if (id == 1U) {
+		supported = DS3231_RTC_ALARM_2_TIME_MASK;
+	} else {
+		LOG_ERR("invalid ID %d", id);
+		return -EINVAL;
+	}
+
+	if ((mask & ~supported) != 0U) {
+		LOG_ERR("unsupported alarm field mask 0x%04x", mask);
+		return -EINVAL;
+	}
+
+	err = ds3231_codec_alarm_encode(id, mask, timeptr, regs);
+	if (err != 0) {
+		LOG_ERR("invalid alarm time");
+		return err;
+	}
+
+	return 0;
+}
+
+/*
+ * Alarm registers encoded at the start of req->buf are written starting at req->reg,
+ * followed by CONTROL and STATUS, in one transaction. Alarm registers that do not end
+ * right before CONTROL are written in a first step of the same request. CONTROL is derived
+ * from the shadow with the masked update applied, and the requested STATUS flags are
+ * cleared. A masked INTCN is derived from the update callback and the enabled alarms when the
+ * transfer starts.
+ */
+static void ds3231_alarm_commit_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+	uint8_t *ctrl_stat = &req->buf[req->len];
+	uint8_t ctrl_value = req->ctrl_value;
+
+	if (req->reg + req->len != DS3231_CONTROL) {
+		ds3231_req_write(req, req->reg, req->buf, req->len);
+		return;
+	}
+
+	if (ds3231_req_reload(dev, req)) {
+		return;
+	}
+
+	ctrl_stat[0] = (data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] & ~req->ctrl_mask) |
+		       (ctrl_value & req->ctrl_mask);
+	if ((req->ctrl_mask & DS3231_CONTROL_INTCN) != 0U) {
+		ctrl_stat[0] = (ctrl_stat[0] & ~DS3231_CONTROL_INTCN) |
+			       ds3231_control_intcn(dev, ctrl_stat[0]);
+	}
+	ctrl_stat[1] = (data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] | DS3231_STATUS_FLAGS) &
+		       ~req->clear_flags;
+	ds3231_req_write(req, req->reg, req->buf, req->len + 2);
+}
+
+static int ds3231_alarm_commit_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (req->len > 0U) {
+		memcpy(&data->alarm_regs[DS3231_ALARM_IDX(req->reg)], req->buf, req->len);
+	}
+
+	if (req->reg + req->len != DS3231_CONTROL) {
+		req->reg = DS3231_CONTROL;
+		req->len = 0U;
+		return -EAGAIN;
+	}
+
+	data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] = req->buf[req->len];
+	data->shadow[DS3231_SHADOW_IDX(DS3231_STATUS)] &= ~req->clear_flags;
+	ds3231_snapshot_status(data);
+
+#if DS3231_INT1_GPIOS_IN_USE
+	const struct ds3231_config *config = dev->config;
+
+	if (config->int1.port != NULL) {
+		atomic_and(&data->alarm_pending, ~(atomic_val_t)req->clear_flags);
+		return ds3231_int1_enable(dev);
+	}
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+
+	return 0;
+}
+
+static void ds3231_req_alarm_commit(struct ds3231_async_req *req, uint8_t addr, uint8_t len,
+				    uint8_t ctrl_mask, uint8_t ctrl_value, uint8_t clear_flags)
+{
+	__ASSERT_NO_MSG(addr + len <= DS3231_CONTROL && len <= DS3231_ASYNC_BUF_SIZE - 2);
+
+	ds3231_req_init(req, ds3231_alarm_commit_prepare, ds3231_alarm_commit_complete);
+	ds3231_stats_req_op(req, DS3231_STATS_ALARM_SET);
+	req->reg = addr;
+	req->len = len;
+	req->ctrl_mask = ctrl_mask;
+	req->ctrl_value = ctrl_value;
+	req->clear_flags = clear_flags;
+}
+
+static int ds3231_alarm_write(const struct device *dev, uint16_t id, uint16_t mask,
+			      const struct rtc_time *timeptr)
+{
+	struct ds3231_async_req req;
+	uint8_t enable = (id == 0U) ? DS3231_CONTROL_A1IE : DS3231_CONTROL_A2IE;
+	uint8_t flag = (id == 0U) ? DS3231_STATUS_A1F : DS3231_STATUS_A2F;
+	int ret;
+
+	if (IS_ENABLED(DS3231_VALARM_IN_USE)) {
+		/* Both hardware alarms are reserved for the virtual alarms */
+		return -EBUSY;
+	}
+
+	LOG_DBG("Mask is " PRINTF_BINARY_PATTERN_INT16, PRINTF_BYTE_TO_BINARY_INT16(mask));
+
+	ret = ds3231_alarm_encode(id, mask, timeptr, req.buf);
+	if (ret != 0) {
+		return ret;
+	}
+
+	/*
+	 * Alarm 2 directly precedes CONTROL and STATUS, so it is programmed, enabled and its
+	 * flag cleared in one write. Alarm 1 is separated from them by alarm 2, and takes two.
+	 */
+	if (id == 0U) {
+		ds3231_req_alarm_commit(&req, DS3231_ALARM_1_SECONDS, 4,
+					enable | DS3231_CONTROL_INTCN, enable, flag);
+	} else {
+		ds3231_req_alarm_commit(&req, DS3231_ALARM_2_MINUTES, 3,
+					enable | DS3231_CONTROL_INTCN, enable, flag);
+	}
+
+	return ds3231_req_wait(dev, &req);
+}
+
+static int ds3231_alarm_set_time(const struct device *dev, uint16_t id, uint16_t mask,
+				 const struct rtc_time *timeptr)
+{
+	struct ds3231_data *data = dev->data;
+
+	if (id <= 1U) {
+		data->alarm_rearm_s[id] = 0U;
+	}
+
+	return ds3231_alarm_write(dev, id, mask, timeptr);
+}
+
+static int ds3231_req_alarms_program(const struct device *dev, struct ds3231_async_req *req,
+				     const struct ds3231_alarm_cfg *alarm1,
+				     const struct ds3231_alarm_cfg *alarm2)
+{
+	struct ds3231_data *data = dev->data;
+	uint8_t enable = 0U;
+	int ret;
+
+	ret = ds3231_alarm_encode(0U, alarm1->mask, &alarm1->time, &req->buf[0]);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = ds3231_alarm_encode(1U, alarm2->mask, &alarm2->time, &req->buf[4]);
+	if (ret != 0) {
+		return ret;
+	}
+
+	if (alarm1->enable) {
+		enable |= DS3231_CONTROL_A1IE;
+	}
+
+	if (alarm2->enable) {
+		enable |= DS3231_CONTROL_A2IE;
+	}
+
+	data->alarm_rearm_s[0] = 0U;
+	data->alarm_rearm_s[1] = 0U;
+
+	ds3231_req_alarm_commit(req, DS3231_ALARM_1_SECONDS, 7,
+				DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE | DS3231_CONTROL_INTCN, enable,
+				DS3231_STATUS_A1F | DS3231_STATUS_A2F);
+
+	return 0;
+}
+
+int ds3231_alarms_program(const struct device *dev, const struct ds3231_alarm_cfg *alarm1,
+			  const struct ds3231_alarm_cfg *alarm2)
+{
+	struct ds3231_async_req req;
+	int ret;
+
+	if (IS_ENABLED(DS3231_VALARM_IN_USE)) {
+		/* Both hardware alarms are reserved for the virtual alarms */
+		return -EBUSY;
+	}
+
+	ret = ds3231_req_alarms_program(dev, &req, alarm1, alarm2);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return ds3231_req_wait(dev, &req);
+}
+
+int ds3231_alarms_program_async(const struct device *dev, struct ds3231_async_req *req,
+				const struct ds3231_alarm_cfg *alarm1,
+				const struct ds3231_alarm_cfg *alarm2, ds3231_async_cb_t cb,
+				void *user_data)
+{
+	int ret;
+
+	if (IS_ENABLED(DS3231_VALARM_IN_USE)) {
+		/* Both hardware alarms are reserved for the virtual alarms */
+		return -EBUSY;
+	}
+
+	ret = ds3231_req_alarms_program(dev, req, alarm1, alarm2);
+	if (ret != 0) {
+		return ret;
+	}
+
+	req->cb = cb;
+	req->user_data = user_data;
+	ds3231_req_submit(dev, req);
+
+	return 0;
+}
+
+/* Length of one period in seconds, months have none */
+static const uint32_t ds3231_schedule_period_s[] = {
+	[DS3231_SCHEDULE_EVERY_SECOND] = 1U,
+	[DS3231_SCHEDULE_MINUTELY] = 60U,
+	[DS3231_SCHEDULE_HOURLY] = 3600U,
+	[DS3231_SCHEDULE_DAILY] = 86400U,
+	[DS3231_SCHEDULE_WEEKLY] = 604800U,
+	[DS3231_SCHEDULE_MONTHLY] = 0U,
+};
+
+/* Fields matched so the alarm repeats every period on its own */
+static const uint16_t ds3231_schedule_mask[] = {
+	[DS3231_SCHEDULE_EVERY_SECOND] = 0U,
+	[DS3231_SCHEDULE_MINUTELY] = RTC_ALARM_TIME_MASK_SECOND,
+	[DS3231_SCHEDULE_HOURLY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE,
+	[DS3231_SCHEDULE_DAILY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				  RTC_ALARM_TIME_MASK_HOUR,
+	[DS3231_SCHEDULE_WEEKLY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				   RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_WEEKDAY,
+	[DS3231_SCHEDULE_MONTHLY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				    RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_MONTHDAY,
+};
+
+/*
+ * Fields matched when the alarm is re-armed for each occurrence. The next coarser field
+ * repeats the match, which bounds the re-arm interval, e.g. below 28 days by the date.
+ */
+static const uint16_t ds3231_schedule_rearm_mask[] = {
+	[DS3231_SCHEDULE_EVERY_SECOND] = RTC_ALARM_TIME_MASK_SECOND,
+	[DS3231_SCHEDULE_MINUTELY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE,
+	[DS3231_SCHEDULE_HOURLY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				   RTC_ALARM_TIME_MASK_HOUR,
+	[DS3231_SCHEDULE_DAILY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				  RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_MONTHDAY,
+	[DS3231_SCHEDULE_WEEKLY] = RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE |
+				   RTC_ALARM_TIME_MASK_HOUR | RTC_ALARM_TIME_MASK_MONTHDAY,
+	[DS3231_SCHEDULE_MONTHLY] = 0U,
+};
+
+/* Largest ds3231_schedule.every whose re-arm mask matches nothing before the occurrence */
+static const uint8_t ds3231_schedule_every_max[] = {
+	[DS3231_SCHEDULE_EVERY_SECOND] = 59U,
+	[DS3231_SCHEDULE_MINUTELY] = 59U,
+	[DS3231_SCHEDULE_HOURLY] = 23U,
+	[DS3231_SCHEDULE_DAILY] = 27U,
+	[DS3231_SCHEDULE_WEEKLY] = 3U,
+	[DS3231_SCHEDULE_MONTHLY] = 1U,
+};
+
+/* 1970-01-01 was a Thursday */
+#define DS3231_EPOCH_WDAY 4
+
+/* First occurrence of a schedule after now, for periods of a fixed length */
+static int64_t ds3231_schedule_first(const struct ds3231_schedule *sched, int64_t now)
+{
+	int64_t period = ds3231_schedule_period_s[sched->period];
+	int64_t offset = 0;
+	int64_t first;
+
+	switch (sched->period) {
+	case DS3231_SCHEDULE_WEEKLY:
+		offset = ((sched->wday + 7 - DS3231_EPOCH_WDAY) % 7) * 86400;
+		__fallthrough;
+	case DS3231_SCHEDULE_DAILY:
+		offset += sched->hour * 3600;
+		__fallthrough;
+	case DS3231_SCHEDULE_HOURLY:
+		offset += sched->minute * 60;
+		__fallthrough;
+	case DS3231_SCHEDULE_MINUTELY:
+		offset += sched->second;
+		break;
+	default:
+		break;
+	}
+
+	first = now - now % period + offset;
+
+	return (first > now) ? first : first + period;
+}
+
+int ds3231_schedule_compile(uint16_t id, const struct ds3231_schedule *sched, int64_t now,
+			    struct ds3231_schedule_plan *plan)
+{
+	uint8_t every = MAX(sched->every, 1U);
+	time_t seconds;
+
+	if (id > 1U || sched->period > DS3231_SCHEDULE_MONTHLY ||
+	    every > ds3231_schedule_every_max[sched->period]) {
+		return -EINVAL;
+	}
+
+	if (sched->second > 59U || sched->minute > 59U || sched->hour > 23U || sched->wday > 6U ||
+	    (sched->period == DS3231_SCHEDULE_MONTHLY && (sched->mday < 1U || sched->mday > 31U))) {
+		return -EINVAL;
+	}
+
+	/* Alarm 2 has no seconds register and matches at the start of a minute */
+	if (id == 1U && (sched->period == DS3231_SCHEDULE_EVERY_SECOND || sched->second != 0U)) {
+		return -EINVAL;
+	}
+
+	memset(&plan->time, 0, sizeof(plan->time));
+
+	if (every == 1U) {
+		plan->mask = ds3231_schedule_mask[sched->period];
+		plan->time.tm_sec = sched->second;
+		plan->time.tm_min = sched->minute;
+		plan->time.tm_hour = sched->hour;
+		plan->time.tm_wday = sched->wday;
+		plan->time.tm_mday = sched->mday;
+		plan->first = 0;
+		plan->rearm_s = 0U;
+	} else {
+		plan->mask = ds3231_schedule_rearm_mask[sched->period];
+		plan->first = ds3231_schedule_first(sched, now);
+		seconds = plan->first;
+		gmtime_r(&seconds, (struct tm *)&plan->time);
+		plan->rearm_s = every * ds3231_schedule_period_s[sched->period];
+	}
+
+	if (id == 1U) {
+		plan->mask &= ~RTC_ALARM_TIME_MASK_SECOND;
+	}
+
+	return 0;
+}
+
+int ds3231_alarm_schedule(const struct device *dev, uint16_t id,
+			  const struct ds3231_schedule *sched)
+{
+	struct ds3231_data *data = dev->data;
+	struct ds3231_schedule_plan plan;
+	int64_t now = 0;
+	int err;
+
+	if (sched->every > 1U) {
+		/* The next occurrence is programmed when the interrupt is handled */
+#if DS3231_INT1_GPIOS_IN_USE
+		const struct ds3231_config *config = dev->config;
+
+		if (config->int1.port == NULL) {
+			return -ENOTSUP;
+		}
+#else
+		return -ENOTSUP;
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+
+		/* Not the cached time, which may lag the chip */
+		err = ds3231_read_epoch(dev, &now);
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	err = ds3231_schedule_compile(id, sched, now, &plan);
+	if (err != 0) {
+		return err;
+	}
+
+	data->alarm_rearm_mask[id] = plan.mask;
+	data->alarm_next[id] = plan.first;
+	data->alarm_rearm_s[id] = plan.rearm_s;
+
+	err = ds3231_alarm_write(dev, id, plan.mask, &plan.time);
+	if (err != 0) {
+		data->alarm_rearm_s[id] = 0U;
+	}
+
+	return err;
+}
+#else
+int ds3231_alarms_program(const struct device *dev, const struct ds3231_alarm_cfg *alarm1,
+			  const struct ds3231_alarm_cfg *alarm2)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(alarm1);
+	ARG_UNUSED(alarm2);
+
+	return -ENOTSUP;
+}
+
+int ds3231_alarms_program_async(const struct device *dev, struct ds3231_async_req *req,
+				const struct ds3231_alarm_cfg *alarm1,
+				const struct ds3231_alarm_cfg *alarm2, ds3231_async_cb_t cb,
+				void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(req);
+	ARG_UNUSED(alarm1);
+	ARG_UNUSED(alarm2);
+	ARG_UNUSED(cb);
+	ARG_UNUSED(user_data);
+
+	return -ENOTSUP;
+}
+
+int ds3231_schedule_compile(uint16_t id, const struct ds3231_schedule *sched, int64_t now,
+			    struct ds3231_schedule_plan *plan)
+{
+	ARG_UNUSED(id);
+	ARG_UNUSED(sched);
+	ARG_UNUSED(now);
+	ARG_UNUSED(plan);
+
+	return -ENOTSUP;
+}
+
+int ds3231_alarm_schedule(const struct device *dev, uint16_t id,
+			  const struct ds3231_schedule *sched)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(id);
+	ARG_UNUSED(sched);
+
+	return -ENOTSUP;
+}
+#endif /* CONFIG_RTC_ALARM */
+
+#if DS3231_INT1_GPIOS_IN_USE
+#ifdef CONFIG_RTC_DS3231_INT_DRIVER_WQ
+static K_KERNEL_STACK_DEFINE(ds3231_work_q_stack, CONFIG_RTC_DS3231_THREAD_STACK_SIZE);
+static struct k_work_q ds3231_work_q;
+#endif /* CONFIG_RTC_DS3231_INT_DRIVER_WQ */
+
+/* Run ds3231_int1_process() in the configured context */
+static void ds3231_int1_schedule(struct ds3231_data *data)
+{
+#if defined(CONFIG_RTC_DS3231_INT_OWN_THREAD)
+	k_sem_give(&data->int1_sem);
+#elif defined(CONFIG_RTC_DS3231_INT_DRIVER_WQ)
+	k_work_submit_to_queue(&ds3231_work_q, &data->int1_work);
+#else
+	k_work_submit(&data->int1_work);
+#endif
+}
+
+static void ds3231_int1_trigger(struct ds3231_data *data)
+{
+	atomic_inc(&data->int1_edges);
+	ds3231_int1_schedule(data);
+}
+
+static void ds3231_int1_callback_handler(const struct device *port, struct gpio_callback *cb,
+					 gpio_port_pins_t pins)
+{
+	struct ds3231_data *data = CONTAINER_OF(cb, struct ds3231_data, int1_callback);
+	ARG_UNUSED(port);
+	ARG_UNUSED(pins);
+
+#ifdef CONFIG_RTC_DS3231_STATS
+	data->int1_cycles = k_cycle_get_32();
+	DS3231_STATS_INC(data, interrupts);
+#endif /* CONFIG_RTC_DS3231_STATS */
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+	/* First, the cycle count is taken with the least latency */
+	if (data->sqw_enabled) {
+		ds3231_ts_edge(data);
+	}
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+#if defined(DS3231_UPDATE_IN_USE) && defined(DS3231_TIME_CACHE_IN_USE)
+	if (data->sqw_enabled) {
+		ds3231_time_cache_edge(data);
+	}
+#endif /* defined(DS3231_UPDATE_IN_USE) && defined(DS3231_TIME_CACHE_IN_USE) */
+
+#ifdef DS3231_SQW_EDGES_IN_USE
+	if (data->sqw_enabled) {
+		k_spinlock_key_t key = k_spin_lock(&data->sqw_lock);
+
+		data->sqw_edges++;
+		data->sqw_edge_ticks = k_uptime_ticks();
+		k_spin_unlock(&data->sqw_lock, key);
+	}
+#endif /* DS3231_SQW_EDGES_IN_USE */
+
+	ds3231_int1_trigger(data);
+}
+
+static int ds3231_int1_enable(const struct device *dev)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	bool sqw = false;
+	bool enable;
+	int err;
+
+#ifdef DS3231_UPDATE_IN_USE
+	sqw = data->update_callback != NULL;
+#endif /* DS3231_UPDATE_IN_USE */
+
+	/* Armed alarms need the interrupt even without a callback, to latch their flags */
+	enable = sqw || (data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] &
+			 (DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE)) != 0U;
+
+	err = gpio_pin_interrupt_configure_dt(&config->int1,
+					      enable ? GPIO_INT_EDGE_TO_ACTIVE : GPIO_INT_DISABLE);
+	if (err != 0) {
+		LOG_ERR("failed to configure INT1 interrupt (err %d)", err);
+		return err;
+	}
+
+	/* An alarm may have asserted INT before the edge interrupt was enabled */
+	if (enable && !sqw && gpio_pin_get_dt(&config->int1) > 0) {
+		ds3231_int1_trigger(data);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_RTC_ALARM
+static int ds3231_alarm_rearm_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+
+	memcpy(&data->alarm_regs[DS3231_ALARM_IDX(req->reg)], req->buf, req->len);
+
+	return 0;
+}
+
+/*
+ * Program the next occurrence of a schedule the alarm mask does not repeat. Only the alarm
+ * registers that change are written, e.g. the minutes of a schedule every 15 minutes. An
+ * interrupt handled late, or occurrences missed meanwhile, skip to the first occurrence
+ * still ahead, which the alarm would otherwise only match after the next coarser rollover.
+ */
+static void ds3231_alarm_rearm(const struct device *dev, uint16_t id)
+{
+	struct ds3231_data *data = dev->data;
+	uint8_t addr = (id == 0U) ? DS3231_ALARM_1_SECONDS : DS3231_ALARM_2_MINUTES;
+	const uint8_t *regs = &data->alarm_regs[DS3231_ALARM_IDX(addr)];
+	const uint32_t rearm_s = data->alarm_rearm_s[id];
+	size_t end = (id == 0U) ? 4 : 3;
+	struct ds3231_async_req req;
+	struct rtc_time next;
+	size_t start = 0;
+	time_t seconds;
+	int64_t now;
+	int err;
+
+	data->alarm_next[id] += rearm_s;
+
+	/* Not the cached time, which may lag the chip */
+	err = ds3231_read_epoch(dev, &now);
+	if (err == 0 && data->alarm_next[id] <= now) {
+		LOG_WRN("alarm %u missed %lld occurrences", id,
+			(now - data->alarm_next[id]) / rearm_s + 1);
+		data->alarm_next[id] += ((now - data->alarm_next[id]) / rearm_s + 1) * rearm_s;
+	} else if (err != 0) {
+		LOG_WRN("alarm %u re-armed without the time (err %d)", id, err);
+	}
+
+	seconds = data->alarm_next[id];
+	gmtime_r(&seconds, (struct tm *)&next);
+
+	ds3231_req_init(&req, NULL, ds3231_alarm_rearm_complete);
+	ds3231_stats_req_op(&req, DS3231_STATS_ALARM_SET);
+	(void)ds3231_codec_alarm_encode(id, data->alarm_rearm_mask[id], &next, req.buf);
+
+	if (data->alarm_regs_valid) {
+		while (start < end && req.buf[start] == regs[start]) {
+			start++;
+		}
+
+		while (end > start && req.buf[end - 1] == regs[end - 1]) {
+			end--;
+		}
+	}
+
+	if (start == end) {
+		return;
+	}
+
+	req.reg = addr + start;
+	req.len = end - start;
+	memmove(req.buf, &req.buf[start], req.len);
+	ds3231_req_write(&req, req.reg, req.buf, req.len);
+
+	err = ds3231_req_wait(dev, &req);
+	if (err != 0) {
+		LOG_ERR("failed to re-arm alarm %u (err %d)", id, err);
+	}
+}
+
+/*
+ * Read STATUS once, clear the flags of the enabled alarms with a single write, and dispatch
+ * their callbacks. Alarms without a callback are latched for alarm_is_pending instead.
+ */
+static void ds3231_alarm_service(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+	uint8_t enabled = data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] &
+			  (DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE);
+	uint8_t flags;
+	int err;
+
+	/* In square-wave mode INT/SQW edges are ticks, unless an alarm is armed */
+	if (enabled == 0U) {
+		return;
+	}
+
+	/* AxF and AxIE share their bit positions */
+	flags = enabled;
+	err = ds3231_status_take(dev, &flags);
+	if (err != 0 || flags == 0U) {
+		return;
+	}
+
+#ifdef DS3231_VALARM_IN_USE
+	/* Both alarms belong to the virtual alarms */
+	atomic_or(&data->valarm_kick, DS3231_VALARM_KICK_ALARM);
+	return;
+#endif /* DS3231_VALARM_IN_USE */
+
+	for (uint16_t id = 0U; id < 2U; id++) {
+		rtc_alarm_callback callback = data->alarm_callback[id];
+
+		if ((flags & BIT(id)) == 0U) {
+			continue;
+		}
+
+		/* Before the callback, which may replace the schedule */
+		if (data->alarm_rearm_s[id] != 0U) {
+			ds3231_alarm_rearm(dev, id);
+		}
+
+		if (callback != NULL) {
+			ds3231_stats_alarm(data);
+			callback(dev, id, data->alarm_user_data[id]);
+		} else {
+			atomic_set_bit(&data->alarm_pending, id);
+		}
+	}
+}
+#endif /* CONFIG_RTC_ALARM */
+
+#ifdef DS3231_VALARM_IN_USE
+static bool ds3231_valarm_lessthan(struct rbnode *a, struct rbnode *b)
+{
+	struct ds3231_valarm *alarm_a = CONTAINER_OF(a, struct ds3231_valarm, node);
+	struct ds3231_valarm *alarm_b = CONTAINER_OF(b, struct ds3231_valarm, node);
+
+	/* Alarms due at the same time are ordered by address, the tree needs a total order */
+	if (alarm_a->time != alarm_b->time) {
+		return alarm_a->time < alarm_b->time;
+	}
+
+	return (uintptr_t)alarm_a < (uintptr_t)alarm_b;
+}
+
+/*
+ * Program the earliest virtual alarm into alarm 1, matching seconds to date, and let alarm 2
+ * fire every minute as a fallback for a missed match. Alarm 1 may match a month early, which
+ * dispatching ignores. Nothing is written while the earliest alarm stays the same. Called
+ * with valarm_lock held.
+ */
+static int ds3231_valarm_arm(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+	struct rbnode *node = rb_get_min(&data->valarm_tree);
+	struct ds3231_alarm_cfg alarm1 = {0};
+	struct ds3231_alarm_cfg alarm2 = {0};
+	struct ds3231_async_req req;
+	int64_t target = DS3231_VALARM_DISARMED;
+	time_t seconds;
+	int err;
+
+	if (node != NULL) {
+		target = CONTAINER_OF(node, struct ds3231_valarm, node)->time;
+	}
+
+	if (target == data->valarm_armed) {
+		return 0;
+	}
+
+	if (node != NULL) {
+		seconds = target;
+		gmtime_r(&seconds, (struct tm *)&alarm1.time);
+		alarm1.mask = DS3231_RTC_ALARM_1_TIME_MASK & ~RTC_ALARM_TIME_MASK_WEEKDAY;
+		alarm1.enable = true;
+		/* No fields to match, alarm 2 fires at every full minute */
+		alarm2.enable = true;
+	}
+
+	err = ds3231_req_alarms_program(dev, &req, &alarm1, &alarm2);
+	if (err == 0) {
+		err = ds3231_req_wait(dev, &req);
+	}
+
+	if (err != 0) {
+		LOG_ERR("failed to arm virtual alarm (err %d)", err);
+		data->valarm_armed = DS3231_VALARM_DISARMED;
+		return err;
+	}
+
+	data->valarm_armed = target;
+
+	return 0;
+}
+
+/* Fire all virtual alarms that are due and arm the next one */
+/* alarm_edge tells that an alarm interrupt, rather than a new earliest alarm, asked for this */
+static void ds3231_valarm_dispatch(const struct device *dev, bool alarm_edge)
+{
+	struct ds3231_data *data = dev->data;
+	struct ds3231_valarm *alarm;
+	struct rbnode *node;
+	int64_t now;
+
+	/* Not the cached time, which may lag the chip and miss the alarm that just matched */
+	if (ds3231_read_epoch(dev, &now) != 0) {
+		return;
+	}
+
+	k_mutex_lock(&data->valarm_lock, K_FOREVER);
+
+	while ((node = rb_get_min(&data->valarm_tree)) != NULL) {
+		alarm = CONTAINER_OF(node, struct ds3231_valarm, node);
+		if (alarm->time > now) {
+			break;
+		}
+
+		rb_remove(&data->valarm_tree, node);
+		alarm->queued = false;
+
+		/* The callback may start or cancel virtual alarms, including this one */
+		k_mutex_unlock(&data->valarm_lock);
+		if (alarm_edge) {
+			ds3231_stats_alarm(data);
+		}
+		alarm->cb(dev, alarm, alarm->user_data);
+		k_mutex_lock(&data->valarm_lock, K_FOREVER);
+	}
+
+	(void)ds3231_valarm_arm(dev);
+
+	k_mutex_unlock(&data->valarm_lock);
+}
+#endif /* DS3231_VALARM_IN_USE */
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+/* Map the edge count to RTC seconds with one time read, once per square wave start */
+static void ds3231_ts_anchor(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->ts_lock);
+	uint32_t edges = data->ts_edges;
+	bool anchored = data->ts_anchored;
+	int64_t seconds;
+
+	k_spin_unlock(&data->ts_lock, key);
+
+	if (anchored || edges == 0U || !data->sqw_enabled) {
+		return;
+	}
+
+	if (ds3231_read_epoch(dev, &seconds) != 0) {
+		return;
+	}
+
+	/*
+	 * The read belongs to the second started by the counted edge if no edge came in
+	 * between, and the next one is not due yet with its interrupt still pending.
+	 */
+	key = k_spin_lock(&data->ts_lock);
+	if (!data->ts_anchored && data->ts_edges == edges &&
+	    ds3231_ts_cycles(data) - data->ts_edge_cycles <
+		    sys_clock_hw_cycles_per_sec() / 10U * 9U) {
+		data->ts_anchor_seconds = seconds;
+		data->ts_anchor_edge = edges;
+		data->ts_anchored = true;
+	}
+	k_spin_unlock(&data->ts_lock, key);
+}
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+static void ds3231_int1_process(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+	atomic_val_t edges = atomic_clear(&data->int1_edges);
+#ifdef DS3231_VALARM_IN_USE
+	atomic_val_t kick;
+#endif /* DS3231_VALARM_IN_USE */
+
+#ifdef DS3231_UPDATE_IN_USE
+	rtc_update_callback update_callback = data->update_callback;
+
+	/* Every edge is a second tick in square-wave mode, no register read needed */
+	for (; update_callback != NULL && edges > 0; edges--) {
+		update_callback(dev, data->update_user_data);
+	}
+
+#ifdef DS3231_TIMESTAMP_IN_USE
+	ds3231_ts_anchor(dev);
+#endif /* DS3231_TIMESTAMP_IN_USE */
+#else
+	ARG_UNUSED(edges);
+#endif /* DS3231_UPDATE_IN_USE */
+
+#ifdef CONFIG_RTC_ALARM
+	/*
+	 * In square-wave mode the alarms cannot drive INT/SQW, so their flags are polled
+	 * on each edge instead.
+	 */
+	ds3231_alarm_service(dev);
+#endif /* CONFIG_RTC_ALARM */
+
+#ifdef DS3231_VALARM_IN_USE
+	kick = atomic_clear(&data->valarm_kick);
+	if (kick != 0) {
+		ds3231_valarm_dispatch(dev, (kick & DS3231_VALARM_KICK_ALARM) != 0);
+	}
+#endif /* DS3231_VALARM_IN_USE */
+}
+
+#ifdef CONFIG_RTC_DS3231_INT_OWN_THREAD
+static void ds3231_int1_thread(const struct device *dev)
+{
+	struct ds3231_data *data = dev->data;
+
+	while (true) {
+		k_sem_take(&data->int1_sem, K_FOREVER);
+		ds3231_int1_process(dev);
+	}
+}
+#else
+static void ds3231_int1_work_handler(struct k_work *work)
+{
+	struct ds3231_data *data = CONTAINER_OF(work, struct ds3231_data, int1_work);
+
+	ds3231_int1_process(data->dev);
+}
+#endif /* CONFIG_RTC_DS3231_INT_OWN_THREAD */
+
+#ifdef DS3231_UPDATE_IN_USE
+static int ds3231_update_set_callback(const struct device *dev, rtc_update_callback callback,
+				      void *user_data)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	uint8_t control;
+	int err;
+
+	if (config->int1.port == NULL || config->int1_mode == DS3231_INT_MODE_ALARM) {
+		return -ENOTSUP;
+	}
+
+	data->sqw_enabled = false;
+	data->update_callback = callback;
+	data->update_user_data = user_data;
+
+	/*
+	 * RS2/RS1 cleared selects 1 Hz, INTCN cleared routes the square wave to INT/SQW. Without
+	 * a callback INT/SQW goes back to the devicetree square wave, or to enabled alarms.
+	 */
+	if (callback != NULL) {
+		control = 0U;
+	} else {
+		control = config->control &
+			  (DS3231_CONTROL_INTCN | DS3231_CONTROL_RS2 | DS3231_CONTROL_RS1);
+		if ((data->shadow[DS3231_SHADOW_IDX(DS3231_CONTROL)] &
+		     (DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE)) != 0U) {
+			control |= DS3231_CONTROL_INTCN;
+		}
+	}
+	err = ds3231_update_control(
+		dev, DS3231_CONTROL_INTCN | DS3231_CONTROL_RS2 | DS3231_CONTROL_RS1, control);
+	if (err != 0) {
+		return err;
+	}
+
+#ifdef DS3231_SQW_EDGES_IN_USE
+	data->sqw_edges = 0U;
+#endif /* DS3231_SQW_EDGES_IN_USE */
+#ifdef DS3231_TIMESTAMP_IN_USE
+	ds3231_ts_reset(data, false);
+#endif /* DS3231_TIMESTAMP_IN_USE */
+	data->sqw_enabled = callback != NULL;
+
+	return ds3231_int1_enable(dev);
+}
+#endif /* DS3231_UPDATE_IN_USE */
+
+#ifdef CONFIG_RTC_ALARM
+static int ds3231_alarm_set_callback(const struct device *dev, uint16_t id,
+				     rtc_alarm_callback callback, void *user_data)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+
+	if (IS_ENABLED(DS3231_VALARM_IN_USE)) {
+		/* Both hardware alarms are reserved for the virtual alarms */
+		return -EBUSY;
+	}
+
+	/* Check if int1 pin is assigned and delivers alarms */
+	if (config->int1.port == NULL || config->int1_mode == DS3231_INT_MODE_UPDATE) {
+		LOG_INF("int1 port is null or has no alarms");
+		return -ENOTSUP;
+	}
+	/* Check if valid ID */
+	if (id != 0 && id != 1) {
+		LOG_ERR("Invalid ID %d - should be 0 or 1", id);
+		return -EINVAL;
+	}
+
+	data->alarm_callback[id] = callback;
+	data->alarm_user_data[id] = user_data;
+
+	return 0;
+}
+#endif /* CONFIG_RTC_ALARM */
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+
+#ifdef CONFIG_RTC_ALARM
+static int ds3231_alarm_is_pending(const struct device *dev, uint16_t id)
+{
+	uint8_t flags;
+	int err;
+
+	if (id > 1U) {
+		LOG_ERR("invalid ID %d", id);
+		return -EINVAL;
+	}
+
+#if DS3231_INT1_GPIOS_IN_USE
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+
+	/* With INT1 the interrupt handling latches the flags, no bus access needed */
+	if (config->int1.port != NULL) {
+		return atomic_test_and_clear_bit(&data->alarm_pending, id) ? 1 : 0;
+	}
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+
+	/* AxF is bit id of STATUS */
+	flags = BIT(id);
+	err = ds3231_status_take(dev, &flags);
+	if (err != 0) {
+		return err;
+	}
+
+	return (flags != 0U) ? 1 : 0;
+}
+#endif /* CONFIG_RTC_ALARM */
+
+#ifdef DS3231_VALARM_IN_USE
+int ds3231_valarm_start(const struct device *dev, struct ds3231_valarm *alarm, int64_t time,
+			ds3231_valarm_cb_t cb, void *user_data)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	bool head;
+	int err;
+
+	if (config->int1.port == NULL) {
+		return -ENOTSUP;
+	}
+
+	if (cb == NULL || time < DS3231_EPOCH_MIN || time > DS3231_EPOCH_MAX) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&data->valarm_lock, K_FOREVER);
+
+	if (alarm->queued) {
+		rb_remove(&data->valarm_tree, &alarm->node);
+	}
+
+	alarm->time = time;
+	alarm->cb = cb;
+	alarm->user_data = user_data;
+	alarm->queued = true;
+	rb_insert(&data->valarm_tree, &alarm->node);
+
+	head = rb_get_min(&data->valarm_tree) == &alarm->node;
+	err = ds3231_valarm_arm(dev);
+
+	k_mutex_unlock(&data->valarm_lock);
+
+	/* A new earliest alarm may already be due, in which case alarm 1 no longer matches */
+	if (head) {
+		atomic_or(&data->valarm_kick, DS3231_VALARM_KICK);
+		ds3231_int1_schedule(data);
+	}
+
+	return err;
+}
+
+int ds3231_valarm_cancel(const struct device *dev, struct ds3231_valarm *alarm)
+{
+	struct ds3231_data *data = dev->data;
+	int err = 0;
+
+	k_mutex_lock(&data->valarm_lock, K_FOREVER);
+
+	if (alarm->queued) {
+		rb_remove(&data->valarm_tree, &alarm->node);
+		alarm->queued = false;
+		err = ds3231_valarm_arm(dev);
+	}
+
+	k_mutex_unlock(&data->valarm_lock);
+
+	return err;
+}
+#else
+int ds3231_valarm_start(const struct device *dev, struct ds3231_valarm *alarm, int64_t time,
+			ds3231_valarm_cb_t cb, void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(alarm);
+	ARG_UNUSED(time);
+	ARG_UNUSED(cb);
+	ARG_UNUSED(user_data);
+
+	return -ENOTSUP;
+}
+
+int ds3231_valarm_cancel(const struct device *dev, struct ds3231_valarm *alarm)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(alarm);
+
+	return -ENOTSUP;
+}
+#endif /* DS3231_VALARM_IN_USE */
+
+int ds3231_sqw_edge_get(const struct device *dev, uint32_t *count, int64_t *timestamp_ns)
+{
+#ifdef DS3231_SQW_EDGES_IN_USE
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->sqw_lock);
+	int err = -EAGAIN;
+
+	if (data->sqw_enabled && data->sqw_edges > 0U) {
+		*count = data->sqw_edges;
+		*timestamp_ns = k_ticks_to_ns_floor64(data->sqw_edge_ticks);
+		err = 0;
+	}
+	k_spin_unlock(&data->sqw_lock, key);
+
+	return err;
+#else
+	ARG_UNUSED(dev);
+	ARG_UNUSED(count);
+	ARG_UNUSED(timestamp_ns);
+
+	return -ENOTSUP;
+#endif /* DS3231_SQW_EDGES_IN_USE */
+}
+
+int ds3231_timestamp_get(const struct device *dev, struct ds3231_timestamp *ts)
+{
+#ifdef DS3231_TIMESTAMP_IN_USE
+	struct ds3231_data *data = dev->data;
+	k_spinlock_key_t key = k_spin_lock(&data->ts_lock);
+	uint64_t period;
+	uint64_t since;
+	int64_t ns;
+
+	if (!data->ts_anchored || data->ts_periods == 0U) {
+		k_spin_unlock(&data->ts_lock, key);
+		return -EAGAIN;
+	}
+
+	period = (data->ts_period + BIT64(DS3231_TS_FRAC_BITS - 1)) >> DS3231_TS_FRAC_BITS;
+	since = ds3231_ts_cycles(data) - data->ts_edge_cycles;
+	if (since >= 2U * period) {
+		/* Edges stopped, interpolating further would only accumulate error */
+		k_spin_unlock(&data->ts_lock, key);
+		return -EAGAIN;
+	}
+
+	/* A late edge holds the time at the end of the current second */
+	ns = (data->ts_anchor_seconds + (data->ts_edges - data->ts_anchor_edge)) * NSEC_PER_SEC +
+	     (int64_t)MIN(since * NSEC_PER_SEC / period, NSEC_PER_SEC - 1U);
+	ns = MAX(ns, data->ts_last_ns);
+	data->ts_last_ns = ns;
+
+	ts->ns = ns;
+	ts->cycles_per_sec = period;
+	/* Jitter of the edge interrupts plus the counter resolution */
+	ts->error_ns = (data->ts_period_dev >> DS3231_TS_FRAC_BITS) * NSEC_PER_SEC / period +
+		       DIV_ROUND_UP(NSEC_PER_SEC, period);
+	k_spin_unlock(&data->ts_lock, key);
+
+	return 0;
+#else
+	ARG_UNUSED(dev);
+	ARG_UNUSED(ts);
+
+	return -ENOTSUP;
+#endif /* DS3231_TIMESTAMP_IN_USE */
+}
+
+static const struct rtc_driver_api ds3231_driver_api = {
+	.set_time = ds3231_set_time,
+	.get_time = ds3231_get_time,
+#ifdef CONFIG_RTC_ALARM
+	.alarm_get_supported_fields = ds3231_alarm_get_supported_fields,
+	.alarm_set_time = ds3231_alarm_set_time,
+	.alarm_get_time = ds3231_alarm_get_time,
+	.alarm_is_pending = ds3231_alarm_is_pending,
+#if DS3231_INT1_GPIOS_IN_USE
+	.alarm_set_callback = ds3231_alarm_set_callback,
+#endif /* DS3231_INT1_GPIOS_IN_USE */
+#endif /* CONFIG_RTC_ALARM */
+
+#ifdef DS3231_UPDATE_IN_USE
+	.update_set_callback = ds3231_update_set_callback,
+#endif /* DS3231_UPDATE_IN_USE */
+};
+
+static int ds3231_dt_regs_complete(const struct device *dev, struct ds3231_async_req *req)
+{
+	struct ds3231_data *data = dev->data;
+	size_t start = DS3231_SHADOW_IDX(req->reg);
+
+	memcpy(&data->shadow[start], &req->buf[start], req->len);
+	ds3231_snapshot_status(data);
+
+	return 0;
+}
+
+/*
+ * CONTROL, STATUS and AGING_OFFSET as set in devicetree. They are consecutive, so the bytes
+ * that change are written in one transaction, and nothing is written when none does.
+ */
+static void ds3231_dt_regs_prepare(const struct device *dev, struct ds3231_async_req *req)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	const uint8_t *regs = data->shadow;
+	uint8_t *wire = &req->buf[DS3231_SHADOW_SIZE];
+	size_t start = 0;
+	size_t end = DS3231_SHADOW_SIZE;
+
+	if (ds3231_req_reload(dev, req)) {
+		return;
+	}
+
+	req->buf[0] = (regs[0] & ~config->control_mask) | config->control;
+	/* Alarms enabled before the reset keep INT/SQW for their interrupts */
+	if ((regs[0] & (DS3231_CONTROL_A1IE | DS3231_CONTROL_A2IE)) != 0U) {
+		req->buf[0] |= DS3231_CONTROL_INTCN;
+	}
+	req->buf[1] = (regs[1] & ~config->status_mask) | config->status;
+	/* The aging offset is lost with power, as is the time */
+	req->buf[2] = (config->aging_offset_set && ds3231_osf(data)) ? (uint8_t)config->aging_offset
+								     : regs[2];
+
+	while (start < end && req->buf[start] == regs[start]) {
+		start++;
+	}
+
+	while (end > start && req->buf[end - 1] == regs[end - 1]) {
+		end--;
+	}
+
+	req->reg = DS3231_CONTROL + start;
+	req->len = end - start;
+	if (req->len == 0U) {
+		req->num_msgs = 0;
+		return;
+	}
+
+	/* STATUS flags written as 1 are left as they are, a flag set since the read stays set */
+	memcpy(wire, req->buf, DS3231_SHADOW_SIZE);
+	wire[DS3231_SHADOW_IDX(DS3231_STATUS)] |= DS3231_STATUS_FLAGS;
+
+	ds3231_req_write(req, req->reg, &wire[start], req->len);
+}
+
+static int ds3231_dt_regs_apply(const struct device *dev)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_async_req req;
+
+	if (config->control_mask == 0U && config->status_mask == 0U && !config->aging_offset_set) {
+		return 0;
+	}
+
+	ds3231_req_init(&req, ds3231_dt_regs_prepare, ds3231_dt_regs_complete);
+
+	return ds3231_req_wait(dev, &req);
+}
+
+static int ds3231_init(const struct device *dev)
+{
+	const struct ds3231_config *config = dev->config;
+	struct ds3231_data *data = dev->data;
+	struct ds3231_reg_dump dump;
+	LOG_INF("Initializing the ds3231 driver");
+
+	data->dev = dev;
+	k_mutex_init(&data->lock);
+#ifdef CONFIG_RTC_DS3231_ASYNC
+	static bool bus_q_started;
+
+	if (!bus_q_started) {
+		const struct k_work_queue_config cfg = {.name = "ds3231_bus"};
+
+		k_work_queue_init(&ds3231_bus_q);
+		k_work_queue_start(&ds3231_bus_q, ds3231_bus_q_stack,
+				   K_KERNEL_STACK_SIZEOF(ds3231_bus_q_stack),
+				   CONFIG_RTC_DS3231_BUS_WQ_PRIO, &cfg);
+		bus_q_started = true;
+	}
+
+	sys_slist_init(&data->queue);
+	k_work_init_delayable(&data->xfer_work, ds3231_xfer_work_handler);
+#endif /* CONFIG_RTC_DS3231_ASYNC */
+#ifdef CONFIG_RTC_DS3231_STATS
+	stats_init(&data->stats.s_hdr, STATS_SIZE_32,
+		   (sizeof(data->stats) - sizeof(data->stats.s_hdr)) / sizeof(uint32_t),
+		   STATS_NAME_INIT_PARMS(ds3231));
+	stats_register(dev->name, &data->stats.s_hdr);
+#endif /* CONFIG_RTC_DS3231_STATS */
+
+	if (!i2c_is_ready_dt(&config->i2c)) {
+		LOG_ERR("I2C bus not ready");
+		return -ENODEV;
+	}
+
+	/* One burst fills all register caches, so the first calls need no reads */
+	if (ds3231_reg_dump(dev, &dump) != 0) {
+		LOG_WRN("failed to read registers, retrying on first use");
+	} else if (!dump.time_valid) {
+		LOG_WRN("oscillator stopped, time not valid until set");
+	}
+
+	/* Devicetree settings only cost a write when the chip does not have them already */
+	if (ds3231_dt_regs_apply(dev) != 0) {
+		LOG_WRN("failed to apply devicetree register settings");
+	}
+#if DS3231_INT1_GPIOS_IN_USE
+	int err;
+
+	LOG_INF("Setting up interrupt handling and gpio");
+
+	if (config->int1.port != NULL) {
+#if defined(CONFIG_RTC_DS3231_INT_OWN_THREAD)
+		k_tid_t tid;
+
+		k_sem_init(&data->int1_sem, 0, 1);
+		tid = k_thread_create(&data->int1_thread, config->int1_stack,
+				      CONFIG_RTC_DS3231_THREAD_STACK_SIZE,
 				      (k_thread_entry_t)ds3231_int1_thread, (void *)dev, NULL, NULL,
 				      CONFIG_RTC_DS3231_THREAD_PRIO, 0, K_NO_WAIT);
-		k_thread_name_set(tid, "pcf8523");
+		k_thread_name_set(tid, "ds3231");
+#else
+#if defined(CONFIG_RTC_DS3231_INT_DRIVER_WQ)
+		static bool work_q_started;
+
+		if (!work_q_started) {
+			const struct k_work_queue_config cfg = {.name = "ds3231_wq"};
+
+			k_work_queue_init(&ds3231_work_q);
+			k_work_queue_start(&ds3231_work_q, ds3231_work_q_stack,
+					   K_KERNEL_STACK_SIZEOF(ds3231_work_q_stack),
+					   CONFIG_RTC_DS3231_THREAD_PRIO, &cfg);
+			work_q_started = true;
+		}
+#endif /* defined(CONFIG_RTC_DS3231_INT_DRIVER_WQ) */
+		k_work_init(&data->int1_work, ds3231_int1_work_handler);
+#endif /* defined(CONFIG_RTC_DS3231_INT_OWN_THREAD) */
+
+#ifdef DS3231_VALARM_IN_USE
+		k_mutex_init(&data->valarm_lock);
+		data->valarm_tree.lessthan_fn = ds3231_valarm_lessthan;
+		data->valarm_armed = DS3231_VALARM_DISARMED;
+#endif /* DS3231_VALARM_IN_USE */
+#ifdef DS3231_TIMESTAMP_IN_USE
+		data->ts_last_ns = INT64_MIN;
+#endif /* DS3231_TIMESTAMP_IN_USE */
+
+		if (!gpio_is_ready_dt(&config->int1)) {
+			LOG_ERR("GPIO not ready");
+			return -ENODEV;
+		}
+		LOG_INF("gpio is ready");
+		err = gpio_pin_configure_dt(&config->int1, GPIO_INPUT);
+		if (err != 0) {
+			LOG_ERR("failed to configure GPIO (err %d)", err);
+			return -ENODEV;
+		}
+		LOG_INF("gpio configured as input");
+		gpio_init_callback(&data->int1_callback, ds3231_int1_callback_handler,
+				   BIT(config->int1.pin));
+
+		err = gpio_add_callback_dt(&config->int1, &data->int1_callback);
+		if (err != 0) {
+			LOG_ERR("failed to add GPIO callback (err %d)", err);
+			return -ENODEV;
+		}
+		LOG_INF("gpio callback added");
 
 		/*
-		 * Defer GPIO interrupt configuration due to INT1/CLKOUT pin sharing. This allows
-		 * using the CLKOUT square-wave signal for RTC calibration when no alarm/update
-		 * callbacks are enabled (and not configured as a wakeup-source).
+		 * Only enable the GPIO interrupt for alarms the battery-backed chip kept armed
+		 * across an MCU reset, whose flags must still be latched. Otherwise INT1/CLKOUT
+		 * stays free for the square wave until an alarm or update callback is set.
 		 */
+		err = ds3231_int1_enable(dev);
+		if (err != 0) {
+			return err;
+		}
 	}
 #endif /* DS3231_INT1_GPIOS_IN_USE */
 	return 0;
 }
 
+/* A mux channel's parent is the mux, which is on the bus its channels are switched onto */
+#define DS3231_ROOT_BUS(inst)                                                                      \
+	DEVICE_DT_GET(COND_CODE_1(DT_ON_BUS(DT_PARENT(DT_INST_BUS(inst)), i2c),                    \
+				  (DT_BUS(DT_PARENT(DT_INST_BUS(inst)))), (DT_INST_BUS(inst))))
+
+/*
+ * BBSQW, and RS2/RS1 with INTCN cleared for a square wave, as set in devicetree. Only bits
+ * within DS3231_DT_CONTROL_MASK() are set, the others are left as the chip has them.
+ */
+#define DS3231_DT_CONTROL(inst)                                                                    \
+	((DT_INST_PROP(inst, battery_backed_sqw) ? DS3231_CONTROL_BBSQW : 0U) |                    \
+	 (DT_INST_ENUM_IDX_OR(inst, sqw_frequency, 0) * DS3231_CONTROL_RS1))
+
+#define DS3231_DT_CONTROL_MASK(inst)                                                               \
+	((DT_INST_PROP(inst, battery_backed_sqw) ? DS3231_CONTROL_BBSQW : 0U) |                    \
+	 (DT_INST_NODE_HAS_PROP(inst, sqw_frequency)                                               \
+		  ? (DS3231_CONTROL_INTCN | DS3231_CONTROL_RS2 | DS3231_CONTROL_RS1)               \
+		  : 0U))
+
+/* en32khz-output "enabled" is enum index 0 */
+#define DS3231_DT_STATUS(inst)                                                                     \
+	(DT_INST_ENUM_IDX_OR(inst, en32khz_output, 1) == 0 ? DS3231_STATUS_EN32KHZ : 0U)
+
+#define DS3231_DT_STATUS_MASK(inst)                                                                \
+	(DT_INST_NODE_HAS_PROP(inst, en32khz_output) ? DS3231_STATUS_EN32KHZ : 0U)
+
+#if DS3231_INT1_GPIOS_IN_USE && defined(CONFIG_RTC_DS3231_INT_OWN_THREAD)
+#define DS3231_INT1_STACK_DEFINE(inst)                                                             \
+	IF_ENABLED(DT_INST_NODE_HAS_PROP(inst, int1_gpios),                                        \
+		   (static K_KERNEL_STACK_DEFINE(ds3231_int1_stack_##inst,                         \
+						 CONFIG_RTC_DS3231_THREAD_STACK_SIZE);))
+
+#define DS3231_INT1_STACK(inst)                                                                    \
+	.int1_stack = COND_CODE_1(DT_INST_NODE_HAS_PROP(inst, int1_gpios),                         \
+				  (ds3231_int1_stack_##inst), (NULL)),
+#else
+#define DS3231_INT1_STACK_DEFINE(inst)
+#define DS3231_INT1_STACK(inst)
+#endif
+
 #define DS3231_INIT(inst)                                                                          \
+	BUILD_ASSERT(IN_RANGE((int32_t)DT_INST_PROP_OR(inst, aging_offset, 0), INT8_MIN,           \
+			      INT8_MAX),                                                           \
+		     "aging-offset must be within -128 and 127");                                  \
+												   \
+	DS3231_INT1_STACK_DEFINE(inst)                                                             \
+												   \
 	static const struct ds3231_config ds3231_config_##inst = {                                 \
 		.i2c = I2C_DT_SPEC_INST_GET(inst),                                                 \
+		 IF_ENABLED(CONFIG_RTC_DS3231_GROUP, (.root_bus = DS3231_ROOT_BUS(inst),))         \
+		.control = DS3231_DT_CONTROL(inst),                                                \
+		.control_mask = DS3231_DT_CONTROL_MASK(inst),                                      \
+		.status = DS3231_DT_STATUS(inst),                                                  \
+		.status_mask = DS3231_DT_STATUS_MASK(inst),                                        \
+		.aging_offset_set = DT_INST_NODE_HAS_PROP(inst, aging_offset),                     \
+		.aging_offset = (int8_t)DT_INST_PROP_OR(inst, aging_offset, 0),                    \
+		 IF_ENABLED(DS3231_TIME_CACHE_IN_USE,                                              \
+			    (.cache_resync_ms = DT_INST_PROP_OR(inst, time_cache_resync_ms,        \
+						CONFIG_RTC_DS3231_TIME_CACHE_RESYNC_MS),)) \
 		 IF_ENABLED(DS3231_INT1_GPIOS_IN_USE,                                              \
-			    (.int1 = GPIO_DT_SPEC_INST_GET_OR(inst, int1_gpios, {0})))};           \
+			    (.int1 = GPIO_DT_SPEC_INST_GET_OR(inst, int1_gpios, {0}),              \
+			     .int1_mode = DT_INST_ENUM_IDX(inst, interrupt_mode),                  \
+			     DS3231_INT1_STACK(inst)))};                                           \
 												   \
 	static struct ds3231_data ds3231_data_##inst;                                              \
 	\
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Aging offset calibration. The RTC's elapsed time is compared with a reference over at
+ * least CONFIG_RTC_DS3231_CAL_MIN_INTERVAL_S, and the aging offset is stepped against the
+ * measured frequency error.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_DECLARE(ds3231, CONFIG_RTC_LOG_LEVEL);
+
+/* Typical frequency change per aging offset step at 25 degC */
+#define DS3231_CAL_PPB_PER_STEP 100
+
+/*
+ * A difference between RTC and reference time beyond 1000 ppm plus the read resolution
+ * means the RTC was set or the square wave restarted, rather than drift.
+ */
+#define DS3231_CAL_MAX_PPM  1000
+#define DS3231_CAL_SLACK_NS (2 * NSEC_PER_SEC)
+
+/*
+ * Seconds edges are found by reading the time registers every few milliseconds, then the
+ * following edge by reading them back to back from just before it is due
+ */
+#define DS3231_CAL_POLL_MS         5
+#define DS3231_CAL_FINE_POLL_US    50
+#define DS3231_CAL_FINE_MARGIN_NS  (2 * NSEC_PER_MSEC)
+/* The next edge is due within a second, longer means the chip stopped */
+#define DS3231_CAL_EDGE_TIMEOUT_MS 1500
+
+static int64_t ds3231_cal_uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+/* Read the RTC seconds from the chip, bypassing the time cache which extrapolates from uptime */
+static int ds3231_cal_read(const struct device *dev, int64_t *seconds, int64_t *uptime_ns)
+{
+	int64_t before;
+	int err;
+
+	(void)ds3231_time_cache_invalidate(dev);
+
+	before = ds3231_cal_uptime_ns();
+	err = ds3231_get_epoch(dev, seconds);
+	*uptime_ns = before + (ds3231_cal_uptime_ns() - before) / 2;
+
+	return err;
+}
+
+/*
+ * Poll the time registers until the seconds change, sleeping poll_ms or busy waiting
+ * poll_us between reads, for up to timeout_ns. The edge passed between the last two reads,
+ * rtc_ns is its time and uptime_ns and error_ns the middle and half width of that window.
+ */
+static int ds3231_cal_poll_edge(const struct device *dev, int32_t poll_ms, int32_t poll_us,
+				int64_t timeout_ns, int64_t *rtc_ns, int64_t *uptime_ns,
+				int64_t *error_ns)
+{
+	int64_t start = ds3231_cal_uptime_ns();
+	int64_t prev_uptime;
+	int64_t prev_seconds;
+	int64_t seconds;
+	int64_t uptime;
+	int err;
+
+	err = ds3231_cal_read(dev, &prev_seconds, &prev_uptime);
+	if (err != 0) {
+		return err;
+	}
+
+	for (;;) {
+		if (poll_ms > 0) {
+			k_msleep(poll_ms);
+		} else {
+			k_busy_wait(poll_us);
+		}
+
+		err = ds3231_cal_read(dev, &seconds, &uptime);
+		if (err != 0) {
+			return err;
+		}
+
+		if (seconds == prev_seconds + 1) {
+			break;
+		}
+
+		if (uptime - start > timeout_ns) {
+			return -ETIMEDOUT;
+		}
+
+		/* Still the same second, or the time was set meanwhile */
+		prev_seconds = seconds;
+		prev_uptime = uptime;
+	}
+
+	*rtc_ns = seconds * NSEC_PER_SEC;
+	*uptime_ns = prev_uptime + (uptime - prev_uptime) / 2;
+	*error_ns = (uptime - prev_uptime) / 2;
+
+	return 0;
+}
+
+/*
+ * Read the RTC time at an uptime with sub-second precision, as reading the time registers
+ * once would only resolve the second. From the timestamped square wave if available,
+ * otherwise one edge is found coarsely and the next one by polling closely around it.
+ */
+static int ds3231_cal_read_rtc(const struct device *dev, int64_t *rtc_ns, int64_t *uptime_ns,
+			       int64_t *error_ns)
+{
+	struct ds3231_timestamp ts;
+	int64_t fine_uptime_ns;
+	int64_t fine_error_ns;
+	int64_t fine_rtc_ns;
+	int64_t before;
+	int64_t wake;
+	int err;
+
+	before = ds3231_cal_uptime_ns();
+	if (ds3231_timestamp_get(dev, &ts) == 0) {
+		*rtc_ns = ts.ns;
+		*uptime_ns = before + (ds3231_cal_uptime_ns() - before) / 2;
+		*error_ns = ts.error_ns + (ds3231_cal_uptime_ns() - before) / 2;
+		return 0;
+	}
+
+	err = ds3231_cal_poll_edge(dev, DS3231_CAL_POLL_MS, 0,
+				   DS3231_CAL_EDGE_TIMEOUT_MS * NSEC_PER_MSEC, rtc_ns, uptime_ns,
+				   error_ns);
+	if (err != 0) {
+		return err;
+	}
+
+	/* The next edge follows a second later, within the same window */
+	wake = *uptime_ns - *error_ns + NSEC_PER_SEC - DS3231_CAL_FINE_MARGIN_NS;
+	k_sleep(K_NSEC(MAX(wake - ds3231_cal_uptime_ns(), 0)));
+
+	err = ds3231_cal_poll_edge(dev, 0, DS3231_CAL_FINE_POLL_US,
+				   2 * (*error_ns + DS3231_CAL_FINE_MARGIN_NS), &fine_rtc_ns,
+				   &fine_uptime_ns, &fine_error_ns);
+
+	/* Woken too late for the next edge, keep the coarse one */
+	if (err == -ETIMEDOUT || (err == 0 && fine_rtc_ns != *rtc_ns + NSEC_PER_SEC)) {
+		return 0;
+	}
+
+	if (err != 0) {
+		return err;
+	}
+
+	*rtc_ns = fine_rtc_ns;
+	*uptime_ns = fine_uptime_ns;
+	*error_ns = fine_error_ns;
+
+	return 0;
+}
+
+/* One observation of RTC time against reference time, error_ns is its uncertainty */
+static int ds3231_cal_observe(struct ds3231_cal *cal, int64_t ref_ns, int64_t *rtc_ns,
+			      int64_t *obs_ref_ns, int64_t *error_ns)
+{
+	int64_t call_uptime;
+	int64_t uptime_ns;
+	uint32_t edges;
+	int err;
+
+	switch (cal->ref) {
+	case DS3231_CAL_REF_SQW:
+		err = ds3231_sqw_edge_get(cal->dev, &edges, obs_ref_ns);
+		if (err != 0) {
+			return err;
+		}
+
+		*rtc_ns = (int64_t)edges * NSEC_PER_SEC;
+		*error_ns = 0;
+		return 0;
+	case DS3231_CAL_REF_SYSTEM:
+		return ds3231_cal_read_rtc(cal->dev, rtc_ns, obs_ref_ns, error_ns);
+	case DS3231_CAL_REF_EXTERNAL:
+		/* The reference time advances with uptime until the edge, two seconds at most */
+		call_uptime = ds3231_cal_uptime_ns();
+		err = ds3231_cal_read_rtc(cal->dev, rtc_ns, &uptime_ns, error_ns);
+		*obs_ref_ns = ref_ns + (uptime_ns - call_uptime);
+		return err;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void ds3231_cal_restart(struct ds3231_cal *cal, int64_t rtc_ns, int64_t ref_ns,
+			       int64_t error_ns)
+{
+	cal->started = true;
+	cal->start_rtc_ns = rtc_ns;
+	cal->start_ref_ns = ref_ns;
+	cal->start_error_ns = error_ns;
+}
+
+/* Step the aging offset against the measured error, applied is the change in steps */
+static int ds3231_cal_step(struct ds3231_cal *cal, int *applied)
+{
+	int32_t step;
+	int8_t offset;
+	int target;
+	int err;
+
+	*applied = 0;
+
+	/* A fast RTC needs a larger offset, which slows the oscillator down */
+	step = (cal->error_ppb + ((cal->error_ppb < 0) ? -DS3231_CAL_PPB_PER_STEP / 2
+						       : DS3231_CAL_PPB_PER_STEP / 2)) /
+	       DS3231_CAL_PPB_PER_STEP;
+	step = CLAMP(step, -CONFIG_RTC_DS3231_CAL_MAX_STEP, CONFIG_RTC_DS3231_CAL_MAX_STEP);
+	if (step == 0) {
+		return 0;
+	}
+
+	err = ds3231_aging_offset_get(cal->dev, &offset);
+	if (err != 0) {
+		return err;
+	}
+
+	target = CLAMP(offset + step, INT8_MIN, INT8_MAX);
+	if (target == offset) {
+		LOG_WRN("aging offset at its limit (%d)", offset);
+		return 0;
+	}
+
+	err = ds3231_aging_offset_set(cal->dev, target);
+	if (err != 0) {
+		return err;
+	}
+
+	/* Apply it now, a running automatic conversion applies it just as well */
+	err = ds3231_temp_convert(cal->dev);
+	if (err != 0 && err != -EBUSY) {
+		return err;
+	}
+
+	LOG_INF("error %d ppb, aging offset %d -> %d", cal->error_ppb, offset, target);
+	*applied = target - offset;
+
+	return 0;
+}
+
+int ds3231_cal_init(struct ds3231_cal *cal, const struct device *dev, enum ds3231_cal_ref ref)
+{
+	struct ds3231_persist state;
+
+	if (ref != DS3231_CAL_REF_SYSTEM && ref != DS3231_CAL_REF_EXTERNAL &&
+	    ref != DS3231_CAL_REF_SQW) {
+		return -EINVAL;
+	}
+
+	memset(cal, 0, sizeof(*cal));
+	cal->dev = dev;
+	cal->ref = ref;
+
+	/* An estimate persisted with the current aging offset still holds */
+	if (ds3231_persist_get(dev, &state) == 0 && state.error_valid) {
+		cal->error_ppb = state.error_ppb;
+		cal->error_valid = true;
+	}
+
+	return 0;
+}
+
+int ds3231_cal_sample(struct ds3231_cal *cal, int64_t ref_ns)
+{
+	int64_t resolution_ppb;
+	int64_t rtc_elapsed;
+	int64_t ref_elapsed;
+	int64_t error_ns;
+	int64_t rtc_ns;
+	int64_t diff;
+	int applied = 0;
+	int err;
+
+	err = ds3231_cal_observe(cal, ref_ns, &rtc_ns, &ref_ns, &error_ns);
+	if (err != 0) {
+		return err;
+	}
+
+	if (!cal->started) {
+		ds3231_cal_restart(cal, rtc_ns, ref_ns, error_ns);
+		return -EAGAIN;
+	}
+
+	rtc_elapsed = rtc_ns - cal->start_rtc_ns;
+	ref_elapsed = ref_ns - cal->start_ref_ns;
+	diff = rtc_elapsed - ref_elapsed;
+
+	if (ref_elapsed <= 0 ||
+	    llabs(diff) > ref_elapsed / (1000000 / DS3231_CAL_MAX_PPM) + DS3231_CAL_SLACK_NS) {
+		LOG_WRN("calibration reference lost, restarting");
+		ds3231_cal_restart(cal, rtc_ns, ref_ns, error_ns);
+		return -EAGAIN;
+	}
+
+	if (ref_elapsed < (int64_t)CONFIG_RTC_DS3231_CAL_MIN_INTERVAL_S * NSEC_PER_SEC) {
+		return -EAGAIN;
+	}
+
+	/* diff * 10^9 / ref_elapsed, scaled to stay within 64 bits */
+	cal->error_ppb = diff * MSEC_PER_SEC / (ref_elapsed / NSEC_PER_MSEC);
+	cal->error_valid = true;
+
+	/* An error within the uncertainty of both observations is noise, keep measuring */
+	resolution_ppb = (cal->start_error_ns + error_ns) * NSEC_PER_SEC / ref_elapsed;
+	if (llabs(cal->error_ppb) > resolution_ppb) {
+		err = ds3231_cal_step(cal, &applied);
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	/* Persist the error left with the new offset, which a later boot starts from */
+	(void)ds3231_persist_error(cal->dev, cal->error_ppb - applied * DS3231_CAL_PPB_PER_STEP);
+
+	/* The frequency changed, measure anew. Otherwise keep lengthening the baseline. */
+	if (applied != 0) {
+		ds3231_cal_restart(cal, rtc_ns, ref_ns, error_ns);
+	}
+
+	return 0;
+}
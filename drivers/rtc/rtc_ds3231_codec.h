@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Conversion between struct rtc_time and the DS3231 timekeeping and alarm registers.
+ *
+ * Header only and free of driver state, so it can be built and benchmarked on its own,
+ * e.g. on native_sim. BCD conversion uses multiply and shift instead of divides, which
+ * matters on cores without a hardware divider such as the Cortex-M0+.
+ */
+
+#ifndef ZEPHYR_DRIVERS_RTC_RTC_DS3231_CODEC_H_
+#define ZEPHYR_DRIVERS_RTC_RTC_DS3231_CODEC_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/sys/util.h>
+
+/* DS3231 timekeeping and alarm register bits */
+#define DS3231_SECONDS_10                GENMASK(6, 4)
+#define DS3231_SECONDS_MASK              GENMASK(3, 0)
+#define DS3231_MINUTES_10                GENMASK(6, 4)
+#define DS3231_MINUTES_MASK              GENMASK(3, 0)
+#define DS3231_HOURS_12_24               BIT(6)
+#define DS3231_HOURS_AM_PM_20            BIT(5)
+#define DS3231_HOURS_10                  BIT(4)
+#define DS3231_HOURS_MASK                GENMASK(3, 0)
+#define DS3231_DAYS_MASK                 GENMASK(2, 0)
+#define DS3231_DATE_10                   GENMASK(5, 4)
+#define DS3231_DATE_MASK                 GENMASK(3, 0)
+#define DS3231_MONTH_CENTURY             BIT(7)
+#define DS3231_MONTH_10                  BIT(4)
+#define DS3231_MONTHS_MASK               GENMASK(3, 0)
+#define DS3231_YEAR_10                   GENMASK(7, 4)
+#define DS3231_YEARS_MASK                GENMASK(3, 0)
+#define DS3231_ALARM_1_SECONDS_A1M1      BIT(7)
+#define DS3231_ALARM_1_SECONDS_10        GENMASK(6, 4)
+#define DS3231_ALARM_1_SECONDS_SECONDS   GENMASK(3, 0)
+#define DS3231_ALARM_1_MINUTES_A1M2      BIT(7)
+#define DS3231_ALARM_1_MINUTES_10        GENMASK(6, 4)
+#define DS3231_ALARM_1_MINUTES_MINUTES   GENMASK(3, 0)
+#define DS3231_ALARM_1_HOURS_A1M3        BIT(7)
+#define DS3231_ALARM_1_HOURS_12_24       BIT(6)
+#define DS3231_ALARM_1_HOURS_AM_PM_20    BIT(5)
+#define DS3231_ALARM_1_HOURS_10          BIT(4)
+#define DS3231_ALARM_1_HOURS_HOURS       GENMASK(3, 0)
+#define DS3231_ALARM_1_DAY_DATE_A1M4     BIT(7)
+#define DS3231_ALARM_1_DAY_DATE_DYDT     BIT(6)
+#define DS3231_ALARM_1_DAY_DATE_10       GENMASK(5, 4)
+#define DS3231_ALARM_1_DAY_DATE_MASK     GENMASK(3, 0)
+
+#define DS3231_ALARM_2_MINUTES_A2M2    BIT(7)
+#define DS3231_ALARM_2_MINUTES_10      GENMASK(6, 4)
+#define DS3231_ALARM_2_MINUTES_MINUTES GENMASK(3, 0)
+#define DS3231_ALARM_2_HOURS_A2M3      BIT(7)
+#define DS3231_ALARM_2_HOURS_12_24     BIT(6)
+#define DS3231_ALARM_2_HOURS_AM_PM_20  BIT(5)
+#define DS3231_ALARM_2_HOURS_10        BIT(4)
+#define DS3231_ALARM_2_HOURS_HOURS     GENMASK(3, 0)
+#define DS3231_ALARM_2_DAY_DATE_A2M4   BIT(7)
+#define DS3231_ALARM_2_DAY_DATE_DYDT   BIT(6)
+#define DS3231_ALARM_2_DAY_DATE_10     GENMASK(5, 4)
+#define DS3231_ALARM_2_DAY_DATE_MASK   GENMASK(3, 0)
+
+/* Alarm 1 and alarm 2 share the layout from the minutes register on */
+#define DS3231_ALARM_MATCH_DISABLE BIT(7)
+
+/* Number of timekeeping registers, seconds to year */
+#define DS3231_TIME_REGS 7
+
+/* The DS3231 enumerates months 1 to 12, RTC API uses 0 to 11 */
+#define DS3231_MONTHS_OFFSET 1
+
+/* The DS3231 only supports two-digit years and a century bit, calculate offset to use */
+#define DS3231_YEARS_OFFSET (2000 - 1900)
+
+/* The day register counts 1 to 7, Sunday is stored as 7 and read back as 0 */
+#define DS3231_DAY_SUNDAY 7
+
+/* Convert 0 to 99 to BCD, (bin * 205) >> 11 equals bin / 10 in that range */
+static inline uint8_t ds3231_bin2bcd(uint8_t bin)
+{
+	return bin + 6U * ((bin * 205U) >> 11);
+}
+
+static inline uint8_t ds3231_bcd2bin(uint8_t bcd)
+{
+	return bcd - 6U * (bcd >> 4);
+}
+
+/* Hours in 24 h mode, or 1 to 12 with the AM/PM bit in 12 h mode */
+static inline int ds3231_hours_decode(uint8_t reg)
+{
+	uint8_t hour;
+
+	if ((reg & DS3231_HOURS_12_24) == 0U) {
+		return ds3231_bcd2bin(reg & (DS3231_HOURS_AM_PM_20 | DS3231_HOURS_10 |
+					     DS3231_HOURS_MASK));
+	}
+
+	hour = ds3231_bcd2bin(reg & (DS3231_HOURS_10 | DS3231_HOURS_MASK));
+	if (hour == 12U) {
+		hour = 0U;
+	}
+
+	return ((reg & DS3231_HOURS_AM_PM_20) != 0U) ? hour + 12 : hour;
+}
+
+static inline uint8_t ds3231_day_encode(int wday)
+{
+	return (wday == 0) ? DS3231_DAY_SUNDAY : wday;
+}
+
+static inline int ds3231_day_decode(uint8_t reg)
+{
+	reg &= DS3231_DAYS_MASK;
+
+	return (reg == DS3231_DAY_SUNDAY) ? 0 : reg;
+}
+
+static inline bool ds3231_in_range(int value, int min, int max)
+{
+	return (unsigned int)(value - min) <= (unsigned int)(max - min);
+}
+
+/*
+ * Encode seconds to year into regs[0..6], always in 24 h mode. Years 2000 to 2199 are
+ * representable using the century bit.
+ */
+static inline int ds3231_codec_time_encode(const struct rtc_time *timeptr, uint8_t *regs)
+{
+	int year = timeptr->tm_year - DS3231_YEARS_OFFSET;
+	uint8_t century = 0U;
+
+	if (!ds3231_in_range(timeptr->tm_sec, 0, 59) || !ds3231_in_range(timeptr->tm_min, 0, 59) ||
+	    !ds3231_in_range(timeptr->tm_hour, 0, 23) || !ds3231_in_range(timeptr->tm_wday, 0, 6) ||
+	    !ds3231_in_range(timeptr->tm_mday, 1, 31) || !ds3231_in_range(timeptr->tm_mon, 0, 11) ||
+	    !ds3231_in_range(year, 0, 199)) {
+		return -EINVAL;
+	}
+
+	if (year >= 100) {
+		year -= 100;
+		century = DS3231_MONTH_CENTURY;
+	}
+
+	regs[0] = ds3231_bin2bcd(timeptr->tm_sec);
+	regs[1] = ds3231_bin2bcd(timeptr->tm_min);
+	regs[2] = ds3231_bin2bcd(timeptr->tm_hour);
+	regs[3] = ds3231_day_encode(timeptr->tm_wday);
+	regs[4] = ds3231_bin2bcd(timeptr->tm_mday);
+	regs[5] = ds3231_bin2bcd(timeptr->tm_mon + DS3231_MONTHS_OFFSET) | century;
+	regs[6] = ds3231_bin2bcd(year);
+
+	return 0;
+}
+
+static inline void ds3231_codec_time_decode(const uint8_t *regs, struct rtc_time *timeptr)
+{
+	memset(timeptr, 0U, sizeof(*timeptr));
+	timeptr->tm_sec = ds3231_bcd2bin(regs[0] & (DS3231_SECONDS_10 | DS3231_SECONDS_MASK));
+	timeptr->tm_min = ds3231_bcd2bin(regs[1] & (DS3231_MINUTES_10 | DS3231_MINUTES_MASK));
+	timeptr->tm_hour = ds3231_hours_decode(regs[2]);
+	timeptr->tm_wday = ds3231_day_decode(regs[3]);
+	timeptr->tm_mday = ds3231_bcd2bin(regs[4] & (DS3231_DATE_10 | DS3231_DATE_MASK));
+	timeptr->tm_mon = ds3231_bcd2bin(regs[5] & (DS3231_MONTH_10 | DS3231_MONTHS_MASK)) -
+			  DS3231_MONTHS_OFFSET;
+	timeptr->tm_year = ds3231_bcd2bin(regs[6]) + DS3231_YEARS_OFFSET +
+			   (((regs[5] & DS3231_MONTH_CENTURY) != 0U) ? 100 : 0);
+}
+
+/* Unix time representable by the chip, 2000-01-01 00:00:00 to 2199-12-31 23:59:59 */
+#define DS3231_EPOCH_MIN INT64_C(946684800)
+#define DS3231_EPOCH_MAX INT64_C(7258118399)
+
+#define DS3231_SECONDS_PER_DAY 86400
+
+/* Seconds since midnight of the seconds, minutes and hours registers */
+static inline int32_t ds3231_codec_sod_decode(const uint8_t *regs)
+{
+	return ds3231_hours_decode(regs[2]) * 3600 +
+	       ds3231_bcd2bin(regs[1] & (DS3231_MINUTES_10 | DS3231_MINUTES_MASK)) * 60 +
+	       ds3231_bcd2bin(regs[0] & (DS3231_SECONDS_10 | DS3231_SECONDS_MASK));
+}
+
+/* Encode seconds since midnight into regs[0..2], in 24 h mode */
+static inline void ds3231_codec_sod_encode(int32_t sod, uint8_t *regs)
+{
+	regs[0] = ds3231_bin2bcd(sod % 60);
+	regs[1] = ds3231_bin2bcd((sod / 60) % 60);
+	regs[2] = ds3231_bin2bcd(sod / 3600);
+}
+
+/*
+ * Days since 1970-01-01 of the date registers regs[4..6]. Counts 400 year eras of years
+ * starting in March, so the leap day ends a year, see
+ * http://howardhinnant.github.io/date_algorithms.html. Counting from 1600-03-01 keeps
+ * all divided values non-negative.
+ */
+static inline int32_t ds3231_codec_days_decode(const uint8_t *regs)
+{
+	int32_t year = 2000 + ds3231_bcd2bin(regs[6]) +
+		       (((regs[5] & DS3231_MONTH_CENTURY) != 0U) ? 100 : 0);
+	int32_t month = ds3231_bcd2bin(regs[5] & (DS3231_MONTH_10 | DS3231_MONTHS_MASK));
+	int32_t mday = ds3231_bcd2bin(regs[4] & (DS3231_DATE_10 | DS3231_DATE_MASK));
+	int32_t yoe = year - 1600 - ((month <= 2) ? 1 : 0);
+	int32_t doy = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + mday - 1;
+
+	/* 1600-03-01 is day -135080 */
+	return -135080 + yoe * 365 + yoe / 4 - yoe / 100 + yoe / 400 + doy;
+}
+
+/* Encode days since 1970-01-01 into the day and date registers regs[3..6] */
+static inline void ds3231_codec_days_encode(int32_t days, uint8_t *regs)
+{
+	int32_t z = days + 135080;
+	int32_t era = z / 146097;
+	int32_t doe = z - era * 146097;
+	int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int32_t mp = (5 * doy + 2) / 153;
+	int32_t month = (mp < 10) ? mp + 3 : mp - 9;
+	int32_t year = 1600 + era * 400 + yoe + ((month <= 2) ? 1 : 0) - 2000;
+
+	/* 1970-01-01 was a Thursday */
+	regs[3] = ds3231_day_encode((days + 4) % 7);
+	regs[4] = ds3231_bin2bcd(doy - (153 * mp + 2) / 5 + 1);
+	regs[5] = ds3231_bin2bcd(month) | ((year >= 100) ? DS3231_MONTH_CENTURY : 0U);
+	regs[6] = ds3231_bin2bcd(year % 100);
+}
+
+/*
+ * Encode an alarm into regs, 4 registers from A1 seconds for alarm 1 (id 0) or 3
+ * registers from A2 minutes for alarm 2 (id 1). Fields not in mask are disabled. The
+ * caller checks that mask is supported by the alarm.
+ */
+static inline int ds3231_codec_alarm_encode(uint16_t id, uint16_t mask,
+					    const struct rtc_time *timeptr, uint8_t *regs)
+{
+	if (id == 0U) {
+		if ((mask & RTC_ALARM_TIME_MASK_SECOND) == 0U) {
+			regs[0] = DS3231_ALARM_MATCH_DISABLE;
+		} else if (ds3231_in_range(timeptr->tm_sec, 0, 59)) {
+			regs[0] = ds3231_bin2bcd(timeptr->tm_sec);
+		} else {
+			return -EINVAL;
+		}
+
+		regs++;
+	}
+
+	if ((mask & RTC_ALARM_TIME_MASK_MINUTE) == 0U) {
+		regs[0] = DS3231_ALARM_MATCH_DISABLE;
+	} else if (ds3231_in_range(timeptr->tm_min, 0, 59)) {
+		regs[0] = ds3231_bin2bcd(timeptr->tm_min);
+	} else {
+		return -EINVAL;
+	}
+
+	if ((mask & RTC_ALARM_TIME_MASK_HOUR) == 0U) {
+		regs[1] = DS3231_ALARM_MATCH_DISABLE;
+	} else if (ds3231_in_range(timeptr->tm_hour, 0, 23)) {
+		regs[1] = ds3231_bin2bcd(timeptr->tm_hour);
+	} else {
+		return -EINVAL;
+	}
+
+	/* The day register matches either the date or the day of the week */
+	if ((mask & RTC_ALARM_TIME_MASK_MONTHDAY) != 0U) {
+		if ((mask & RTC_ALARM_TIME_MASK_WEEKDAY) != 0U ||
+		    !ds3231_in_range(timeptr->tm_mday, 1, 31)) {
+			return -EINVAL;
+		}
+
+		regs[2] = ds3231_bin2bcd(timeptr->tm_mday);
+	} else if ((mask & RTC_ALARM_TIME_MASK_WEEKDAY) != 0U) {
+		if (!ds3231_in_range(timeptr->tm_wday, 0, 6)) {
+			return -EINVAL;
+		}
+
+		regs[2] = DS3231_ALARM_1_DAY_DATE_DYDT | ds3231_day_encode(timeptr->tm_wday);
+	} else {
+		regs[2] = DS3231_ALARM_MATCH_DISABLE;
+	}
+
+	return 0;
+}
+
+/* Decode alarm registers laid out as for ds3231_codec_alarm_encode() */
+static inline void ds3231_codec_alarm_decode(uint16_t id, const uint8_t *regs, uint16_t *mask,
+					     struct rtc_time *timeptr)
+{
+	memset(timeptr, 0U, sizeof(*timeptr));
+	*mask = 0U;
+
+	if (id == 0U) {
+		if ((regs[0] & DS3231_ALARM_MATCH_DISABLE) == 0U) {
+			timeptr->tm_sec = ds3231_bcd2bin(regs[0] & (DS3231_ALARM_1_SECONDS_10 |
+								    DS3231_ALARM_1_SECONDS_SECONDS));
+			*mask |= RTC_ALARM_TIME_MASK_SECOND;
+		}
+
+		regs++;
+	}
+
+	if ((regs[0] & DS3231_ALARM_MATCH_DISABLE) == 0U) {
+		timeptr->tm_min = ds3231_bcd2bin(regs[0] & (DS3231_ALARM_1_MINUTES_10 |
+							    DS3231_ALARM_1_MINUTES_MINUTES));
+		*mask |= RTC_ALARM_TIME_MASK_MINUTE;
+	}
+
+	if ((regs[1] & DS3231_ALARM_MATCH_DISABLE) == 0U) {
+		timeptr->tm_hour = ds3231_hours_decode(regs[1] & ~DS3231_ALARM_MATCH_DISABLE);
+		*mask |= RTC_ALARM_TIME_MASK_HOUR;
+	}
+
+	if ((regs[2] & DS3231_ALARM_MATCH_DISABLE) != 0U) {
+		return;
+	}
+
+	if ((regs[2] & DS3231_ALARM_1_DAY_DATE_DYDT) != 0U) {
+		timeptr->tm_wday = ds3231_day_decode(regs[2]);
+		*mask |= RTC_ALARM_TIME_MASK_WEEKDAY;
+	} else {
+		timeptr->tm_mday = ds3231_bcd2bin(regs[2] & (DS3231_ALARM_1_DAY_DATE_10 |
+							     DS3231_ALARM_1_DAY_DATE_MASK));
+		*mask |= RTC_ALARM_TIME_MASK_MONTHDAY;
+	}
+}
+
+#endif /* ZEPHYR_DRIVERS_RTC_RTC_DS3231_CODEC_H_ */
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Calibration and sync state kept in the settings subsystem, one record per instance under
+ * ds3231/<device name>. The records are loaded at boot and checked against one burst read of
+ * each chip. Changes are written at most once every CONFIG_RTC_DS3231_SETTINGS_MIN_INTERVAL_S.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_DECLARE(ds3231, CONFIG_RTC_LOG_LEVEL);
+
+#define DS3231_PERSIST_TREE    "ds3231"
+#define DS3231_PERSIST_KEY_LEN 64
+
+/* Bumped whenever the record layout changes, records of other versions are ignored */
+#define DS3231_PERSIST_VERSION 1
+
+/* AGING_OFFSET in the register dump */
+#define DS3231_PERSIST_REG_AGING 0x10
+
+#define DS3231_PERSIST_ERROR_VALID BIT(0)
+/* The stop counted last is still flagged by the chip, so it is not counted again */
+#define DS3231_PERSIST_OSF_PENDING BIT(1)
+
+/* Stored record, little endian as on all supported targets */
+struct ds3231_persist_record {
+	uint8_t version;
+	uint8_t flags;
+	int8_t aging_offset;
+	uint8_t reserved;
+	int32_t error_ppb;
+	uint32_t osf_count;
+	int64_t sync_seconds;
+	int64_t osf_sync_seconds;
+} __packed;
+
+struct ds3231_persist_entry {
+	struct ds3231_persist state;
+	bool osf_pending;
+	/* Record read by the latest load */
+	struct ds3231_persist_record loaded;
+	bool loaded_valid;
+	/* Record as last loaded or written, unchanged state is not written again */
+	struct ds3231_persist_record saved;
+};
+
+#define DS3231_PERSIST_DEV(node_id) DEVICE_DT_GET(node_id),
+
+static const struct device *const ds3231_persist_devs[] = {
+	DT_FOREACH_STATUS_OKAY(adi_ds3231, DS3231_PERSIST_DEV)};
+
+static struct {
+	struct k_mutex lock;
+	struct k_work_delayable work;
+	/* Uptime of the latest write, INT64_MIN before the first one */
+	int64_t write_ms;
+	struct ds3231_persist_entry entries[ARRAY_SIZE(ds3231_persist_devs)];
+} persist;
+
+static struct ds3231_persist_entry *ds3231_persist_find(const struct device *dev)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(ds3231_persist_devs); i++) {
+		if (ds3231_persist_devs[i] == dev) {
+			return &persist.entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void ds3231_persist_encode(const struct ds3231_persist_entry *entry,
+				  struct ds3231_persist_record *rec)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->version = DS3231_PERSIST_VERSION;
+	rec->flags = (entry->state.error_valid ? DS3231_PERSIST_ERROR_VALID : 0U) |
+		     (entry->osf_pending ? DS3231_PERSIST_OSF_PENDING : 0U);
+	rec->aging_offset = entry->state.aging_offset;
+	rec->error_ppb = entry->state.error_ppb;
+	rec->osf_count = entry->state.osf_count;
+	rec->sync_seconds = entry->state.sync_seconds;
+	rec->osf_sync_seconds = entry->state.osf_sync_seconds;
+}
+
+static void ds3231_persist_decode(const struct ds3231_persist_record *rec,
+				  struct ds3231_persist_entry *entry)
+{
+	entry->state.error_valid = (rec->flags & DS3231_PERSIST_ERROR_VALID) != 0U;
+	entry->osf_pending = (rec->flags & DS3231_PERSIST_OSF_PENDING) != 0U;
+	entry->state.aging_offset = rec->aging_offset;
+	entry->state.error_ppb = rec->error_ppb;
+	entry->state.osf_count = rec->osf_count;
+	entry->state.sync_seconds = rec->sync_seconds;
+	entry->state.osf_sync_seconds = rec->osf_sync_seconds;
+}
+
+/* Write the records that changed since they were last written or loaded */
+static int ds3231_persist_write(void)
+{
+	struct ds3231_persist_record rec;
+	char key[DS3231_PERSIST_KEY_LEN];
+	int ret = 0;
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ds3231_persist_devs); i++) {
+		struct ds3231_persist_entry *entry = &persist.entries[i];
+
+		ds3231_persist_encode(entry, &rec);
+		if (memcmp(&rec, &entry->saved, sizeof(rec)) == 0) {
+			continue;
+		}
+
+		(void)snprintf(key, sizeof(key), DS3231_PERSIST_TREE "/%s",
+			       ds3231_persist_devs[i]->name);
+		err = settings_save_one(key, &rec, sizeof(rec));
+		if (err != 0) {
+			LOG_ERR("%s: failed to save state (err %d)", ds3231_persist_devs[i]->name,
+				err);
+			ret = (ret == 0) ? err : ret;
+			continue;
+		}
+
+		entry->saved = rec;
+		persist.write_ms = k_uptime_get();
+	}
+
+	return ret;
+}
+
+/* Write the changes once the interval since the latest write is over */
+static void ds3231_persist_schedule(void)
+{
+	int64_t delay_ms = 0;
+
+	if (persist.write_ms != INT64_MIN) {
+		delay_ms = persist.write_ms +
+			   (int64_t)CONFIG_RTC_DS3231_SETTINGS_MIN_INTERVAL_S * MSEC_PER_SEC -
+			   k_uptime_get();
+	}
+
+	/* An earlier scheduled write takes these changes along */
+	(void)k_work_schedule(&persist.work, K_MSEC(MAX(delay_ms, 0)));
+}
+
+static void ds3231_persist_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&persist.lock, K_FOREVER);
+	(void)ds3231_persist_write();
+	k_mutex_unlock(&persist.lock);
+}
+
+/* Check an instance's state against the chip, from one burst read of all registers */
+static void ds3231_persist_check(const struct device *dev, struct ds3231_persist_entry *entry)
+{
+	struct ds3231_reg_dump dump;
+	int8_t aging;
+	bool known;
+	int err;
+
+	/* A record that differs from the last one seen was written by an earlier boot */
+	if (entry->loaded_valid &&
+	    memcmp(&entry->loaded, &entry->saved, sizeof(entry->saved)) != 0) {
+		ds3231_persist_decode(&entry->loaded, entry);
+		entry->saved = entry->loaded;
+		entry->state.restored = true;
+	}
+	entry->loaded_valid = false;
+
+	if (!device_is_ready(dev)) {
+		return;
+	}
+
+	err = ds3231_reg_dump(dev, &dump);
+	if (err != 0) {
+		LOG_WRN("%s: persisted state not checked (err %d)", dev->name, err);
+		return;
+	}
+
+	aging = (int8_t)dump.regs[DS3231_PERSIST_REG_AGING];
+	/* The offset was persisted, or calibrated since boot */
+	known = entry->state.restored || entry->state.error_valid;
+
+	if (!dump.time_valid) {
+		if (!entry->osf_pending) {
+			entry->state.osf_count++;
+			entry->state.osf_sync_seconds = entry->state.sync_seconds;
+			entry->osf_pending = true;
+		}
+
+		/* The chip lost its aging offset along with the time */
+		if (known && aging != entry->state.aging_offset) {
+			err = ds3231_aging_offset_set(dev, entry->state.aging_offset);
+			if (err != 0) {
+				LOG_WRN("%s: aging offset not restored (err %d)", dev->name, err);
+				entry->state.aging_offset = aging;
+				entry->state.error_valid = false;
+			} else {
+				LOG_INF("%s: aging offset %d restored", dev->name,
+					entry->state.aging_offset);
+			}
+		} else if (!known) {
+			entry->state.aging_offset = aging;
+		}
+	} else if (dump.seconds < entry->state.sync_seconds) {
+		/* A chip set before the last sync is not the chip the state was learned on */
+		LOG_WRN("%s: time before the last sync, persisted state dropped", dev->name);
+		memset(&entry->state, 0, sizeof(entry->state));
+		entry->state.aging_offset = aging;
+		entry->osf_pending = false;
+	} else {
+		entry->osf_pending = false;
+
+		/* The estimate was made with another offset than the chip runs with */
+		if (aging != entry->state.aging_offset) {
+			entry->state.aging_offset = aging;
+			entry->state.error_valid = false;
+		}
+	}
+
+	ds3231_persist_schedule();
+}
+
+static int ds3231_persist_set(const char *key, size_t len, settings_read_cb read_cb,
+			      void *cb_arg)
+{
+	struct ds3231_persist_record rec;
+	const char *next;
+	ssize_t ret;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ds3231_persist_devs); i++) {
+		if (!settings_name_steq(key, ds3231_persist_devs[i]->name, &next) || next != NULL) {
+			continue;
+		}
+
+		if (len != sizeof(rec)) {
+			LOG_WRN("%s: persisted state of unknown size ignored", key);
+			return 0;
+		}
+
+		ret = read_cb(cb_arg, &rec, sizeof(rec));
+		if (ret < 0) {
+			return (int)ret;
+		}
+
+		if (rec.version != DS3231_PERSIST_VERSION) {
+			LOG_WRN("%s: persisted state version %u ignored", key, rec.version);
+			return 0;
+		}
+
+		k_mutex_lock(&persist.lock, K_FOREVER);
+		persist.entries[i].loaded = rec;
+		persist.entries[i].loaded_valid = true;
+		k_mutex_unlock(&persist.lock);
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+static int ds3231_persist_commit(void)
+{
+	k_mutex_lock(&persist.lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(ds3231_persist_devs); i++) {
+		ds3231_persist_check(ds3231_persist_devs[i], &persist.entries[i]);
+	}
+
+	k_mutex_unlock(&persist.lock);
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(ds3231, DS3231_PERSIST_TREE, NULL, ds3231_persist_set,
+			       ds3231_persist_commit, NULL);
+
+int ds3231_persist_get(const struct device *dev, struct ds3231_persist *state)
+{
+	struct ds3231_persist_entry *entry = ds3231_persist_find(dev);
+
+	if (entry == NULL) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&persist.lock, K_FOREVER);
+	*state = entry->state;
+	k_mutex_unlock(&persist.lock);
+
+	return 0;
+}
+
+int ds3231_persist_sync(const struct device *dev, int64_t seconds)
+{
+	struct ds3231_persist_entry *entry = ds3231_persist_find(dev);
+
+	if (entry == NULL) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&persist.lock, K_FOREVER);
+	entry->state.sync_seconds = seconds;
+	/* Setting the time cleared the stop flag, a later stop is a new one */
+	entry->osf_pending = false;
+	ds3231_persist_schedule();
+	k_mutex_unlock(&persist.lock);
+
+	return 0;
+}
+
+int ds3231_persist_error(const struct device *dev, int32_t error_ppb)
+{
+	struct ds3231_persist_entry *entry = ds3231_persist_find(dev);
+	int8_t offset;
+	int err;
+
+	if (entry == NULL) {
+		return -ENODEV;
+	}
+
+	/* From the driver's copy of the register, no bus access unless it is stale */
+	err = ds3231_aging_offset_get(dev, &offset);
+	if (err != 0) {
+		return err;
+	}
+
+	k_mutex_lock(&persist.lock, K_FOREVER);
+	entry->state.aging_offset = offset;
+	entry->state.error_ppb = error_ppb;
+	entry->state.error_valid = true;
+	ds3231_persist_schedule();
+	k_mutex_unlock(&persist.lock);
+
+	return 0;
+}
+
+int ds3231_persist_flush(void)
+{
+	struct k_work_sync sync;
+	int err;
+
+	(void)k_work_cancel_delayable_sync(&persist.work, &sync);
+
+	k_mutex_lock(&persist.lock, K_FOREVER);
+	err = ds3231_persist_write();
+	k_mutex_unlock(&persist.lock);
+
+	return err;
+}
+
+static int ds3231_persist_init(void)
+{
+	int err;
+
+	k_mutex_init(&persist.lock);
+	k_work_init_delayable(&persist.work, ds3231_persist_work_handler);
+	persist.write_ms = INT64_MIN;
+
+	err = settings_subsys_init();
+	if (err != 0) {
+		LOG_ERR("settings not available (err %d)", err);
+		return 0;
+	}
+
+	/* The commit handler checks the loaded state against the chips */
+	err = settings_load_subtree(DS3231_PERSIST_TREE);
+	if (err != 0) {
+		LOG_WRN("failed to load persisted state (err %d)", err);
+	}
+
+	return 0;
+}
+
+SYS_INIT(ds3231_persist_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
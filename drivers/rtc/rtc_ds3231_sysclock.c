@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * System clock synchronisation. CLOCK_REALTIME is seeded from a DS3231 at boot and compared
+ * with it every CONFIG_RTC_DS3231_SYSCLOCK_INTERVAL_S. Small offsets are slewed, larger ones
+ * stepped. Reads of the system clock never reach the bus.
+ */
+
+#include <stdlib.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_DECLARE(ds3231, CONFIG_RTC_LOG_LEVEL);
+
+#include <zephyr/posix/time.h>
+
+/* Period of the time register reads looking for the next seconds edge */
+#define DS3231_SYSCLOCK_POLL_MS         5
+/* The next edge is due within a second, longer means the chip stopped */
+#define DS3231_SYSCLOCK_EDGE_TIMEOUT_MS 1500
+
+/* Longest period between the steps of a slewed correction */
+#define DS3231_SYSCLOCK_SLEW_PERIOD_MS 100
+
+/* 2000-01-01, the system clock is not set before */
+#define DS3231_SYSCLOCK_MIN_S INT64_C(946684800)
+
+static struct {
+	const struct device *dev;
+	struct k_mutex lock;
+	struct k_work_delayable sync_work;
+	struct k_timer slew_timer;
+
+	/* The offset was measured against a seconds edge, rather than a single read */
+	bool precise;
+	/* Correction still to be slewed, and the step applied per slew_ticks */
+	struct k_spinlock slew_lock;
+	int64_t slew_ns;
+	int64_t slew_step_ns;
+	uint32_t slew_ticks;
+
+	/* Seconds edge search, the latest read before the edge */
+	bool hunting;
+	int64_t hunt_start_ms;
+	int64_t hunt_seconds;
+	int64_t hunt_uptime_ns;
+
+	struct ds3231_sysclock_status status;
+} sysclock;
+
+static int64_t ds3231_sysclock_uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+/* CLOCK_REALTIME minus uptime */
+static int64_t ds3231_sysclock_base_get(void)
+{
+	struct timespec ts;
+	int64_t ticks;
+
+	do {
+		ticks = k_uptime_ticks();
+		(void)clock_gettime(CLOCK_REALTIME, &ts);
+	} while (k_uptime_ticks() != ticks);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec - k_ticks_to_ns_floor64(ticks);
+}
+
+/* Set CLOCK_REALTIME to base_ns plus uptime */
+static void ds3231_sysclock_base_set(int64_t base_ns)
+{
+	struct timespec ts;
+	int64_t ticks;
+	int64_t ns;
+
+	/* clock_settime() subtracts the uptime again, which must be read in the same tick */
+	do {
+		ticks = k_uptime_ticks();
+		ns = base_ns + k_ticks_to_ns_floor64(ticks);
+		ts.tv_sec = ns / NSEC_PER_SEC;
+		ts.tv_nsec = ns % NSEC_PER_SEC;
+		(void)clock_settime(CLOCK_REALTIME, &ts);
+	} while (k_uptime_ticks() != ticks);
+
+}
+
+/* Read the RTC seconds from the chip, uptime_ns is the middle of the transfer */
+static int ds3231_sysclock_read(int64_t *seconds, int64_t *uptime_ns)
+{
+	int64_t before;
+	int err;
+
+	(void)ds3231_time_cache_invalidate(sysclock.dev);
+
+	before = ds3231_sysclock_uptime_ns();
+	err = ds3231_get_epoch(sysclock.dev, seconds);
+	*uptime_ns = before + (ds3231_sysclock_uptime_ns() - before) / 2;
+
+	return err;
+}
+
+/*
+ * Measure the system minus RTC time. Without sub-second timestamps the seconds edge is found
+ * by reading the time registers once per call, until then -EINPROGRESS is returned.
+ */
+static int ds3231_sysclock_measure(int64_t *offset_ns)
+{
+	struct ds3231_timestamp ts;
+	int64_t uptime_ns;
+	int64_t seconds;
+	int err;
+
+	if (!sysclock.hunting) {
+		uptime_ns = ds3231_sysclock_uptime_ns();
+		err = ds3231_timestamp_get(sysclock.dev, &ts);
+		if (err == 0) {
+			*offset_ns = ds3231_sysclock_base_get() +
+				     (uptime_ns + ds3231_sysclock_uptime_ns()) / 2 - ts.ns;
+			return 0;
+		}
+
+		err = ds3231_sysclock_read(&seconds, &uptime_ns);
+		if (err != 0) {
+			return err;
+		}
+
+		sysclock.hunting = true;
+		sysclock.hunt_start_ms = k_uptime_get();
+		sysclock.hunt_seconds = seconds;
+		sysclock.hunt_uptime_ns = uptime_ns;
+		return -EINPROGRESS;
+	}
+
+	err = ds3231_sysclock_read(&seconds, &uptime_ns);
+	if (err != 0) {
+		sysclock.hunting = false;
+		return err;
+	}
+
+	if (seconds == sysclock.hunt_seconds) {
+		if (k_uptime_get() - sysclock.hunt_start_ms > DS3231_SYSCLOCK_EDGE_TIMEOUT_MS) {
+			sysclock.hunting = false;
+			return -ETIMEDOUT;
+		}
+
+		sysclock.hunt_uptime_ns = uptime_ns;
+		return -EINPROGRESS;
+	}
+
+	sysclock.hunting = false;
+
+	/* The time was set meanwhile, start over */
+	if (seconds != sysclock.hunt_seconds + 1) {
+		return ds3231_sysclock_measure(offset_ns);
+	}
+
+	/* The edge passed between both reads */
+	uptime_ns = sysclock.hunt_uptime_ns + (uptime_ns - sysclock.hunt_uptime_ns) / 2;
+	*offset_ns = ds3231_sysclock_base_get() + uptime_ns - seconds * NSEC_PER_SEC;
+
+	return 0;
+}
+
+/*
+ * Apply a step of the slewed correction. The timer expires as a tick is announced, before
+ * threads read the clock in that tick. CLOCK_REALTIME advances a tick at a time, and a step is
+ * at most one tick, so a step back slows the clock without ever going back on what was read
+ * in an earlier tick.
+ */
+static void ds3231_sysclock_slew_handler(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&sysclock.slew_lock);
+	int64_t step = CLAMP(sysclock.slew_ns, -sysclock.slew_step_ns, sysclock.slew_step_ns);
+
+	ds3231_sysclock_base_set(ds3231_sysclock_base_get() + step);
+	sysclock.slew_ns -= step;
+	if (sysclock.slew_ns == 0) {
+		k_timer_stop(timer);
+	}
+
+	k_spin_unlock(&sysclock.slew_lock, key);
+}
+
+/* Start slewing the correction, or stop where it is with 0 */
+static void ds3231_sysclock_slew_set(int64_t slew_ns)
+{
+	k_spinlock_key_t key;
+
+	if (slew_ns == 0) {
+		k_timer_stop(&sysclock.slew_timer);
+	}
+
+	key = k_spin_lock(&sysclock.slew_lock);
+	sysclock.slew_ns = slew_ns;
+	k_spin_unlock(&sysclock.slew_lock, key);
+
+	if (slew_ns != 0) {
+		k_timer_start(&sysclock.slew_timer, K_TICKS(sysclock.slew_ticks),
+			      K_TICKS(sysclock.slew_ticks));
+	}
+}
+
+/* Correct the system clock by the measured system minus RTC time */
+static void ds3231_sysclock_apply(int64_t offset_ns)
+{
+	struct ds3231_sysclock_status *status = &sysclock.status;
+
+	status->offset_ns = offset_ns;
+	status->last_sync_ms = k_uptime_get();
+	status->syncs++;
+
+	if (!sysclock.precise ||
+	    llabs(offset_ns) > (int64_t)CONFIG_RTC_DS3231_SYSCLOCK_STEP_MS * NSEC_PER_MSEC) {
+		ds3231_sysclock_slew_set(0);
+		ds3231_sysclock_base_set(ds3231_sysclock_base_get() - offset_ns);
+		sysclock.precise = true;
+		status->steps++;
+		LOG_INF("system clock stepped by %lld us", -offset_ns / NSEC_PER_USEC);
+		return;
+	}
+
+	/* The offset includes whatever was not slewed yet of the previous correction */
+	ds3231_sysclock_slew_set(-offset_ns);
+}
+
+static void ds3231_sysclock_sync_handler(struct k_work *work)
+{
+	int64_t offset_ns;
+	int err;
+
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+
+	err = ds3231_sysclock_measure(&offset_ns);
+	if (err == -EINPROGRESS) {
+		(void)k_work_schedule(&sysclock.sync_work, K_MSEC(DS3231_SYSCLOCK_POLL_MS));
+		k_mutex_unlock(&sysclock.lock);
+		return;
+	}
+
+	if (err == 0) {
+		ds3231_sysclock_apply(offset_ns);
+	} else {
+		sysclock.status.errors++;
+		LOG_WRN("system clock sync failed (%d)", err);
+	}
+
+	(void)k_work_schedule(&sysclock.sync_work, K_SECONDS(CONFIG_RTC_DS3231_SYSCLOCK_INTERVAL_S));
+
+	k_mutex_unlock(&sysclock.lock);
+}
+
+int ds3231_sysclock_start(const struct device *dev)
+{
+	int64_t uptime_ns;
+	int64_t seconds;
+	int err;
+
+	if (!device_is_ready(dev)) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+
+	ds3231_sysclock_slew_set(0);
+	sysclock.dev = dev;
+	sysclock.precise = false;
+	sysclock.hunting = false;
+
+	/* The read happened within the second it returned, good enough until an edge is seen */
+	err = ds3231_sysclock_read(&seconds, &uptime_ns);
+	if (err == 0) {
+		ds3231_sysclock_base_set(seconds * NSEC_PER_SEC + NSEC_PER_SEC / 2 - uptime_ns);
+	} else {
+		LOG_WRN("system clock not seeded (%d)", err);
+	}
+
+	(void)k_work_reschedule(&sysclock.sync_work, K_NO_WAIT);
+
+	k_mutex_unlock(&sysclock.lock);
+
+	return err;
+}
+
+int ds3231_sysclock_stop(void)
+{
+	struct k_work_sync sync;
+
+	(void)k_work_cancel_delayable_sync(&sysclock.sync_work, &sync);
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+	ds3231_sysclock_slew_set(0);
+	sysclock.hunting = false;
+	k_mutex_unlock(&sysclock.lock);
+
+	return 0;
+}
+
+int ds3231_sysclock_sync(void)
+{
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+
+	if (sysclock.dev == NULL) {
+		k_mutex_unlock(&sysclock.lock);
+		return -ENODEV;
+	}
+
+	(void)k_work_reschedule(&sysclock.sync_work, K_NO_WAIT);
+
+	k_mutex_unlock(&sysclock.lock);
+
+	return 0;
+}
+
+int ds3231_sysclock_status_get(struct ds3231_sysclock_status *status)
+{
+	k_spinlock_key_t key;
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+	*status = sysclock.status;
+	key = k_spin_lock(&sysclock.slew_lock);
+	status->slew_ns = sysclock.slew_ns;
+	k_spin_unlock(&sysclock.slew_lock, key);
+	k_mutex_unlock(&sysclock.lock);
+
+	return 0;
+}
+
+int ds3231_sysclock_write_back(void)
+{
+	const struct device *dev;
+	int64_t base_ns;
+	int err;
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+
+	dev = sysclock.dev;
+	if (dev == NULL) {
+		k_mutex_unlock(&sysclock.lock);
+		return -ENODEV;
+	}
+
+	/* The RTC is about to follow the system clock, which then stays put */
+	(void)k_work_cancel_delayable(&sysclock.sync_work);
+	ds3231_sysclock_slew_set(0);
+	sysclock.hunting = false;
+	base_ns = ds3231_sysclock_base_get();
+
+	k_mutex_unlock(&sysclock.lock);
+
+	/* The system clock is its base plus uptime */
+	if ((base_ns + ds3231_sysclock_uptime_ns()) / NSEC_PER_SEC < DS3231_SYSCLOCK_MIN_S) {
+		err = -ENODATA;
+	} else {
+		err = ds3231_set_time_aligned(dev, base_ns, 0, NULL);
+	}
+
+	k_mutex_lock(&sysclock.lock, K_FOREVER);
+
+	if (err == 0) {
+		sysclock.status.offset_ns = 0;
+		sysclock.status.last_sync_ms = k_uptime_get();
+		(void)ds3231_persist_sync(dev, (base_ns + ds3231_sysclock_uptime_ns()) / NSEC_PER_SEC);
+	}
+
+	(void)k_work_reschedule(&sysclock.sync_work,
+				K_SECONDS(CONFIG_RTC_DS3231_SYSCLOCK_INTERVAL_S));
+
+	k_mutex_unlock(&sysclock.lock);
+
+	return err;
+}
+
+static int ds3231_sysclock_init(void)
+{
+	k_mutex_init(&sysclock.lock);
+	k_work_init_delayable(&sysclock.sync_work, ds3231_sysclock_sync_handler);
+	k_timer_init(&sysclock.slew_timer, ds3231_sysclock_slew_handler, NULL);
+
+	/* Steps of at most one tick, up to 10^6 / ppm ticks apart */
+	sysclock.slew_ticks = CLAMP(USEC_PER_SEC / CONFIG_RTC_DS3231_SYSCLOCK_SLEW_PPM, 1U,
+				    k_ms_to_ticks_ceil32(DS3231_SYSCLOCK_SLEW_PERIOD_MS));
+	sysclock.slew_step_ns = k_ticks_to_ns_floor64(sysclock.slew_ticks) *
+				CONFIG_RTC_DS3231_SYSCLOCK_SLEW_PPM / USEC_PER_SEC;
+
+	/* Errors are logged, the periodic sync keeps trying */
+	(void)ds3231_sysclock_start(DEVICE_DT_GET(DT_COMPAT_GET_ANY_STATUS_OKAY(adi_ds3231)));
+
+	return 0;
+}
+
+SYS_INIT(ds3231_sysclock_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
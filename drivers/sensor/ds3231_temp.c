@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#define DT_DRV_COMPAT adi_ds3231_temp
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(ds3231_temp, CONFIG_SENSOR_LOG_LEVEL);
+
+/* Interval of the automatic TCXO temperature conversions */
+#define DS3231_TEMP_CYCLE_MS 64000
+
+/* Conversions still running after DS3231_TEMP_CONV_TIME_MS are polled this often */
+#define DS3231_TEMP_POLL_MS 25
+#define DS3231_TEMP_POLL_MAX 8
+
+struct ds3231_temp_config {
+	const struct device *parent;
+};
+
+struct ds3231_temp_data {
+	int32_t temp_mdegc;
+#ifdef CONFIG_SENSOR_DS3231_TEMP_CACHED
+	int64_t updated_ms;
+	bool valid;
+#endif /* CONFIG_SENSOR_DS3231_TEMP_CACHED */
+};
+
+#ifdef CONFIG_SENSOR_DS3231_TEMP_CACHED
+static int ds3231_temp_fetch(const struct device *dev)
+{
+	const struct ds3231_temp_config *config = dev->config;
+	struct ds3231_temp_data *data = dev->data;
+	int64_t now = k_uptime_get();
+	int err;
+
+	/* The chip only updates the result once per cycle, reading it sooner gains nothing */
+	if (data->valid && now - data->updated_ms < DS3231_TEMP_CYCLE_MS) {
+		return 0;
+	}
+
+	err = ds3231_get_temp(config->parent, &data->temp_mdegc);
+	if (err != 0) {
+		return err;
+	}
+
+	data->updated_ms = now;
+	data->valid = true;
+
+	return 0;
+}
+#else
+static int ds3231_temp_fetch(const struct device *dev)
+{
+	const struct ds3231_temp_config *config = dev->config;
+	struct ds3231_temp_data *data = dev->data;
+	int err;
+
+	/* A conversion that is already running delivers a fresh result just as well */
+	err = ds3231_temp_convert(config->parent);
+	if (err != 0 && err != -EBUSY) {
+		return err;
+	}
+
+	/* Sleep through the conversion rather than polling CONV/BSY over the bus */
+	k_msleep(DS3231_TEMP_CONV_TIME_MS);
+
+	for (int i = 0; i < DS3231_TEMP_POLL_MAX; i++) {
+		err = ds3231_temp_busy(config->parent);
+		if (err <= 0) {
+			break;
+		}
+
+		k_msleep(DS3231_TEMP_POLL_MS);
+	}
+
+	if (err < 0) {
+		return err;
+	} else if (err > 0) {
+		LOG_ERR("temperature conversion timed out");
+		return -ETIMEDOUT;
+	}
+
+	return ds3231_get_temp(config->parent, &data->temp_mdegc);
+}
+#endif /* CONFIG_SENSOR_DS3231_TEMP_CACHED */
+
+static int ds3231_temp_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+	if (chan != SENSOR_CHAN_ALL && chan != SENSOR_CHAN_DIE_TEMP) {
+		return -ENOTSUP;
+	}
+
+	return ds3231_temp_fetch(dev);
+}
+
+static int ds3231_temp_channel_get(const struct device *dev, enum sensor_channel chan,
+				   struct sensor_value *val)
+{
+	struct ds3231_temp_data *data = dev->data;
+
+	if (chan != SENSOR_CHAN_DIE_TEMP) {
+		return -ENOTSUP;
+	}
+
+	return sensor_value_from_milli(val, data->temp_mdegc);
+}
+
+static const struct sensor_driver_api ds3231_temp_driver_api = {
+	.sample_fetch = ds3231_temp_sample_fetch,
+	.channel_get = ds3231_temp_channel_get,
+};
+
+static int ds3231_temp_init(const struct device *dev)
+{
+	const struct ds3231_temp_config *config = dev->config;
+
+	if (!device_is_ready(config->parent)) {
+		LOG_ERR("parent RTC device not ready");
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+#define DS3231_TEMP_INIT(inst)                                                                     \
+	static const struct ds3231_temp_config ds3231_temp_config_##inst = {                       \
+		.parent = DEVICE_DT_GET(DT_INST_PARENT(inst)),                                     \
+	};                                                                                         \
+                                                                                                   \
+	static struct ds3231_temp_data ds3231_temp_data_##inst;                                    \
+                                                                                                   \
+	SENSOR_DEVICE_DT_INST_DEFINE(inst, &ds3231_temp_init, NULL, &ds3231_temp_data_##inst,      \
+				     &ds3231_temp_config_##inst, POST_KERNEL,                      \
+				     CONFIG_SENSOR_INIT_PRIORITY, &ds3231_temp_driver_api);
+
+DT_INST_FOREACH_STATUS_OKAY(DS3231_TEMP_INIT)
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Cycles per call of the DS3231 register codec, next to the divide based conversion it
+ * replaced. Needs no DS3231, build it for native_sim to run it on the host or for
+ * rpi_pico to measure the Cortex-M0+.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/timeutil.h>
+
+#include "rtc_ds3231_codec.h"
+
+LOG_MODULE_REGISTER(codec_bench);
+
+#define ITERATIONS 10000
+
+#if defined(CONFIG_ARCH_POSIX) && (defined(__x86_64__) || defined(__i386__))
+/* Simulated time does not advance while code runs, count host TSC cycles instead */
+static inline uint32_t bench_cycles(void)
+{
+	return (uint32_t)__builtin_ia32_rdtsc();
+}
+#else
+static inline uint32_t bench_cycles(void)
+{
+	return k_cycle_get_32();
+}
+#endif
+
+/* Keeps the compiler from dropping the benchmarked calls */
+static volatile uint8_t sink;
+
+/* Time encode and decode as open-coded in the driver before the codec */
+static void legacy_time_encode(const struct rtc_time *timeptr, uint8_t *raw_time)
+{
+	raw_time[0] = (bin2bcd(timeptr->tm_sec / 10) << 4) + bin2bcd(timeptr->tm_sec % 10);
+	raw_time[1] = (bin2bcd(timeptr->tm_min / 10) << 4) + bin2bcd(timeptr->tm_min % 10);
+	raw_time[2] = (bin2bcd(timeptr->tm_hour / 10) << 4) + bin2bcd(timeptr->tm_hour % 10);
+	raw_time[3] = bin2bcd(timeptr->tm_wday);
+	raw_time[4] = (bin2bcd(timeptr->tm_mday / 10) << 4) + bin2bcd(timeptr->tm_mday % 10);
+	raw_time[5] = bin2bcd(timeptr->tm_mon + DS3231_MONTHS_OFFSET);
+	raw_time[6] = bin2bcd(timeptr->tm_year - DS3231_YEARS_OFFSET);
+}
+
+static void legacy_time_decode(const uint8_t *regs, struct rtc_time *timeptr)
+{
+	memset(timeptr, 0U, sizeof(*timeptr));
+	timeptr->tm_sec =
+		bcd2bin(regs[0] & DS3231_SECONDS_MASK) + bcd2bin(regs[0] & DS3231_SECONDS_10);
+	timeptr->tm_min =
+		bcd2bin(regs[1] & DS3231_MINUTES_MASK) + bcd2bin(regs[1] & DS3231_MINUTES_10);
+	timeptr->tm_hour =
+		bcd2bin(regs[2] & DS3231_HOURS_MASK) + bcd2bin(regs[2] & DS3231_HOURS_10);
+	timeptr->tm_wday = bcd2bin(regs[3] & DS3231_DAYS_MASK);
+	timeptr->tm_mday = bcd2bin(regs[4] & DS3231_DATE_MASK) + bcd2bin(regs[4] & DS3231_DATE_10);
+	timeptr->tm_mon = bcd2bin(regs[5] & DS3231_MONTHS_MASK) +
+			  bcd2bin(regs[5] & DS3231_MONTH_10) - DS3231_MONTHS_OFFSET;
+	timeptr->tm_year = bcd2bin(regs[6] & DS3231_YEARS_MASK) +
+			   bcd2bin(regs[6] & DS3231_YEAR_10) + DS3231_YEARS_OFFSET;
+}
+
+/* Varying input, so the calls cannot be hoisted out of the loop */
+static void bench_time(struct rtc_time *timeptr, int i)
+{
+	timeptr->tm_sec = i % 60;
+	timeptr->tm_min = (i / 60) % 60;
+	timeptr->tm_hour = i % 24;
+	timeptr->tm_wday = i % 7;
+	timeptr->tm_mday = 1 + i % 31;
+	timeptr->tm_mon = i % 12;
+	timeptr->tm_year = DS3231_YEARS_OFFSET + i % 100;
+}
+
+static struct rtc_time times[64];
+static uint8_t raw[ARRAY_SIZE(times)][DS3231_TIME_REGS];
+
+static void report(const char *name, uint32_t start, uint32_t end)
+{
+	uint32_t cycles = end - start;
+
+	printk("%-22s %6u.%02u cycles/call\n", name, cycles / ITERATIONS,
+	       (cycles % ITERATIONS) / (ITERATIONS / 100));
+}
+
+static bool verify(void)
+{
+	struct rtc_time decoded;
+
+	for (int i = 0; i < 100; i++) {
+		if (ds3231_bcd2bin(ds3231_bin2bcd(i)) != i || ds3231_bin2bcd(i) != bin2bcd(i)) {
+			printk("BCD mismatch at %d\n", i);
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(times); i++) {
+		if (ds3231_codec_time_encode(&times[i], raw[i]) != 0) {
+			printk("encode failed at %zu\n", i);
+			return false;
+		}
+
+		ds3231_codec_time_decode(raw[i], &decoded);
+		if (memcmp(&decoded, &times[i], sizeof(decoded)) != 0) {
+			printk("time mismatch at %zu\n", i);
+			return false;
+		}
+
+		if ((int64_t)ds3231_codec_days_decode(raw[i]) * DS3231_SECONDS_PER_DAY +
+			    ds3231_codec_sod_decode(raw[i]) !=
+		    timeutil_timegm64((struct tm *)&times[i])) {
+			printk("epoch mismatch at %zu\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(void)
+{
+	struct rtc_time decoded;
+	uint8_t alarm[4];
+	uint16_t mask;
+	uint32_t start;
+
+	LOG_INF("Running DS3231 codec benchmark on %s", CONFIG_BOARD);
+
+	for (size_t i = 0; i < ARRAY_SIZE(times); i++) {
+		bench_time(&times[i], i * 7919);
+	}
+
+	if (!verify()) {
+		return 0;
+	}
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		legacy_time_encode(&times[i % ARRAY_SIZE(times)], raw[i % ARRAY_SIZE(times)]);
+	}
+	report("legacy time encode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		(void)ds3231_codec_time_encode(&times[i % ARRAY_SIZE(times)],
+					       raw[i % ARRAY_SIZE(times)]);
+	}
+	report("codec time encode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		legacy_time_decode(raw[i % ARRAY_SIZE(times)], &decoded);
+		sink = decoded.tm_sec;
+	}
+	report("legacy time decode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ds3231_codec_time_decode(raw[i % ARRAY_SIZE(times)], &decoded);
+		sink = decoded.tm_sec;
+	}
+	report("codec time decode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		ds3231_codec_time_decode(raw[i % ARRAY_SIZE(times)], &decoded);
+		sink = (uint8_t)timeutil_timegm64((struct tm *)&decoded);
+	}
+	report("decode + timegm", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		sink = (uint8_t)((int64_t)ds3231_codec_days_decode(raw[i % ARRAY_SIZE(times)]) *
+					 DS3231_SECONDS_PER_DAY +
+				 ds3231_codec_sod_decode(raw[i % ARRAY_SIZE(times)]));
+	}
+	report("codec epoch decode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		(void)ds3231_codec_alarm_encode(0U,
+						RTC_ALARM_TIME_MASK_SECOND |
+							RTC_ALARM_TIME_MASK_MINUTE |
+							RTC_ALARM_TIME_MASK_HOUR |
+							RTC_ALARM_TIME_MASK_MONTHDAY,
+						&times[i % ARRAY_SIZE(times)], alarm);
+		sink = alarm[0];
+	}
+	report("codec alarm encode", start, bench_cycles());
+
+	start = bench_cycles();
+	for (int i = 0; i < ITERATIONS; i++) {
+		alarm[0] = raw[i % ARRAY_SIZE(times)][0];
+		ds3231_codec_alarm_decode(0U, alarm, &mask, &decoded);
+		sink = mask;
+	}
+	report("codec alarm decode", start, bench_cycles());
+
+	return 0;
+}
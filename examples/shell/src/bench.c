@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * rtc_bench: latency and throughput of DS3231 driver calls, on target or on native_sim
+ * against the emulated chip.
+ *
+ * rtc_bench <get_time|set_time|alarm_set|alarm_get|temp> [-n calls] [-u] [-s hz] [-t threads]
+ *   -n  calls per thread, 100 by default
+ *   -u  uncached, the time cache and register shadow are dropped before each call
+ *   -s  I2C bus speed in Hz, kept after the run
+ *   -t  threads calling at the same time, 1 by default
+ *
+ * set_time writes back the time read before the run, alarm_set overwrites alarm 2.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#ifdef CONFIG_EMUL_DS3231
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#endif /* CONFIG_EMUL_DS3231 */
+
+#define BENCH_NODE        DT_INST(0, adi_ds3231)
+#define BENCH_CALLS       100
+#define BENCH_MAX_SAMPLES 4096
+#define BENCH_MAX_THREADS 4
+#define BENCH_STACK_SIZE  2048
+
+static const struct device *const rtc = DEVICE_DT_GET(BENCH_NODE);
+static const struct device *const bus = DEVICE_DT_GET(DT_BUS(BENCH_NODE));
+
+#ifdef CONFIG_EMUL_DS3231
+static const struct emul *const emul = EMUL_DT_GET(BENCH_NODE);
+#endif /* CONFIG_EMUL_DS3231 */
+
+/* Time read before the run, written by set_time and alarm_set */
+static struct rtc_time bench_time;
+
+static int bench_get_time(void)
+{
+	struct rtc_time timeptr;
+
+	return rtc_get_time(rtc, &timeptr);
+}
+
+static int bench_set_time(void)
+{
+	return rtc_set_time(rtc, &bench_time);
+}
+
+static int bench_alarm_set(void)
+{
+	return rtc_alarm_set_time(rtc, 1, RTC_ALARM_TIME_MASK_MINUTE | RTC_ALARM_TIME_MASK_HOUR,
+				  &bench_time);
+}
+
+static int bench_alarm_get(void)
+{
+	struct rtc_time timeptr;
+	uint16_t mask;
+
+	return rtc_alarm_get_time(rtc, 1, &mask, &timeptr);
+}
+
+static int bench_temp(void)
+{
+	int32_t temp_mdegc;
+
+	return ds3231_get_temp(rtc, &temp_mdegc);
+}
+
+struct bench_op {
+	const char *name;
+	int (*call)(void);
+};
+
+enum {
+	BENCH_GET_TIME,
+	BENCH_SET_TIME,
+	BENCH_ALARM_SET,
+	BENCH_ALARM_GET,
+	BENCH_TEMP,
+};
+
+static const struct bench_op bench_ops[] = {
+	[BENCH_GET_TIME] = {"get_time", bench_get_time},
+	[BENCH_SET_TIME] = {"set_time", bench_set_time},
+	[BENCH_ALARM_SET] = {"alarm_set", bench_alarm_set},
+	[BENCH_ALARM_GET] = {"alarm_get", bench_alarm_get},
+	[BENCH_TEMP] = {"temp", bench_temp},
+};
+
+/* One calling thread and the latencies it measured, in cycles */
+struct bench_worker {
+	const struct bench_op *op;
+	uint32_t *samples;
+	uint32_t calls;
+	bool uncached;
+	int err;
+};
+
+static uint32_t samples[BENCH_MAX_SAMPLES];
+static struct bench_worker workers[BENCH_MAX_THREADS];
+static struct k_thread threads[BENCH_MAX_THREADS];
+static K_THREAD_STACK_ARRAY_DEFINE(stacks, BENCH_MAX_THREADS, BENCH_STACK_SIZE);
+
+static void bench_worker_run(void *p1, void *p2, void *p3)
+{
+	struct bench_worker *worker = p1;
+	uint32_t start;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	for (uint32_t i = 0; i < worker->calls; i++) {
+		/* Unsupported without the time cache, where every read goes to the chip anyway */
+		if (worker->uncached) {
+			(void)ds3231_time_cache_invalidate(rtc);
+			(void)ds3231_shadow_invalidate(rtc);
+		}
+
+		start = k_cycle_get_32();
+		worker->err = worker->op->call();
+		worker->samples[i] = k_cycle_get_32() - start;
+
+		if (worker->err != 0) {
+			worker->calls = i;
+			return;
+		}
+	}
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int bench_bus_speed(const struct shell *sh, uint32_t hz)
+{
+	uint32_t speed;
+	int err;
+
+	if (hz <= 100000U) {
+		speed = I2C_SPEED_STANDARD;
+	} else if (hz <= 400000U) {
+		speed = I2C_SPEED_FAST;
+	} else if (hz <= 1000000U) {
+		speed = I2C_SPEED_FAST_PLUS;
+	} else {
+		shell_error(sh, "Unsupported bus speed %u Hz", hz);
+		return -EINVAL;
+	}
+
+	err = i2c_configure(bus, I2C_MODE_CONTROLLER | I2C_SPEED_SET(speed));
+	if (err != 0) {
+		shell_error(sh, "Error configuring the bus: %d", err);
+		return err;
+	}
+
+#ifdef CONFIG_EMUL_DS3231
+	/* The emulator takes as long as the bus would */
+	emul_ds3231_set_bus_speed(emul, hz);
+#endif /* CONFIG_EMUL_DS3231 */
+
+	return 0;
+}
+
+static void bench_print(const struct shell *sh, const char *name, uint32_t cycles)
+{
+	shell_print(sh, "%-8s %10u %10u", name, cycles, k_cyc_to_us_floor32(cycles));
+}
+
+static void bench_report(const struct shell *sh, uint32_t n, uint32_t elapsed)
+{
+	uint64_t total = 0;
+
+	if (n == 0U) {
+		return;
+	}
+
+	qsort(samples, n, sizeof(samples[0]), bench_cmp);
+	for (uint32_t i = 0; i < n; i++) {
+		total += samples[i];
+	}
+
+	shell_print(sh, "%-8s %10s %10s", "", "cycles", "us");
+	bench_print(sh, "min", samples[0]);
+	bench_print(sh, "avg", total / n);
+	/* Nearest rank */
+	bench_print(sh, "p99", samples[DIV_ROUND_UP(n * 99U, 100U) - 1U]);
+	bench_print(sh, "max", samples[n - 1U]);
+
+	if (elapsed != 0U) {
+		shell_print(sh, "%u calls/s",
+			    (uint32_t)((uint64_t)n * sys_clock_hw_cycles_per_sec() / elapsed));
+	}
+}
+
+static int bench_parse(const struct shell *sh, const char *arg, uint32_t *value)
+{
+	char *end;
+
+	*value = strtoul(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0') {
+		shell_error(sh, "Invalid number %s", arg);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int bench_run(const struct shell *sh, size_t argc, char **argv, const struct bench_op *op)
+{
+	uint32_t calls = BENCH_CALLS;
+	uint32_t nthreads = 1;
+	uint32_t hz = 0;
+	bool uncached = false;
+	uint32_t elapsed;
+	uint32_t start;
+	uint32_t n = 0;
+	int err;
+
+	for (size_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-u") == 0) {
+			uncached = true;
+			continue;
+		}
+
+		if (i + 1 == argc) {
+			shell_error(sh, "Missing value of %s", argv[i]);
+			return -EINVAL;
+		}
+
+		if (strcmp(argv[i], "-n") == 0) {
+			err = bench_parse(sh, argv[++i], &calls);
+		} else if (strcmp(argv[i], "-s") == 0) {
+			err = bench_parse(sh, argv[++i], &hz);
+		} else if (strcmp(argv[i], "-t") == 0) {
+			err = bench_parse(sh, argv[++i], &nthreads);
+		} else {
+			shell_error(sh, "Unknown option %s", argv[i]);
+			err = -EINVAL;
+		}
+
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	if (calls == 0U || nthreads == 0U || nthreads > BENCH_MAX_THREADS ||
+	    calls > BENCH_MAX_SAMPLES / nthreads) {
+		shell_error(sh, "At most %d threads and %d calls in total", BENCH_MAX_THREADS,
+			    BENCH_MAX_SAMPLES);
+		return -EINVAL;
+	}
+
+	if (!device_is_ready(rtc)) {
+		shell_error(sh, "Device %s is not ready", rtc->name);
+		return -ENODEV;
+	}
+
+	if (hz != 0U) {
+		err = bench_bus_speed(sh, hz);
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	err = rtc_get_time(rtc, &bench_time);
+	if (err != 0) {
+		shell_error(sh, "Error reading the time: %d, set it with rtc_time_set", err);
+		return err;
+	}
+
+	for (uint32_t t = 0; t < nthreads; t++) {
+		workers[t] = (struct bench_worker){
+			.op = op,
+			.samples = &samples[t * calls],
+			.calls = calls,
+			.uncached = uncached,
+		};
+	}
+
+	start = k_cycle_get_32();
+
+	if (nthreads == 1U) {
+		bench_worker_run(&workers[0], NULL, NULL);
+	} else {
+		/* All at the shell's priority, started together */
+		for (uint32_t t = 0; t < nthreads; t++) {
+			k_thread_create(&threads[t], stacks[t], K_THREAD_STACK_SIZEOF(stacks[t]),
+					bench_worker_run, &workers[t], NULL, NULL,
+					k_thread_priority_get(k_current_get()), 0, K_NO_WAIT);
+		}
+
+		for (uint32_t t = 0; t < nthreads; t++) {
+			(void)k_thread_join(&threads[t], K_FOREVER);
+		}
+	}
+
+	elapsed = k_cycle_get_32() - start;
+
+	shell_print(sh, "%s: %u call(s) x %u thread(s), %s", op->name, calls, nthreads,
+		    uncached ? "uncached" : "cached");
+
+	/* Compact the samples of all threads, and report the first error */
+	err = 0;
+	for (uint32_t t = 0; t < nthreads; t++) {
+		memmove(&samples[n], workers[t].samples, workers[t].calls * sizeof(samples[0]));
+		n += workers[t].calls;
+
+		if (workers[t].err != 0 && err == 0) {
+			err = workers[t].err;
+			shell_error(sh, "Thread %u failed after %u call(s): %d", t, workers[t].calls,
+				    err);
+		}
+	}
+
+	bench_report(sh, n, elapsed);
+
+	return err;
+}
+
+static int cmd_rtc_bench_get_time(const struct shell *sh, size_t argc, char **argv)
+{
+	return bench_run(sh, argc, argv, &bench_ops[BENCH_GET_TIME]);
+}
+
+static int cmd_rtc_bench_set_time(const struct shell *sh, size_t argc, char **argv)
+{
+	return bench_run(sh, argc, argv, &bench_ops[BENCH_SET_TIME]);
+}
+
+static int cmd_rtc_bench_alarm_set(const struct shell *sh, size_t argc, char **argv)
+{
+	return bench_run(sh, argc, argv, &bench_ops[BENCH_ALARM_SET]);
+}
+
+static int cmd_rtc_bench_alarm_get(const struct shell *sh, size_t argc, char **argv)
+{
+	return bench_run(sh, argc, argv, &bench_ops[BENCH_ALARM_GET]);
+}
+
+static int cmd_rtc_bench_temp(const struct shell *sh, size_t argc, char **argv)
+{
+	return bench_run(sh, argc, argv, &bench_ops[BENCH_TEMP]);
+}
+
+#define BENCH_HELP " [-n calls] [-u] [-s hz] [-t threads]"
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_rtc_bench,
+	SHELL_CMD_ARG(get_time, NULL, "Time reads" BENCH_HELP, cmd_rtc_bench_get_time, 1, 7),
+	SHELL_CMD_ARG(set_time, NULL, "Time writes" BENCH_HELP, cmd_rtc_bench_set_time, 1, 7),
+	SHELL_CMD_ARG(alarm_set, NULL, "Alarm 2 writes" BENCH_HELP, cmd_rtc_bench_alarm_set, 1,
+		      7),
+	SHELL_CMD_ARG(alarm_get, NULL, "Alarm 2 reads" BENCH_HELP, cmd_rtc_bench_alarm_get, 1,
+		      7),
+	SHELL_CMD_ARG(temp, NULL, "Temperature reads" BENCH_HELP, cmd_rtc_bench_temp, 1, 7),
+	SHELL_SUBCMD_SET_END);
+SHELL_CMD_REGISTER(rtc_bench, &sub_rtc_bench, "Benchmark DS3231 driver calls", NULL);
@@ -1,10 +1,15 @@
 #include <zephyr/shell/shell.h>
+#include <zephyr/stats/stats.h>
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/sensor.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/reboot.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <zephyr/sys/timeutil.h>
 
 LOG_MODULE_REGISTER(shell_app);
@@ -29,7 +34,11 @@ static int cmd_g_rtc_alarm_set(const struct shell *shell, size_t argc, char *arg
 	int ret, alarm_id;
 	/* Print current time in RTC */
 	struct rtc_time get_t;
-	rtc_get_time(dev, &get_t);
+	ret = rtc_get_time(dev, &get_t);
+	if (ret != 0) {
+		shell_error(shell, "Error getting time: %d", ret);
+		return ret;
+	}
         shell_print(shell,"Current date/time is %d-%d-%d   %d:%d:%d\n", get_t.tm_year + 1900,
 		get_t.tm_mon + 1, get_t.tm_mday, get_t.tm_hour, get_t.tm_min, get_t.tm_sec);
 
@@ -50,27 +59,34 @@ static int cmd_g_rtc_alarm_set(const struct shell *shell, size_t argc, char *arg
 static int cmd_g_rtc_alarm_get(const struct shell *shell, size_t argc, char *argv[])
 {
 	struct rtc_time get_t;
-	rtc_alarm_get_time(dev, atoi(argv[1]), 0, &get_t);
+	uint16_t mask;
+	int ret = rtc_alarm_get_time(dev, atoi(argv[1]), &mask, &get_t);
+
+	if (ret != 0) {
+		shell_error(shell, "Error getting alarm: %d", ret);
+		return ret;
+	}
 	shell_print(shell,"Alarm set for date %d  time%d:%d:%d from now\n", get_t.tm_mday, get_t.tm_hour,
 		get_t.tm_min, get_t.tm_sec);      
 	return 0;
 }
 static int cmd_g_rtc_set(const struct shell *shell, size_t argc, char *argv[])
 {
-	time_t timer_set = atoi(argv[1]);
-	struct rtc_time set_t;
-	gmtime_r(&timer_set, (struct tm *)(&set_t));
-	shell_print(shell,"Setting date/time as %d-%d-%d %d  %d:%d:%d\n", set_t.tm_year + 1900,
-		set_t.tm_mon + 1, set_t.tm_mday, set_t.tm_wday, set_t.tm_hour, set_t.tm_min,
-		set_t.tm_sec);
-
-	int ret = rtc_set_time(dev, &set_t);
+	int64_t timer_set = strtoll(argv[1], NULL, 10);
+
+	/* Set the epoch directly, no struct rtc_time round-trip */
+	int ret = ds3231_set_epoch(dev, timer_set);
 	if (ret != 0) {
-		LOG_INF("Error setting time!!");
+		shell_error(shell, "Error setting time: %d", ret);
+		return ret;
 	}
 
 	struct rtc_time get_t;
-	rtc_get_time(dev, &get_t);
+	ret = rtc_get_time(dev, &get_t);
+	if (ret != 0) {
+		shell_error(shell, "Error getting time: %d", ret);
+		return ret;
+	}
         shell_print(shell,"Date/time is %d-%d-%d %d  %d:%d:%d\n", get_t.tm_year + 1900, get_t.tm_mon + 1,
 		get_t.tm_mday, get_t.tm_wday, get_t.tm_hour, get_t.tm_min, get_t.tm_sec);
 
@@ -79,17 +95,160 @@ static int cmd_g_rtc_set(const struct shell *shell, size_t argc, char *argv[])
 static int cmd_g_rtc_get(const struct shell *shell, size_t argc, char *argv[])
 {
 	struct rtc_time get_t;
-	rtc_get_time(dev, &get_t);
+	int ret = rtc_get_time(dev, &get_t);
+
+	if (ret != 0) {
+		shell_error(shell, "Error getting time: %d", ret);
+		return ret;
+	}
         shell_print(shell,"Date/time is %d-%d-%d   %d:%d:%d\n", get_t.tm_year + 1900, get_t.tm_mon + 1,
 		get_t.tm_mday, get_t.tm_hour, get_t.tm_min, get_t.tm_sec);
+	if (ds3231_time_cache_stale(dev) == 1) {
+		shell_warn(shell, "RTC not readable, time extrapolated from the last read");
+	}
+
+	return 0;
+}
+
+static int cmd_g_rtc_epoch(const struct shell *shell, size_t argc, char *argv[])
+{
+	int64_t ms;
+	int ret;
+
+	ret = ds3231_get_epoch_ms(dev, &ms);
+	if (ret != 0) {
+		shell_error(shell, "Error getting time: %d", ret);
+		return ret;
+	}
+
+	shell_print(shell, "Epoch is %lld.%03d", ms / 1000, (int)(ms % 1000));
 
 	return 0;
 }
 
+static int cmd_g_rtc_regs(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct ds3231_reg_dump dump;
+	int ret;
+
+	ret = ds3231_reg_dump(dev, &dump);
+	if (ret != 0) {
+		shell_error(shell, "Error reading registers: %d", ret);
+		return ret;
+	}
+
+	shell_hexdump(shell, dump.regs, sizeof(dump.regs));
+	if (dump.time_valid) {
+		shell_print(shell, "Epoch is %lld", dump.seconds);
+	} else {
+		shell_print(shell, "Oscillator stopped, time not set");
+	}
+	shell_print(shell, "Temperature is %d mC", dump.temp_mdegc);
+
+	return 0;
+}
+
+static int cmd_g_rtc_temp(const struct shell *shell, size_t argc, char *argv[])
+{
+	const struct device *temp = DEVICE_DT_GET_ANY(adi_ds3231_temp);
+	struct sensor_value val;
+	int ret;
+
+	if (temp == NULL || !device_is_ready(temp)) {
+		shell_error(shell, "No DS3231 temperature sensor");
+		return -ENODEV;
+	}
+
+	ret = sensor_sample_fetch(temp);
+	if (ret == 0) {
+		ret = sensor_channel_get(temp, SENSOR_CHAN_DIE_TEMP, &val);
+	}
+	if (ret != 0) {
+		shell_error(shell, "Error reading temperature: %d", ret);
+		return ret;
+	}
+
+	int32_t milli = val.val1 * 1000 + val.val2 / 1000;
+
+	shell_print(shell, "Temperature is %s%d.%03d C", (milli < 0) ? "-" : "", abs(milli) / 1000,
+		    abs(milli) % 1000);
+
+	return 0;
+}
+
+#ifdef CONFIG_RTC_DS3231_STATS
+static const char *const stats_ops[DS3231_STATS_OP_COUNT] = {
+	[DS3231_STATS_GET_TIME] = "get_time",
+	[DS3231_STATS_SET_TIME] = "set_time",
+	[DS3231_STATS_GET_TEMP] = "get_temp",
+	[DS3231_STATS_ALARM_SET] = "alarm_set",
+	[DS3231_STATS_ALARM_GET] = "alarm_get",
+	[DS3231_STATS_OTHER] = "other",
+	[DS3231_STATS_ALARM_DISPATCH] = "alarm_dispatch",
+};
+
+static int stats_print(struct stats_hdr *hdr, void *arg, const char *name, uint16_t off)
+{
+	const struct shell *shell = arg;
+
+	shell_print(shell, "%-16s %u", name, *(uint32_t *)((uint8_t *)hdr + off));
+
+	return 0;
+}
+
+static int cmd_ds3231_stats(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct ds3231_latency_hist hist;
+	struct stats_hdr *hdr;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "reset") != 0) {
+			shell_error(shell, "Unknown argument %s", argv[1]);
+			return -EINVAL;
+		}
+
+		return ds3231_stats_reset(dev);
+	}
+
+	hdr = stats_group_find(dev->name);
+	if (hdr != NULL) {
+		stats_walk(hdr, stats_print, (void *)shell);
+	}
+
+	/* Bucket n counts latencies from 2^(n-1) us to below 2^n us */
+	shell_print(shell, "%-16s %8s %8s  histogram", "latency", "count", "max us");
+	for (int op = 0; op < DS3231_STATS_OP_COUNT; op++) {
+		char line[DS3231_STATS_BUCKETS * 6 + 1];
+		size_t len = 0;
+
+		if (ds3231_stats_latency_get(dev, op, &hist) != 0 || hist.count == 0U) {
+			continue;
+		}
+
+		for (int i = 0; i < DS3231_STATS_BUCKETS; i++) {
+			len += snprintf(&line[len], sizeof(line) - len, " %5u", hist.buckets[i]);
+		}
+
+		shell_print(shell, "%-16s %8u %8u %s", stats_ops[op], hist.count, hist.max_us, line);
+	}
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_ds3231,
+	SHELL_CMD_ARG(stats, NULL, "Show driver statistics, or reset them", cmd_ds3231_stats,
+		      1, 1),
+	SHELL_SUBCMD_SET_END);
+SHELL_CMD_REGISTER(ds3231, &sub_ds3231, "DS3231 driver commands", NULL);
+#endif /* CONFIG_RTC_DS3231_STATS */
+
+SHELL_CMD_ARG_REGISTER(rtc_regs, NULL, "Dump all RTC registers", cmd_g_rtc_regs, 1, 0);
 SHELL_CMD_ARG_REGISTER(rtc_time_set, NULL, "Set RTC time (epoch)", cmd_g_rtc_set, 2, 0);
 SHELL_CMD_ARG_REGISTER(rtc_time_get, NULL, "Get RTC time", cmd_g_rtc_get, 1, 0);
+SHELL_CMD_ARG_REGISTER(rtc_epoch_get, NULL, "Get RTC time (epoch ms)", cmd_g_rtc_epoch, 1, 0);
 SHELL_CMD_ARG_REGISTER(rtc_alarm_set, NULL, "Set alarm id & time ", cmd_g_rtc_alarm_set, 3, 0);
 SHELL_CMD_ARG_REGISTER(rtc_alarm_get, NULL, "Get alarm time set by id", cmd_g_rtc_alarm_get, 2, 0);
+SHELL_CMD_ARG_REGISTER(rtc_temp, NULL, "Get die temperature", cmd_g_rtc_temp, 1, 0);
 
 static const struct device *get_ds3231_device(void)
 {
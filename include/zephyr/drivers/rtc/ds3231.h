@@ -0,0 +1,1175 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * @brief Extended public API for the DS3231 RTC driver
+ *
+ * Functions in this header extend the generic RTC API with DS3231 specific
+ * features. They must only be called with a device bound to the DS3231 driver.
+ */
+
+#ifndef ZEPHYR_INCLUDE_DRIVERS_RTC_DS3231_H_
+#define ZEPHYR_INCLUDE_DRIVERS_RTC_DS3231_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/rb.h>
+#include <zephyr/sys/slist.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Hit/miss counters of the DS3231 time cache */
+struct ds3231_time_cache_stats {
+	/** Reads served from memory */
+	uint32_t hits;
+	/** Reads that went to the chip */
+	uint32_t misses;
+	/** Reads extrapolated past the resync interval because the chip could not be read */
+	uint32_t stale;
+};
+
+/**
+ * @brief Get the time cache counters
+ *
+ * @param dev DS3231 device
+ * @param stats Destination for the counters
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_TIME_CACHE is disabled or no instance is cached
+ */
+int ds3231_time_cache_get_stats(const struct device *dev, struct ds3231_time_cache_stats *stats);
+
+/**
+ * @brief Drop the cached time, forcing the next read to go to the chip
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_TIME_CACHE is disabled or no instance is cached
+ */
+int ds3231_time_cache_invalidate(const struct device *dev);
+
+/**
+ * @brief Check whether the latest time read was stale
+ *
+ * When reading the chip fails with a bus error, time reads extrapolate the cached time past
+ * the resync interval rather than fail. Such a time follows the system clock from the last
+ * successful read on. An instance with time-cache-resync-ms of 0 is never extrapolated.
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 1 if the latest time read was extrapolated after a failed chip read
+ * @retval 0 if it was not
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_TIME_CACHE is disabled or no instance is cached
+ */
+int ds3231_time_cache_stale(const struct device *dev);
+
+/**
+ * @brief Invalidate the driver's shadow of CONTROL, STATUS, AGING_OFFSET and the alarms
+ *
+ * The driver keeps a copy of these registers to update them without reading them back
+ * and to skip writes that would not change them. Call this after the registers have
+ * been modified behind the driver's back, e.g. by another bus master. The shadow is
+ * reloaded with a single burst read on the next update, the alarms on the next read.
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 0 on success
+ */
+int ds3231_shadow_invalidate(const struct device *dev);
+
+/** Number of DS3231 registers, 0x00 to 0x12 */
+#define DS3231_REG_COUNT 19
+
+/** @brief Contents of the whole DS3231 register file, see ds3231_reg_dump() */
+struct ds3231_reg_dump {
+	/** Registers 0x00 to 0x12 from one burst read */
+	uint8_t regs[DS3231_REG_COUNT];
+	/** STATUS.OSF is clear, the oscillator ran since the time was last set */
+	bool time_valid;
+	/** Unix time of the time registers, 0 unless @ref time_valid */
+	int64_t seconds;
+	/** Temperature of the latest conversion, in millidegrees Celsius */
+	int32_t temp_mdegc;
+};
+
+/**
+ * @brief Read all registers in one bus transaction
+ *
+ * Also refreshes the driver's copies of CONTROL, STATUS, AGING_OFFSET and the alarm
+ * registers, the time cache and the snapshot. The driver does this once at init, so the
+ * first calls need no further reads. Gives a consistent dump for diagnostics.
+ *
+ * @param dev DS3231 device
+ * @param dump Destination for the registers and the values decoded from them
+ *
+ * @retval 0 on success
+ * @retval -errno negative errno code on bus failure
+ */
+int ds3231_reg_dump(const struct device *dev, struct ds3231_reg_dump *dump);
+
+/**
+ * @brief Get the time as Unix time in seconds
+ *
+ * Like rtc_get_time(), without converting to and from struct rtc_time. The calendar is
+ * only converted when the date changed since the previous conversion.
+ *
+ * While STATUS.OSF flags an oscillator stop the time is not valid, and time reads fail
+ * with -ENODATA until the time is set, which clears the flag. The flag is taken from the
+ * last STATUS read, at init and whenever the driver reads STATUS.
+ *
+ * @param dev DS3231 device
+ * @param seconds Destination for the seconds since 1970-01-01 00:00:00 UTC
+ *
+ * @retval 0 on success
+ * @retval -ENODATA if the oscillator stopped since the time was set
+ * @retval -ETIMEDOUT if the bus was not available within CONFIG_RTC_DS3231_DEADLINE_MS
+ * @retval -errno negative errno code on bus failure, after CONFIG_RTC_DS3231_RETRIES retries
+ */
+int ds3231_get_epoch(const struct device *dev, int64_t *seconds);
+
+/**
+ * @brief Get the time as Unix time in milliseconds
+ *
+ * The chip counts whole seconds. While ds3231_timestamp_get() is available, the time is
+ * taken from it without bus access. Otherwise, with CONFIG_RTC_DS3231_TIME_CACHE, the
+ * milliseconds are extrapolated from the system uptime since the cache was anchored. The
+ * anchor is exact after the time was set or a 1 Hz edge was seen, and the start of the
+ * second read otherwise. Without either the milliseconds are 0.
+ *
+ * @param dev DS3231 device
+ * @param ms Destination for the milliseconds since 1970-01-01 00:00:00 UTC
+ *
+ * @retval 0 on success
+ * @retval -ENODATA if the oscillator stopped since the time was set
+ * @retval -errno negative errno code on bus failure
+ */
+int ds3231_get_epoch_ms(const struct device *dev, int64_t *ms);
+
+/**
+ * @brief Set the time from Unix time in seconds
+ *
+ * Clears a flagged oscillator stop, with a second transaction.
+ *
+ * @param dev DS3231 device
+ * @param seconds Seconds since 1970-01-01 00:00:00 UTC
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the time is outside of 2000-01-01 to 2199-12-31
+ * @retval -errno negative errno code on bus failure
+ */
+int ds3231_set_epoch(const struct device *dev, int64_t seconds);
+
+/**
+ * @brief Set the time from Unix time in milliseconds
+ *
+ * The chip counts whole seconds, so the time is set with ds3231_set_time_aligned() on the
+ * next second boundary of @p ms, taken as the time at the call. The call waits up to one
+ * second for it.
+ *
+ * @param dev DS3231 device
+ * @param ms Milliseconds since 1970-01-01 00:00:00 UTC
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the time is outside of 2000-01-01 to 2199-12-31
+ * @retval -errno negative errno code on bus failure
+ */
+int ds3231_set_epoch_ms(const struct device *dev, int64_t ms);
+
+/** @brief Outcome of ds3231_set_time_aligned() */
+struct ds3231_align_result {
+	/** Measured time from starting the write to the seconds register being written */
+	int64_t latency_ns;
+	/** Seconds edge after the write minus the reference's second boundary */
+	int64_t phase_ns;
+	/** Resolution of @ref phase_ns */
+	uint32_t phase_error_ns;
+};
+
+/**
+ * @brief Set the time on a second boundary of a reference clock
+ *
+ * Writing the seconds register restarts the DS3231's second, so the write is timed to land
+ * on the next second boundary of the reference that can still be reached. The latency from
+ * starting the write to the seconds register being written is measured with one time read
+ * beforehand and compensated. The caller should not hold the bus during the call.
+ *
+ * With @p res the phase is then verified against the following seconds edge, from the
+ * timestamped square wave if it runs, otherwise by polling the time registers within 10 ms
+ * of the expected edge. The call takes one to two seconds with verification, up to one
+ * without.
+ *
+ * @param dev DS3231 device
+ * @param ref_ns Reference time as Unix time in nanoseconds, taken at @p ref_uptime_ns
+ * @param ref_uptime_ns System uptime in nanoseconds at which @p ref_ns was taken
+ * @param res Destination for the latency and the verified phase, or NULL to skip the
+ *            verification
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if the time is outside of 2000-01-01 to 2199-12-31
+ * @retval -ERANGE if the edge was not within 10 ms of the reference's second boundary, the
+ * time is set nonetheless
+ * @retval -errno negative errno code on bus failure
+ */
+int ds3231_set_time_aligned(const struct device *dev, int64_t ref_ns, int64_t ref_uptime_ns,
+			    struct ds3231_align_result *res);
+
+/**
+ * @name Snapshot fields
+ * @anchor DS3231_SNAPSHOT_FIELDS
+ * @{
+ */
+/** @ref ds3231_snapshot.seconds and @ref ds3231_snapshot.uptime_ms hold a value */
+#define DS3231_SNAPSHOT_TIME   BIT(0)
+/** @ref ds3231_snapshot.temp_mdegc holds a value */
+#define DS3231_SNAPSHOT_TEMP   BIT(1)
+/** @ref ds3231_snapshot.status holds a value */
+#define DS3231_SNAPSHOT_STATUS BIT(2)
+/** @} */
+
+/** @brief Latest values the driver exchanged with the chip, see ds3231_snapshot_get() */
+struct ds3231_snapshot {
+	/** Unix time last read from or written to the chip */
+	int64_t seconds;
+	/** System uptime in milliseconds when @ref seconds was read or written */
+	int64_t uptime_ms;
+	/** Temperature last read, in millidegrees Celsius */
+	int32_t temp_mdegc;
+	/** STATUS register as last read or written */
+	uint8_t status;
+	/** Fields that hold a value, see @ref DS3231_SNAPSHOT_FIELDS */
+	uint8_t valid;
+};
+
+/**
+ * @brief Get the latest time, temperature and STATUS without bus access
+ *
+ * The driver updates the snapshot whenever a request transfers one of the values. Readers
+ * never block and never wait for the bus, and always get the fields of one update. This
+ * may be called from ISRs and from threads of any priority. Requires
+ * CONFIG_RTC_DS3231_SNAPSHOT.
+ *
+ * @param dev DS3231 device
+ * @param snap Destination for the snapshot
+ *
+ * @retval 0 on success
+ * @retval -EAGAIN if none of the values was transferred yet
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SNAPSHOT is disabled
+ */
+int ds3231_snapshot_get(const struct device *dev, struct ds3231_snapshot *snap);
+
+/** @brief Operations with a latency histogram, see ds3231_stats_latency_get() */
+enum ds3231_stats_op {
+	/** Time reads that went to the chip */
+	DS3231_STATS_GET_TIME,
+	/** Time writes */
+	DS3231_STATS_SET_TIME,
+	/** Temperature reads */
+	DS3231_STATS_GET_TEMP,
+	/** Alarm writes */
+	DS3231_STATS_ALARM_SET,
+	/** Alarm reads, including those served from the alarm register cache */
+	DS3231_STATS_ALARM_GET,
+	/** All other requests */
+	DS3231_STATS_OTHER,
+	/** INT/SQW edge of an alarm to the start of its callback */
+	DS3231_STATS_ALARM_DISPATCH,
+	/** Number of operations */
+	DS3231_STATS_OP_COUNT,
+};
+
+/** Number of buckets of a latency histogram */
+#define DS3231_STATS_BUCKETS 16
+
+/**
+ * @brief Latency histogram of one operation
+ *
+ * Bucket 0 counts latencies below 1 us, bucket n those from 2^(n-1) us to below 2^n us. The
+ * last bucket also counts everything beyond.
+ */
+struct ds3231_latency_hist {
+	/** Number of latencies per bucket */
+	uint32_t buckets[DS3231_STATS_BUCKETS];
+	/** Number of latencies */
+	uint32_t count;
+	/** Largest latency in microseconds */
+	uint32_t max_us;
+};
+
+/**
+ * @brief Get the latency histogram of an operation
+ *
+ * A request's latency runs from its submission to its completion, so it includes waiting
+ * for other requests. The event counters of the instance are registered with the stats
+ * subsystem under the device name. Requires CONFIG_RTC_DS3231_STATS.
+ *
+ * @param dev DS3231 device
+ * @param op Operation
+ * @param hist Destination for the histogram
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if @p op is invalid
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_STATS is disabled
+ */
+int ds3231_stats_latency_get(const struct device *dev, enum ds3231_stats_op op,
+			     struct ds3231_latency_hist *hist);
+
+/**
+ * @brief Reset the event counters and latency histograms
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_STATS is disabled
+ */
+int ds3231_stats_reset(const struct device *dev);
+
+/** @brief Configuration of one DS3231 alarm for ds3231_alarms_program() */
+struct ds3231_alarm_cfg {
+	/** Fields of @ref time to match, as RTC_ALARM_TIME_MASK_* flags */
+	uint16_t mask;
+	/** Alarm time */
+	struct rtc_time time;
+	/** Enable the alarm interrupt */
+	bool enable;
+};
+
+/**
+ * @brief Program both alarms and their interrupt enables in a single bus transaction
+ *
+ * Writes alarm 1, alarm 2, CONTROL and STATUS in one burst, clearing both alarm flags,
+ * so there is no window in which one alarm is enabled while the other is half-written.
+ *
+ * @param dev DS3231 device
+ * @param alarm1 Configuration of alarm 1 (id 0)
+ * @param alarm2 Configuration of alarm 2 (id 1)
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if a mask is not supported by the alarm
+ * @retval -ENOTSUP if CONFIG_RTC_ALARM is disabled
+ * @retval -errno on bus error
+ */
+int ds3231_alarms_program(const struct device *dev, const struct ds3231_alarm_cfg *alarm1,
+			  const struct ds3231_alarm_cfg *alarm2);
+
+/** @brief Period of a recurring alarm, see ds3231_alarm_schedule() */
+enum ds3231_schedule_period {
+	/** Every second, alarm 1 only */
+	DS3231_SCHEDULE_EVERY_SECOND,
+	/** Every minute at the second */
+	DS3231_SCHEDULE_MINUTELY,
+	/** Every hour at the minute and second */
+	DS3231_SCHEDULE_HOURLY,
+	/** Every day at the time */
+	DS3231_SCHEDULE_DAILY,
+	/** Every week on the weekday at the time */
+	DS3231_SCHEDULE_WEEKLY,
+	/** Every month on the date at the time, skipping months without that date */
+	DS3231_SCHEDULE_MONTHLY,
+};
+
+/** @brief Recurring alarm */
+struct ds3231_schedule {
+	enum ds3231_schedule_period period;
+	/**
+	 * Occur every this many periods, 0 or 1 for every period. Up to 59 seconds, 59 minutes,
+	 * 23 hours, 27 days or 3 weeks, counted from the next match. Monthly schedules occur
+	 * every month.
+	 */
+	uint8_t every;
+	/** Second, 0 for alarm 2 */
+	uint8_t second;
+	/** Minute, for hourly and longer periods */
+	uint8_t minute;
+	/** Hour, for daily and longer periods */
+	uint8_t hour;
+	/** Day of the week, 0 for Sunday, for weekly schedules */
+	uint8_t wday;
+	/** Day of the month from 1, for monthly schedules */
+	uint8_t mday;
+};
+
+/** @brief Alarm programming of a schedule, see ds3231_schedule_compile() */
+struct ds3231_schedule_plan {
+	/** Fields matched, as RTC_ALARM_TIME_MASK_* flags */
+	uint16_t mask;
+	/** Alarm time */
+	struct rtc_time time;
+	/** Unix time of the first occurrence with @ref rearm_s, 0 otherwise */
+	int64_t first;
+	/** Seconds the driver re-arms the alarm by after each occurrence, 0 if the mask repeats */
+	uint32_t rearm_s;
+};
+
+/**
+ * @brief Compile a recurring alarm into the alarm registers' match mode
+ *
+ * Every period repeats with the hardware alone, weekly schedules with the day of the week
+ * mode of the day register. A schedule every few periods matches the next coarser field as
+ * well, and the alarm is re-armed for each occurrence.
+ *
+ * @param id Alarm, 0 or 1
+ * @param sched Schedule
+ * @param now Current Unix time, for the first occurrence of a re-armed schedule
+ * @param plan Destination for the alarm programming
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if a field is out of range or the alarm cannot match the schedule
+ * @retval -ENOTSUP if CONFIG_RTC_ALARM is disabled
+ */
+int ds3231_schedule_compile(uint16_t id, const struct ds3231_schedule *sched, int64_t now,
+			    struct ds3231_schedule_plan *plan);
+
+/**
+ * @brief Program a recurring alarm
+ *
+ * The alarm fires at each occurrence without a bus transaction, except for a schedule
+ * every few periods. Its next occurrence is programmed while the interrupt is handled,
+ * before the callback, writing only the alarm registers that change. Setting the alarm
+ * otherwise ends the schedule.
+ *
+ * @param dev DS3231 device
+ * @param id Alarm, 0 or 1
+ * @param sched Schedule
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if a field is out of range or the alarm cannot match the schedule
+ * @retval -ENOTSUP without int1-gpios for a schedule every few periods, or if
+ *                  CONFIG_RTC_ALARM is disabled
+ * @retval -EBUSY if CONFIG_RTC_DS3231_VALARM reserves the alarms
+ * @retval -errno on bus error
+ */
+int ds3231_alarm_schedule(const struct device *dev, uint16_t id,
+			  const struct ds3231_schedule *sched);
+
+struct ds3231_async_req;
+
+/**
+ * @brief Completion callback of an asynchronous DS3231 request
+ *
+ * With CONFIG_RTC_DS3231_ASYNC the callback is usually invoked from the I2C controller's
+ * interrupt context, or from the driver's bus work queue on a bus without callback
+ * transfers. It must not call blocking DS3231 functions. It may submit new requests,
+ * including reusing @p req.
+ *
+ * @param dev DS3231 device
+ * @param req Completed request
+ * @param result 0 on success, negative errno on failure
+ * @param user_data User data given on submission
+ */
+typedef void (*ds3231_async_cb_t)(const struct device *dev, struct ds3231_async_req *req,
+				  int result, void *user_data);
+
+/** @cond INTERNAL_HIDDEN */
+#define DS3231_ASYNC_MSGS_MAX 2
+#define DS3231_ASYNC_BUF_SIZE 9
+/** @endcond */
+
+/**
+ * @brief Asynchronous DS3231 request
+ *
+ * Provided by the caller and owned by the driver from submission until the completion
+ * callback is invoked. The contents do not need to be initialized.
+ */
+struct ds3231_async_req {
+	/** Time read by ds3231_get_time_async() */
+	struct rtc_time time;
+	/** Temperature read by ds3231_get_temp_async(), in millidegrees Celsius */
+	int32_t temp_mdegc;
+	/** Result of the request, valid once it completed */
+	int result;
+
+	/** @cond INTERNAL_HIDDEN */
+	sys_snode_t node;
+	ds3231_async_cb_t cb;
+	void *user_data;
+	void (*prepare)(const struct device *dev, struct ds3231_async_req *req);
+	int (*complete)(const struct device *dev, struct ds3231_async_req *req);
+	struct i2c_msg msgs[DS3231_ASYNC_MSGS_MAX];
+	uint8_t num_msgs;
+	uint8_t reg;
+	uint8_t len;
+	uint8_t ctrl_mask;
+	uint8_t ctrl_value;
+	uint8_t clear_flags;
+	bool reload;
+	int64_t seconds;
+	uint8_t buf[DS3231_ASYNC_BUF_SIZE];
+	/* Register address, followed by the values of a write */
+	uint8_t wire[DS3231_ASYNC_BUF_SIZE + 1];
+	int64_t deadline;
+	uint8_t tries;
+#ifdef CONFIG_RTC_DS3231_STATS
+	uint32_t start_cycles;
+	uint8_t op;
+#endif /* CONFIG_RTC_DS3231_STATS */
+	/** @endcond */
+};
+
+/**
+ * @brief Read the time without blocking
+ *
+ * The result is stored in @p req->time. With CONFIG_RTC_DS3231_TIME_CACHE a cache hit
+ * completes before this function returns. Without CONFIG_RTC_DS3231_ASYNC every request
+ * is executed synchronously, and completes before this function returns.
+ *
+ * @param dev DS3231 device
+ * @param req Request to submit
+ * @param cb Completion callback
+ * @param user_data User data passed to @p cb
+ *
+ * @retval 0 if the request was submitted
+ */
+int ds3231_get_time_async(const struct device *dev, struct ds3231_async_req *req,
+			  ds3231_async_cb_t cb, void *user_data);
+
+/**
+ * @brief Set the time without blocking
+ *
+ * @param dev DS3231 device
+ * @param req Request to submit
+ * @param timeptr Time to set, copied into @p req
+ * @param cb Completion callback
+ * @param user_data User data passed to @p cb
+ *
+ * @retval 0 if the request was submitted
+ */
+int ds3231_set_time_async(const struct device *dev, struct ds3231_async_req *req,
+			  const struct rtc_time *timeptr, ds3231_async_cb_t cb, void *user_data);
+
+/**
+ * @brief Program both alarms without blocking, see ds3231_alarms_program()
+ *
+ * @param dev DS3231 device
+ * @param req Request to submit
+ * @param alarm1 Configuration of alarm 1 (id 0)
+ * @param alarm2 Configuration of alarm 2 (id 1)
+ * @param cb Completion callback
+ * @param user_data User data passed to @p cb
+ *
+ * @retval 0 if the request was submitted
+ * @retval -EINVAL if a mask is not supported by the alarm
+ * @retval -ENOTSUP if CONFIG_RTC_ALARM is disabled
+ */
+int ds3231_alarms_program_async(const struct device *dev, struct ds3231_async_req *req,
+				const struct ds3231_alarm_cfg *alarm1,
+				const struct ds3231_alarm_cfg *alarm2, ds3231_async_cb_t cb,
+				void *user_data);
+
+/**
+ * @brief Read the temperature without blocking
+ *
+ * The result is stored in @p req->temp_mdegc. The chip converts the temperature every
+ * 64 seconds, this reads the latest conversion result.
+ *
+ * @param dev DS3231 device
+ * @param req Request to submit
+ * @param cb Completion callback
+ * @param user_data User data passed to @p cb
+ *
+ * @retval 0 if the request was submitted
+ */
+int ds3231_get_temp_async(const struct device *dev, struct ds3231_async_req *req,
+			  ds3231_async_cb_t cb, void *user_data);
+
+/**
+ * @brief Read the latest temperature conversion result
+ *
+ * @param dev DS3231 device
+ * @param temp_mdegc Destination for the temperature, in millidegrees Celsius
+ *
+ * @retval 0 on success
+ * @retval -errno on bus error
+ */
+int ds3231_get_temp(const struct device *dev, int32_t *temp_mdegc);
+
+/** Maximum duration of a temperature conversion, in milliseconds */
+#define DS3231_TEMP_CONV_TIME_MS 200
+
+/**
+ * @brief Force a temperature conversion
+ *
+ * Returns once the conversion is started. The result can be read with ds3231_get_temp()
+ * after at most @ref DS3231_TEMP_CONV_TIME_MS, once ds3231_temp_busy() returns 0.
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 0 if the conversion was started
+ * @retval -EBUSY if a conversion is already running
+ * @retval -errno on bus error
+ */
+int ds3231_temp_convert(const struct device *dev);
+
+/**
+ * @brief Check whether a temperature conversion is running
+ *
+ * Covers both forced conversions and the automatic conversions done every 64 seconds.
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 1 if a conversion is running
+ * @retval 0 if not
+ * @retval -errno on bus error
+ */
+int ds3231_temp_busy(const struct device *dev);
+
+/**
+ * @brief Get the aging offset
+ *
+ * @param dev DS3231 device
+ * @param offset Destination for the offset, in steps of about 0.1 ppm
+ *
+ * @retval 0 on success
+ * @retval -errno on bus error
+ */
+int ds3231_aging_offset_get(const struct device *dev, int8_t *offset);
+
+/**
+ * @brief Set the aging offset
+ *
+ * Positive values slow the oscillator down, by about 0.1 ppm per step at 25 degC. The
+ * chip applies the new value with the next temperature conversion, see
+ * ds3231_temp_convert().
+ *
+ * @param dev DS3231 device
+ * @param offset Aging offset
+ *
+ * @retval 0 on success
+ * @retval -errno on bus error
+ */
+int ds3231_aging_offset_set(const struct device *dev, int8_t offset);
+
+/**
+ * @brief Get the latest 1 Hz square wave edge
+ *
+ * Edges are counted while an update callback is registered, which puts the 1 Hz square
+ * wave on INT/SQW.
+ *
+ * @param dev DS3231 device
+ * @param count Number of edges since the square wave was enabled
+ * @param timestamp_ns System uptime of the latest edge, in nanoseconds
+ *
+ * @retval 0 on success
+ * @retval -EAGAIN if the square wave is off or no edge was seen yet
+ * @retval -ENOTSUP without int1-gpios, CONFIG_RTC_UPDATE or CONFIG_RTC_DS3231_CALIBRATION, or
+ *         when no instance takes update callbacks, see interrupt-mode
+ */
+int ds3231_sqw_edge_get(const struct device *dev, uint32_t *count, int64_t *timestamp_ns);
+
+/** @brief Sub-second RTC time, see ds3231_timestamp_get() */
+struct ds3231_timestamp {
+	/** Unix time in nanoseconds */
+	int64_t ns;
+	/** Estimated error of @ref ns against the RTC, in nanoseconds */
+	uint32_t error_ns;
+	/** Cycle counter frequency measured against the RTC, in Hz */
+	uint32_t cycles_per_sec;
+};
+
+/**
+ * @brief Get the RTC time with sub-second resolution
+ *
+ * Each 1 Hz square wave edge is timestamped with the cycle counter, which is calibrated
+ * against the RTC from successive edges. The time is interpolated from the latest edge,
+ * without bus access, so this may be called from an ISR. Results never go back in time,
+ * unless the time is set. Requires CONFIG_RTC_DS3231_TIMESTAMP, int1-gpios and a
+ * registered update callback, which switches INT/SQW to the square wave.
+ *
+ * @param dev DS3231 device
+ * @param ts Destination for the timestamp
+ *
+ * @retval 0 on success
+ * @retval -EAGAIN if the edges were not yet mapped to RTC time, which takes two edges
+ * after the square wave started or the time was set, or if the edges stopped
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_TIMESTAMP is disabled or there is no int1-gpios
+ */
+int ds3231_timestamp_get(const struct device *dev, struct ds3231_timestamp *ts);
+
+/** @brief Reference the calibration measures the DS3231 against */
+enum ds3231_cal_ref {
+	/** System uptime, against the RTC's seconds edges found over I2C */
+	DS3231_CAL_REF_SYSTEM,
+	/** Timestamps passed to ds3231_cal_sample(), e.g. from GNSS or network time */
+	DS3231_CAL_REF_EXTERNAL,
+	/** 1 Hz square wave edges against system uptime, see ds3231_sqw_edge_get() */
+	DS3231_CAL_REF_SQW,
+};
+
+/**
+ * @brief Aging offset calibration state
+ *
+ * Provided by the caller, one per calibrated device.
+ */
+struct ds3231_cal {
+	/** Latest estimated frequency error in ppb, positive when the RTC runs fast */
+	int32_t error_ppb;
+	/** @ref error_ppb holds a measurement */
+	bool error_valid;
+
+	/** @cond INTERNAL_HIDDEN */
+	const struct device *dev;
+	enum ds3231_cal_ref ref;
+	bool started;
+	int64_t start_rtc_ns;
+	int64_t start_ref_ns;
+	int64_t start_error_ns;
+	/** @endcond */
+};
+
+#if defined(CONFIG_RTC_DS3231_CALIBRATION) || defined(__DOXYGEN__)
+
+/**
+ * @brief Start calibrating a DS3231 against a reference
+ *
+ * With CONFIG_RTC_DS3231_SETTINGS, @ref ds3231_cal.error_ppb starts from the persisted estimate
+ * if it was made with the aging offset the chip runs with.
+ *
+ * @param cal Calibration state
+ * @param dev DS3231 device
+ * @param ref Reference to measure against
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_CALIBRATION is disabled
+ */
+int ds3231_cal_init(struct ds3231_cal *cal, const struct device *dev, enum ds3231_cal_ref ref);
+
+/**
+ * @brief Take a calibration sample
+ *
+ * The first sample starts the measurement. Once CONFIG_RTC_DS3231_CAL_MIN_INTERVAL_S of
+ * reference time elapsed, a sample estimates the frequency error and steps the aging
+ * offset towards zero error by at most CONFIG_RTC_DS3231_CAL_MAX_STEP. After a step the
+ * measurement starts over, so the offset is changed at most once per interval. An error
+ * within the resolution of the measurement leaves the offset as it is.
+ *
+ * Except with #DS3231_CAL_REF_SQW, the RTC is observed at a seconds edge, from
+ * ds3231_timestamp_get() when available or by polling the time registers, so a sample
+ * takes up to two seconds and an external reference time is taken as of the call.
+ *
+ * @param cal Calibration state
+ * @param ref_ns Reference time in nanoseconds with #DS3231_CAL_REF_EXTERNAL, on a
+ *               continuous timescale. Ignored otherwise.
+ *
+ * @retval 0 if the error was estimated
+ * @retval -EAGAIN if the measurement (re)started or the interval is not over yet
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_CALIBRATION is disabled
+ * @retval -errno on bus error
+ */
+int ds3231_cal_sample(struct ds3231_cal *cal, int64_t ref_ns);
+
+#else
+
+static inline int ds3231_cal_init(struct ds3231_cal *cal, const struct device *dev,
+				  enum ds3231_cal_ref ref)
+{
+	ARG_UNUSED(cal);
+	ARG_UNUSED(dev);
+	ARG_UNUSED(ref);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_cal_sample(struct ds3231_cal *cal, int64_t ref_ns)
+{
+	ARG_UNUSED(cal);
+	ARG_UNUSED(ref_ns);
+
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_RTC_DS3231_CALIBRATION */
+
+/** @brief State of the system clock synchronisation, see ds3231_sysclock_status_get() */
+struct ds3231_sysclock_status {
+	/** System minus RTC time measured at the latest sync, in nanoseconds */
+	int64_t offset_ns;
+	/** Part of the latest correction still to be slewed, in nanoseconds */
+	int64_t slew_ns;
+	/** System uptime of the latest sync or write back in milliseconds, 0 before */
+	int64_t last_sync_ms;
+	/** Completed syncs */
+	uint32_t syncs;
+	/** Syncs that stepped the system clock rather than slewing it */
+	uint32_t steps;
+	/** Syncs that failed */
+	uint32_t errors;
+};
+
+#if defined(CONFIG_RTC_DS3231_SYSCLOCK) || defined(__DOXYGEN__)
+
+/**
+ * @brief Synchronise CLOCK_REALTIME to a DS3231
+ *
+ * Called at boot for the first DS3231 instance, call it to switch to another one. The
+ * system clock is seeded from one read of the time, to within half a second. A sync then
+ * starts at once and repeats every CONFIG_RTC_DS3231_SYSCLOCK_INTERVAL_S. Each sync takes
+ * the sub-second RTC time from ds3231_timestamp_get() if available, otherwise it polls the
+ * time registers until the seconds change, which takes up to a second and pins the phase
+ * to a few milliseconds. The first sync steps the system clock, later ones slew offsets up
+ * to CONFIG_RTC_DS3231_SYSCLOCK_STEP_MS at CONFIG_RTC_DS3231_SYSCLOCK_SLEW_PPM. A slewed
+ * correction never moves the system clock back, it slows the clock down instead.
+ *
+ * @param dev DS3231 device
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if @p dev is not ready
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SYSCLOCK is disabled
+ * @retval -ENODATA if the time was never set, the system clock is seeded by a later sync
+ * @retval -errno on bus error, the system clock is seeded by a later sync
+ */
+int ds3231_sysclock_start(const struct device *dev);
+
+/**
+ * @brief Stop synchronising the system clock
+ *
+ * A correction being slewed stops where it is.
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SYSCLOCK is disabled
+ */
+int ds3231_sysclock_stop(void);
+
+/**
+ * @brief Synchronise the system clock now
+ *
+ * Runs the sync on the system work queue, the result is seen in
+ * ds3231_sysclock_status_get(). The next periodic sync follows one interval later.
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if the synchronisation was never started
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SYSCLOCK is disabled
+ */
+int ds3231_sysclock_sync(void);
+
+/**
+ * @brief Get the state of the system clock synchronisation
+ *
+ * @param status Destination for the state
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SYSCLOCK is disabled
+ */
+int ds3231_sysclock_status_get(struct ds3231_sysclock_status *status);
+
+/**
+ * @brief Write the system clock to the DS3231
+ *
+ * Writes the system time with ds3231_set_time_aligned(), so the RTC's second restarts in
+ * phase with the system clock. Blocks for up to one second. Use this after the system clock
+ * was set from a better reference, e.g. network time.
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if the synchronisation was never started
+ * @retval -ENODATA if the system clock was never set
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SYSCLOCK is disabled
+ * @retval -errno on bus error
+ */
+int ds3231_sysclock_write_back(void);
+
+#else
+
+static inline int ds3231_sysclock_start(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_sysclock_stop(void)
+{
+	return -ENOTSUP;
+}
+
+static inline int ds3231_sysclock_sync(void)
+{
+	return -ENOTSUP;
+}
+
+static inline int ds3231_sysclock_status_get(struct ds3231_sysclock_status *status)
+{
+	ARG_UNUSED(status);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_sysclock_write_back(void)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_RTC_DS3231_SYSCLOCK */
+
+/** @brief Calibration and sync state kept across reboots, see ds3231_persist_get() */
+struct ds3231_persist {
+	/** Unix time of the latest known good sync of the RTC, 0 if none */
+	int64_t sync_seconds;
+	/** Estimated frequency error in ppb, positive when the RTC runs fast */
+	int32_t error_ppb;
+	/** @ref error_ppb holds an estimate */
+	bool error_valid;
+	/** Aging offset the chip runs with */
+	int8_t aging_offset;
+	/** Oscillator stops found at boot */
+	uint32_t osf_count;
+	/** @ref sync_seconds before the latest oscillator stop, 0 if none */
+	int64_t osf_sync_seconds;
+	/** The state was loaded at boot and matched the chip */
+	bool restored;
+};
+
+#if defined(CONFIG_RTC_DS3231_SETTINGS) || defined(__DOXYGEN__)
+
+/**
+ * @brief Get the persisted state of a DS3231
+ *
+ * With CONFIG_RTC_DS3231_SETTINGS the state is loaded from the settings subsystem at boot
+ * and checked against one burst read of the chip. If the oscillator stopped, the stop is
+ * counted and a known aging offset, which the chip lost with power, is restored. If the chip
+ * time is before the last sync, the state belongs to another chip and is dropped. An aging
+ * offset changed behind the driver's back drops the error estimate made with the old one.
+ *
+ * @param dev DS3231 device
+ * @param state Destination for the state
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if @p dev is not a DS3231 instance
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SETTINGS is disabled
+ */
+int ds3231_persist_get(const struct device *dev, struct ds3231_persist *state);
+
+/**
+ * @brief Record a known good sync of the RTC
+ *
+ * Call it after setting the RTC from a trusted reference, e.g. network time.
+ * ds3231_sysclock_write_back() records its writes. The state is written at most once every
+ * CONFIG_RTC_DS3231_SETTINGS_MIN_INTERVAL_S.
+ *
+ * @param dev DS3231 device
+ * @param seconds Unix time the RTC was synced to
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if @p dev is not a DS3231 instance
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SETTINGS is disabled
+ */
+int ds3231_persist_sync(const struct device *dev, int64_t seconds);
+
+/**
+ * @brief Record a frequency error estimate
+ *
+ * Records the aging offset along with it. ds3231_cal_sample() records its estimates, and
+ * ds3231_cal_init() starts from the persisted one. The state is written at most once every
+ * CONFIG_RTC_DS3231_SETTINGS_MIN_INTERVAL_S.
+ *
+ * @param dev DS3231 device
+ * @param error_ppb Frequency error in ppb, positive when the RTC runs fast
+ *
+ * @retval 0 on success
+ * @retval -ENODEV if @p dev is not a DS3231 instance
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SETTINGS is disabled
+ * @retval -errno on bus error reading the aging offset
+ */
+int ds3231_persist_error(const struct device *dev, int32_t error_ppb);
+
+/**
+ * @brief Write changed state of all DS3231 instances now
+ *
+ * Bypasses the rate limit, e.g. before a planned power down.
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_SETTINGS is disabled
+ * @retval -errno if the settings subsystem failed to write
+ */
+int ds3231_persist_flush(void);
+
+#else
+
+static inline int ds3231_persist_get(const struct device *dev, struct ds3231_persist *state)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(state);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_persist_sync(const struct device *dev, int64_t seconds)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(seconds);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_persist_error(const struct device *dev, int32_t error_ppb)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(error_ppb);
+
+	return -ENOTSUP;
+}
+
+static inline int ds3231_persist_flush(void)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_RTC_DS3231_SETTINGS */
+
+/** ds3231_group_read() flag, read all registers for the temperature as well */
+#define DS3231_GROUP_TEMP BIT(0)
+
+struct ds3231_group;
+
+/** @brief One device's values from ds3231_group_read() */
+struct ds3231_group_sample {
+	/** Unix time of the time registers */
+	int64_t seconds;
+	/** Temperature of the latest conversion in millidegrees Celsius, with #DS3231_GROUP_TEMP */
+	int32_t temp_mdegc;
+	/** System uptime in the middle of the device's read, in nanoseconds */
+	int64_t uptime_ns;
+	/** 0, -ENODATA if the oscillator stopped since the time was set, or bus error */
+	int err;
+
+	/** @cond INTERNAL_HIDDEN */
+	struct ds3231_async_req req;
+	struct ds3231_group *group;
+	uint8_t regs[DS3231_REG_COUNT];
+	uint16_t order;
+	uint16_t next;
+	/** @endcond */
+};
+
+/**
+ * @brief Devices read together, e.g. a fleet behind I2C muxes
+ *
+ * Provided by the caller and set up with ds3231_group_init().
+ */
+struct ds3231_group {
+	/** @cond INTERNAL_HIDDEN */
+	const struct device *const *devs;
+	struct ds3231_group_sample *samples;
+	uint16_t count;
+	uint32_t flags;
+	bool reverse;
+	struct k_sem done;
+	/** @endcond */
+};
+
+/**
+ * @brief Set up a group of DS3231 devices
+ *
+ * Orders the devices by the controller of their bus, the parent bus of an I2C mux, and
+ * then by bus, so each mux channel is selected once per read.
+ *
+ * @param group Group state
+ * @param devs DS3231 devices, kept by the group
+ * @param samples One sample per device, kept by the group
+ * @param count Number of devices
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if @p count is 0 or too large
+ * @retval -ENODEV if a device is not ready
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_GROUP is disabled
+ */
+int ds3231_group_init(struct ds3231_group *group, const struct device *const *devs,
+		      struct ds3231_group_sample *samples, size_t count);
+
+/**
+ * @brief Read the time of all devices in a group
+ *
+ * Reads each device in one transaction, the time registers or with #DS3231_GROUP_TEMP all
+ * registers, and timestamps it with system uptime. Consecutive reads alternate the order of
+ * the devices, so the mux channel selected last is not switched away from. With
+ * CONFIG_RTC_DS3231_ASYNC the devices on different controllers are read concurrently.
+ * Calls are not to overlap for the same group.
+ *
+ * @param group Group state
+ * @param flags 0 or #DS3231_GROUP_TEMP
+ *
+ * @retval 0 if all devices were read
+ * @retval -errno error of the first failed sample, the others are still valid
+ * @retval -ENOTSUP if CONFIG_RTC_DS3231_GROUP is disabled
+ */
+int ds3231_group_read(struct ds3231_group *group, uint32_t flags);
+
+struct ds3231_valarm;
+
+/**
+ * @brief Virtual alarm callback
+ *
+ * Invoked from the context handling DS3231 interrupts. It may start or cancel virtual
+ * alarms, including @p alarm.
+ *
+ * @param dev DS3231 device
+ * @param alarm Alarm that fired, no longer queued
+ * @param user_data User data given to ds3231_valarm_start()
+ */
+typedef void (*ds3231_valarm_cb_t)(const struct device *dev, struct ds3231_valarm *alarm,
+				   void *user_data);
+
+/**
+ * @brief Virtual alarm
+ *
+ * Provided by the caller and owned by the driver while queued. Must be zero-initialized
+ * before first use.
+ */
+struct ds3231_valarm {
+	/** @cond INTERNAL_HIDDEN */
+	struct rbnode node;
+	int64_t time;
+	ds3231_valarm_cb_t cb;
+	void *user_data;
+	bool queued;
+	/** @endcond */
+};
+
+/**
+ * @brief Start a virtual alarm
+ *
+ * Any number of virtual alarms can be queued, see CONFIG_RTC_DS3231_VALARM. Starting a
+ * queued alarm reschedules it. Insertion takes O(log n).
+ *
+ * @param dev DS3231 device
+ * @param alarm Alarm to start
+ * @param time Time to fire at, in seconds since the Unix epoch
+ * @param cb Callback invoked when the alarm fires
+ * @param user_data User data passed to @p cb
+ *
+ * @retval 0 on success
+ * @retval -EINVAL if @p cb is NULL or @p time is outside 2000 to 2199
+ * @retval -ENOTSUP without int1-gpios or CONFIG_RTC_DS3231_VALARM
+ * @retval -errno on bus error, the alarm is queued nevertheless
+ */
+int ds3231_valarm_start(const struct device *dev, struct ds3231_valarm *alarm, int64_t time,
+			ds3231_valarm_cb_t cb, void *user_data);
+
+/**
+ * @brief Cancel a virtual alarm
+ *
+ * Cancelling an alarm that is not queued does nothing.
+ *
+ * @param dev DS3231 device
+ * @param alarm Alarm to cancel
+ *
+ * @retval 0 on success
+ * @retval -ENOTSUP without int1-gpios or CONFIG_RTC_DS3231_VALARM
+ * @retval -errno on bus error, the alarm is cancelled nevertheless
+ */
+int ds3231_valarm_cancel(const struct device *dev, struct ds3231_valarm *alarm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZEPHYR_INCLUDE_DRIVERS_RTC_DS3231_H_ */
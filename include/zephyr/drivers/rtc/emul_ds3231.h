@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * @brief Backend API of the DS3231 I2C emulator
+ *
+ * Controls the emulated chip and reports the bus traffic the driver caused, so the cost
+ * of each driver API can be checked without hardware.
+ */
+
+#ifndef ZEPHYR_INCLUDE_DRIVERS_RTC_EMUL_DS3231_H_
+#define ZEPHYR_INCLUDE_DRIVERS_RTC_EMUL_DS3231_H_
+
+#include <stdint.h>
+#include <zephyr/drivers/emul.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Bus traffic seen by the emulator */
+struct emul_ds3231_stats {
+	/** I2C transfers, each one START to STOP */
+	uint32_t transactions;
+	/** I2C messages within the transfers */
+	uint32_t messages;
+	/** Bytes written, including register addresses */
+	uint32_t bytes_written;
+	/** Bytes read */
+	uint32_t bytes_read;
+};
+
+/**
+ * @brief Get the bus traffic counters
+ *
+ * @param target Emulator
+ * @param stats Destination for the counters
+ */
+void emul_ds3231_get_stats(const struct emul *target, struct emul_ds3231_stats *stats);
+
+/**
+ * @brief Reset the bus traffic counters
+ *
+ * @param target Emulator
+ */
+void emul_ds3231_reset_stats(const struct emul *target);
+
+/**
+ * @brief Inject a frequency error
+ *
+ * The aging offset register is applied on top, at 0.1 ppm per step.
+ *
+ * @param target Emulator
+ * @param ppb Frequency error in ppb, positive to run fast
+ */
+void emul_ds3231_set_drift(const struct emul *target, int32_t ppb);
+
+/**
+ * @brief Set the temperature reported by the temperature registers
+ *
+ * @param target Emulator
+ * @param temp_mdegc Temperature in millidegrees Celsius, truncated to 0.25 degC steps
+ */
+void emul_ds3231_set_temp(const struct emul *target, int32_t temp_mdegc);
+
+/**
+ * @brief Make transfers take as long as on a real bus
+ *
+ * Each transfer busy-waits for nine SCL periods per byte, including the address byte
+ * after each (repeated) START. Interrupts, and higher priority threads they wake, run
+ * meanwhile and find the transfer in progress.
+ *
+ * @param target Emulator
+ * @param hz SCL frequency, 0 for transfers without delay (the default)
+ */
+void emul_ds3231_set_bus_speed(const struct emul *target, uint32_t hz);
+
+/**
+ * @brief Flag an oscillator stop, as after losing both supplies
+ *
+ * @param target Emulator
+ */
+void emul_ds3231_stop_osc(const struct emul *target);
+
+/**
+ * @brief Make transfers fail
+ *
+ * Failing transfers leave the registers untouched and take the time of one address byte,
+ * as a NACK does.
+ *
+ * @param target Emulator
+ * @param count Number of transfers to fail, UINT32_MAX for all until called again
+ * @param err Error the transfers fail with, e.g. -EIO for a NACK
+ */
+void emul_ds3231_inject_fault(const struct emul *target, uint32_t count, int err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZEPHYR_INCLUDE_DRIVERS_RTC_EMUL_DS3231_H_ */
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Bus traffic per DS3231 driver call, checked against a budget, and the interrupt paths
+ * exercised against the DS3231 emulator.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58, a Thursday */
+static const struct rtc_time start_time = {
+	.tm_sec = 58,
+	.tm_min = 59,
+	.tm_hour = 23,
+	.tm_mday = 29,
+	.tm_mon = 1,
+	.tm_year = 124,
+	.tm_wday = 4,
+	.tm_yday = -1,
+	.tm_isdst = -1,
+};
+
+/* start_time as Unix time */
+static const int64_t start_seconds = INT64_C(1709251198);
+
+static K_SEM_DEFINE(update_sem, 0, K_SEM_MAX_LIMIT);
+static K_SEM_DEFINE(alarm_sem, 0, K_SEM_MAX_LIMIT);
+
+/* The registers as the driver found them at power-on */
+static struct emul_ds3231_stats boot_stats;
+static struct ds3231_reg_dump boot_dump;
+static int boot_dump_err;
+static int boot_get_err;
+
+static void update_cb(const struct device *dev, void *user_data)
+{
+	k_sem_give(&update_sem);
+}
+
+static void alarm_cb(const struct device *dev, uint16_t id, void *user_data)
+{
+	k_sem_give(&alarm_sem);
+}
+
+static int call_get_time(void)
+{
+	struct rtc_time timeptr;
+
+	return rtc_get_time(rtc, &timeptr);
+}
+
+static int call_set_time(void)
+{
+	return rtc_set_time(rtc, &start_time);
+}
+
+static int call_get_epoch_ms(void)
+{
+	int64_t ms;
+
+	return ds3231_get_epoch_ms(rtc, &ms);
+}
+
+static int call_set_epoch(void)
+{
+	return ds3231_set_epoch(rtc, start_seconds);
+}
+
+static int call_alarm_1_set(void)
+{
+	return rtc_alarm_set_time(rtc, 0, RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE,
+				  &start_time);
+}
+
+static int call_alarm_2_set(void)
+{
+	return rtc_alarm_set_time(rtc, 1, RTC_ALARM_TIME_MASK_MINUTE | RTC_ALARM_TIME_MASK_HOUR,
+				  &start_time);
+}
+
+static int call_alarm_1_get(void)
+{
+	struct rtc_time timeptr;
+	uint16_t mask;
+
+	return rtc_alarm_get_time(rtc, 0, &mask, &timeptr);
+}
+
+static int call_alarm_is_pending(void)
+{
+	int ret = rtc_alarm_is_pending(rtc, 0);
+
+	return (ret < 0) ? ret : 0;
+}
+
+static int call_alarms_program(void)
+{
+	const struct ds3231_alarm_cfg alarm1 = {
+		.mask = RTC_ALARM_TIME_MASK_SECOND,
+		.time = start_time,
+		.enable = false,
+	};
+	const struct ds3231_alarm_cfg alarm2 = {
+		.mask = RTC_ALARM_TIME_MASK_MINUTE,
+		.time = start_time,
+		.enable = false,
+	};
+
+	return ds3231_alarms_program(rtc, &alarm1, &alarm2);
+}
+
+static int call_get_temp(void)
+{
+	int32_t temp_mdegc;
+
+	return ds3231_get_temp(rtc, &temp_mdegc);
+}
+
+static int call_temp_convert(void)
+{
+	int ret = ds3231_temp_convert(rtc);
+
+	return (ret == -EBUSY) ? 0 : ret;
+}
+
+static int call_aging_offset_get(void)
+{
+	int8_t offset;
+
+	return ds3231_aging_offset_get(rtc, &offset);
+}
+
+static int call_aging_offset_set(void)
+{
+	static int8_t offset;
+
+	/* A new value each time, an unchanged one is not written */
+	return ds3231_aging_offset_set(rtc, ++offset);
+}
+
+static int call_update_enable(void)
+{
+	return rtc_update_set_callback(rtc, update_cb, NULL);
+}
+
+static int call_update_disable(void)
+{
+	return rtc_update_set_callback(rtc, NULL, NULL);
+}
+
+/* Upper bounds of the traffic of one call, bytes count both directions */
+struct bus_budget {
+	const char *name;
+	int (*call)(void);
+	uint32_t transactions;
+	uint32_t bytes;
+};
+
+static const struct bus_budget budgets[] = {
+	{"rtc_set_time", call_set_time, 1, 8},
+	{"rtc_get_time", call_get_time, 1, 8},
+	{"ds3231_set_epoch", call_set_epoch, 1, 8},
+	{"ds3231_get_epoch_ms", call_get_epoch_ms, 1, 8},
+	{"rtc_alarm_set_time(0)", call_alarm_1_set, 2, 8},
+	{"rtc_alarm_set_time(1)", call_alarm_2_set, 1, 6},
+	{"rtc_alarm_get_time(0)", call_alarm_1_get, 0, 0},
+	{"rtc_alarm_is_pending", call_alarm_is_pending, 0, 0},
+	{"ds3231_alarms_program", call_alarms_program, 1, 10},
+	{"ds3231_get_temp", call_get_temp, 1, 3},
+	{"ds3231_temp_convert", call_temp_convert, 2, 5},
+	{"ds3231_aging_offset_get", call_aging_offset_get, 0, 0},
+	{"ds3231_aging_offset_set", call_aging_offset_set, 1, 2},
+	{"rtc_update_set_callback", call_update_enable, 1, 2},
+	{"rtc_update_set_callback(0)", call_update_disable, 1, 2},
+};
+
+/*
+ * The emulator powers up with the oscillator stop flagged. Init reads the whole register
+ * file once, and the time reads as not set until it is written.
+ */
+ZTEST(ds3231_bus_budget, test_power_on)
+{
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(boot_dump_err, "register dump");
+	zassert_false(boot_dump.time_valid, "oscillator stop flagged at power-on");
+	zassert_equal(boot_stats.transactions, 1, "register dump in one burst");
+	zassert_equal(boot_stats.bytes_written + boot_stats.bytes_read, 20,
+		      "register dump in one burst");
+	zassert_equal(boot_get_err, -ENODATA, "time not valid after power-on");
+
+	zassert_ok(rtc_set_time(rtc, &start_time), "set time");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_true(dump.time_valid, "oscillator stop cleared by setting the time");
+	zassert_equal(dump.seconds, start_seconds, "time set");
+}
+
+ZTEST(ds3231_bus_budget, test_budgets)
+{
+	struct emul_ds3231_stats stats;
+	uint32_t bytes;
+	int err;
+
+	TC_PRINT("%-28s %12s %12s\n", "call", "transactions", "bytes");
+
+	for (size_t i = 0; i < ARRAY_SIZE(budgets); i++) {
+		const struct bus_budget *budget = &budgets[i];
+
+		emul_ds3231_reset_stats(emul);
+		err = budget->call();
+		emul_ds3231_get_stats(emul, &stats);
+		bytes = stats.bytes_written + stats.bytes_read;
+
+		TC_PRINT("%-28s %6u / %-3u %6u / %-3u\n", budget->name, stats.transactions,
+			 budget->transactions, bytes, budget->bytes);
+
+		zassert_ok(err, "%s failed", budget->name);
+		zassert_true(stats.transactions <= budget->transactions,
+			     "%s: %u transactions", budget->name, stats.transactions);
+		zassert_true(bytes <= budget->bytes, "%s: %u bytes", budget->name, bytes);
+	}
+}
+
+/*
+ * The emulator ticks across the leap day, the update callback sees every second and the
+ * edges give sub-second timestamps, which the millisecond time is taken from
+ */
+ZTEST(ds3231_bus_budget, test_update)
+{
+	struct ds3231_timestamp ts;
+	struct rtc_time timeptr;
+	int64_t ms;
+
+	zassert_ok(rtc_update_set_callback(rtc, update_cb, NULL), "update callback");
+
+	k_sem_reset(&update_sem);
+	for (int i = 0; i < 3; i++) {
+		zassert_ok(k_sem_take(&update_sem, K_MSEC(1100)), "update edge %d", i);
+	}
+
+	/* Edges mapped to RTC seconds after the first one, interpolated after the second */
+	zassert_ok(ds3231_timestamp_get(rtc, &ts), "sub-second timestamp");
+	zassert_equal(ts.ns / NSEC_PER_SEC, start_seconds + 3, "timestamp second");
+	zassert_ok(ds3231_get_epoch_ms(rtc, &ms), "get time");
+	zassert_between_inclusive(ms - ts.ns / NSEC_PER_MSEC, 0, 50, "milliseconds interpolated");
+
+	zassert_ok(rtc_update_set_callback(rtc, NULL, NULL), "update callback off");
+
+	zassert_ok(rtc_get_time(rtc, &timeptr), "get time");
+	zassert_true(timeptr.tm_mon == 2 && timeptr.tm_mday == 1 && timeptr.tm_sec == 1,
+		     "rollover to March 1st");
+}
+
+/* Alarm 1 five seconds ahead raises INT, the pending flag is latched without bus traffic */
+ZTEST(ds3231_bus_budget, test_alarm)
+{
+	struct emul_ds3231_stats stats;
+	struct rtc_time alarm_time = start_time;
+
+	alarm_time.tm_sec = 3;
+	alarm_time.tm_min = 0;
+	zassert_ok(rtc_alarm_set_time(rtc, 0,
+				      RTC_ALARM_TIME_MASK_SECOND | RTC_ALARM_TIME_MASK_MINUTE,
+				      &alarm_time),
+		   "alarm set");
+	zassert_ok(rtc_alarm_set_callback(rtc, 0, alarm_cb, NULL), "alarm callback");
+
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(5500)), "alarm interrupt");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_equal(rtc_alarm_is_pending(rtc, 0), 0, "alarm flag consumed by callback");
+	emul_ds3231_get_stats(emul, &stats);
+	zassert_equal(stats.transactions, 0, "alarm pending without bus traffic");
+
+	zassert_ok(rtc_alarm_set_callback(rtc, 0, NULL, NULL), "alarm callback off");
+}
+
+static void *ds3231_bus_budget_setup(void)
+{
+	struct rtc_time timeptr;
+
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	emul_ds3231_reset_stats(emul);
+	boot_dump_err = ds3231_reg_dump(rtc, &boot_dump);
+	emul_ds3231_get_stats(emul, &boot_stats);
+	boot_get_err = rtc_get_time(rtc, &timeptr);
+
+	return NULL;
+}
+
+static void ds3231_bus_budget_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	zassert_ok(rtc_set_time(rtc, &start_time), "set time");
+	k_sem_reset(&update_sem);
+	k_sem_reset(&alarm_sem);
+}
+
+ZTEST_SUITE(ds3231_bus_budget, NULL, ds3231_bus_budget_setup, ds3231_bus_budget_before, NULL,
+	    NULL);
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Aging offset calibration against system uptime, with a frequency error injected into the
+ * DS3231 emulator. The emulator's rate follows the aging offset, so the calibration must
+ * settle on the offset that cancels the injected error and stay there, and leave an RTC
+ * without error alone.
+ */
+
+#include <stdlib.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* Frequency change per aging offset step, as the emulator models it */
+#define PPB_PER_STEP 100
+
+/* Samples are taken this often, several per measurement interval */
+#define SAMPLE_PERIOD_S (CONFIG_RTC_DS3231_CAL_MIN_INTERVAL_S / 4)
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+static struct ds3231_cal cal;
+
+static int8_t aging_offset(void)
+{
+	int8_t offset;
+
+	zassert_ok(ds3231_aging_offset_get(rtc, &offset), "aging offset");
+
+	return offset;
+}
+
+/* Sample until a measurement completes, returns the aging offset after it */
+static int8_t measure(void)
+{
+	int err;
+
+	for (int i = 0; i < 8; i++) {
+		k_sleep(K_SECONDS(SAMPLE_PERIOD_S));
+
+		err = ds3231_cal_sample(&cal, 0);
+		if (err == 0) {
+			TC_PRINT("error %6d ppb, aging offset %4d\n", cal.error_ppb,
+				 aging_offset());
+			return aging_offset();
+		}
+
+		zassert_equal(err, -EAGAIN, "sample failed (err %d)", err);
+	}
+
+	zassert_unreachable("no measurement completed");
+
+	return 0;
+}
+
+/* 10 ppm fast takes an offset of 100, reached in steps of CONFIG_RTC_DS3231_CAL_MAX_STEP */
+ZTEST(ds3231_calibration, test_converge)
+{
+	const int32_t drift_ppb = 10000;
+	const int target = drift_ppb / PPB_PER_STEP;
+	int8_t prev = 0;
+	int8_t offset;
+	int i;
+
+	emul_ds3231_set_drift(emul, drift_ppb);
+
+	for (i = 0; i < 8; i++) {
+		offset = measure();
+		zassert_true(offset >= prev, "offset stepped away from the error");
+		zassert_true(offset - prev <= CONFIG_RTC_DS3231_CAL_MAX_STEP, "step limited");
+
+		if (offset == prev && abs(offset - target) <= 1) {
+			break;
+		}
+
+		prev = offset;
+	}
+
+	zassert_true(i < 8, "calibration did not settle");
+	zassert_within(offset, target, 1, "aging offset %d", offset);
+
+	/* Settled, later measurements keep the offset */
+	for (i = 0; i < 3; i++) {
+		zassert_equal(measure(), offset, "aging offset wandered");
+	}
+
+	zassert_within(cal.error_ppb, drift_ppb - offset * PPB_PER_STEP, PPB_PER_STEP,
+		       "error estimate");
+}
+
+/* Without a frequency error the read resolution alone must not step the offset */
+ZTEST(ds3231_calibration, test_no_error)
+{
+	emul_ds3231_set_drift(emul, 0);
+
+	for (int i = 0; i < 4; i++) {
+		zassert_equal(measure(), 0, "aging offset stepped on noise");
+	}
+
+	zassert_true(cal.error_valid, "error estimated");
+	zassert_within(cal.error_ppb, 0, PPB_PER_STEP, "error estimate");
+}
+
+static void *ds3231_calibration_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	return NULL;
+}
+
+static void ds3231_calibration_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	zassert_ok(ds3231_aging_offset_set(rtc, 0), "aging offset");
+	zassert_ok(ds3231_cal_init(&cal, rtc, DS3231_CAL_REF_SYSTEM), "calibration init");
+}
+
+ZTEST_SUITE(ds3231_calibration, NULL, ds3231_calibration_setup, ds3231_calibration_before, NULL,
+	    NULL);
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Threads of three priorities and a timer ISR share one DS3231, emulated with 100 kHz bus
+ * timing. Two threads set the time and alarm 1 to values of their own, a third reads the
+ * time and temperature, and the ISR reads the snapshot. Per context the call latency is
+ * printed. Afterwards alarm 1 must hold the value of one thread, and no snapshot may mix two
+ * updates.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#define BUS_HZ     100000
+#define RUN_MS     3000
+#define ISR_US     700
+#define STACK_SIZE 2048
+#define TIME_SLACK (RUN_MS / MSEC_PER_SEC + 2)
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* Around the 32 bit boundary, so a torn 64 bit read cannot pass for either value */
+static const int64_t set_times[] = {INT64_C(0xfffffff0), INT64_C(0x100000010)};
+
+/* Call latency of one context, in cycles */
+struct latency {
+	const char *name;
+	uint32_t calls;
+	uint64_t total;
+	uint32_t max;
+};
+
+static struct latency latencies[] = {
+	{"isr: ds3231_snapshot_get"},
+	{"high: set time + alarm 1"},
+	{"mid: set time + alarm 1"},
+	{"low: get time + temp"},
+};
+
+static K_THREAD_STACK_ARRAY_DEFINE(stacks, 3, STACK_SIZE);
+static struct k_thread threads[3];
+
+/* The error each thread stopped on */
+static int thread_errs[3];
+
+static atomic_t stop;
+static atomic_t torn;
+
+static void latency_add(struct latency *latency, uint32_t start)
+{
+	uint32_t cycles = k_cycle_get_32() - start;
+
+	latency->calls++;
+	latency->total += cycles;
+	latency->max = MAX(latency->max, cycles);
+}
+
+static bool snapshot_time_ok(int64_t seconds)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(set_times); i++) {
+		if (seconds >= set_times[i] && seconds <= set_times[i] + TIME_SLACK) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void snapshot_isr(struct k_timer *timer)
+{
+	struct ds3231_snapshot snap;
+	uint32_t start = k_cycle_get_32();
+	int err;
+
+	ARG_UNUSED(timer);
+
+	err = ds3231_snapshot_get(rtc, &snap);
+	latency_add(&latencies[0], start);
+
+	if (err != 0) {
+		return;
+	}
+
+	if (((snap.valid & DS3231_SNAPSHOT_TIME) != 0U && !snapshot_time_ok(snap.seconds)) ||
+	    ((snap.valid & DS3231_SNAPSHOT_TEMP) != 0U && snap.temp_mdegc != 25000)) {
+		atomic_inc(&torn);
+	}
+}
+
+static K_TIMER_DEFINE(snapshot_timer, snapshot_isr, NULL);
+
+/* Thread id sets its own time, and alarm 1 to 11:11 or 22:22 minutes and seconds */
+static void setter(void *p1, void *p2, void *p3)
+{
+	uintptr_t id = (uintptr_t)p1;
+	struct latency *latency = p2;
+	struct rtc_time alarm = {
+		.tm_sec = 11 * (id + 1),
+		.tm_min = 11 * (id + 1),
+	};
+	uint32_t start;
+	int err;
+
+	ARG_UNUSED(p3);
+
+	while (!atomic_get(&stop)) {
+		start = k_cycle_get_32();
+		err = ds3231_set_epoch(rtc, set_times[id]);
+		if (err == 0) {
+			err = rtc_alarm_set_time(rtc, 0,
+						 RTC_ALARM_TIME_MASK_SECOND |
+							 RTC_ALARM_TIME_MASK_MINUTE,
+						 &alarm);
+		}
+		latency_add(latency, start);
+
+		if (err != 0) {
+			thread_errs[id] = err;
+			return;
+		}
+
+		k_usleep(500 * (id + 1));
+	}
+}
+
+static void reader(void *p1, void *p2, void *p3)
+{
+	uintptr_t id = (uintptr_t)p1;
+	struct latency *latency = p2;
+	int32_t temp_mdegc;
+	int64_t seconds;
+	uint32_t start;
+	int err;
+
+	ARG_UNUSED(p3);
+
+	while (!atomic_get(&stop)) {
+		start = k_cycle_get_32();
+		err = ds3231_get_epoch(rtc, &seconds);
+		if (err == 0) {
+			err = ds3231_get_temp(rtc, &temp_mdegc);
+		}
+		latency_add(latency, start);
+
+		if (err != 0) {
+			thread_errs[id] = err;
+			return;
+		}
+
+		k_yield();
+	}
+}
+
+ZTEST(ds3231_contention, test_contention)
+{
+	static const int prios[] = {2, 5, 8};
+	static k_thread_entry_t const entries[] = {setter, setter, reader};
+	struct ds3231_snapshot snap;
+	struct rtc_time alarm;
+	uint16_t mask;
+
+	for (uintptr_t i = 0; i < ARRAY_SIZE(threads); i++) {
+		k_thread_create(&threads[i], stacks[i], K_THREAD_STACK_SIZEOF(stacks[i]),
+				entries[i], (void *)i, &latencies[i + 1], NULL, prios[i], 0,
+				K_NO_WAIT);
+	}
+
+	k_timer_start(&snapshot_timer, K_USEC(ISR_US), K_USEC(ISR_US));
+	k_msleep(RUN_MS);
+	atomic_set(&stop, 1);
+
+	for (size_t i = 0; i < ARRAY_SIZE(threads); i++) {
+		zassert_ok(k_thread_join(&threads[i], K_SECONDS(1)), "thread %u exit", i);
+	}
+	k_timer_stop(&snapshot_timer);
+
+	TC_PRINT("%-28s %8s %10s %10s\n", "context", "calls", "avg us", "max us");
+
+	for (size_t i = 0; i < ARRAY_SIZE(latencies); i++) {
+		const struct latency *latency = &latencies[i];
+		uint32_t avg = (latency->calls != 0U) ? latency->total / latency->calls : 0U;
+
+		TC_PRINT("%-28s %8u %10u %10u\n", latency->name, latency->calls,
+			 k_cyc_to_us_floor32(avg), k_cyc_to_us_floor32(latency->max));
+		zassert_true(latency->calls > 0U, "%s never ran", latency->name);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(thread_errs); i++) {
+		zassert_ok(thread_errs[i], "%s failed", latencies[i + 1].name);
+	}
+
+	/* Alarm 1 holds the value of one thread, its fields were never interleaved */
+	zassert_ok(rtc_alarm_get_time(rtc, 0, &mask, &alarm), "alarm 1");
+	zassert_equal(alarm.tm_sec, alarm.tm_min, "alarm 1 written by one thread");
+	zassert_true(alarm.tm_sec == 11 || alarm.tm_sec == 22, "alarm 1 written by one thread");
+
+	zassert_ok(ds3231_snapshot_get(rtc, &snap), "snapshot");
+	zassert_not_equal(snap.valid & DS3231_SNAPSHOT_TIME, 0U, "snapshot time");
+	zassert_true(snapshot_time_ok(snap.seconds), "snapshot time");
+	zassert_equal(atomic_get(&torn), 0, "no torn snapshot in the ISR");
+}
+
+static void *ds3231_contention_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	emul_ds3231_set_bus_speed(emul, BUS_HZ);
+
+	return NULL;
+}
+
+ZTEST_SUITE(ds3231_contention, NULL, ds3231_contention_setup, NULL, NULL, NULL);
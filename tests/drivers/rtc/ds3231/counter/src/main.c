@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * The DS3231 emulator as a 1 Hz counter with two alarm channels. Relative alarms on both
+ * channels, channel 1 on a minute boundary, an alarm weeks ahead that must not fire on the
+ * earlier date matching it, a late absolute alarm, a cancelled one and an absolute alarm
+ * across the 32-bit wrap in 2106.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct device *const counter = DEVICE_DT_GET(DT_NODELABEL(ds3231_counter));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+/* 2024-04-15 12:00:00, and a month earlier on the same date */
+static const int64_t far_time = INT64_C(1713182400);
+static const int64_t far_early_time = INT64_C(1710504000);
+
+/* 2106-02-07 06:28:10, six seconds before the counter wraps */
+static const int64_t wrap_time = INT64_C(4294967290);
+
+static K_SEM_DEFINE(alarm_sem, 0, K_SEM_MAX_LIMIT);
+static uint32_t alarm_ticks[2];
+
+static void alarm_cb(const struct device *dev, uint8_t chan_id, uint32_t ticks, void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(user_data);
+
+	alarm_ticks[chan_id] = ticks;
+	k_sem_give(&alarm_sem);
+}
+
+static int set_alarm(uint8_t chan_id, uint32_t ticks, uint32_t flags)
+{
+	const struct counter_alarm_cfg cfg = {
+		.callback = alarm_cb,
+		.ticks = ticks,
+		.flags = flags,
+	};
+
+	return counter_set_channel_alarm(counter, chan_id, &cfg);
+}
+
+static void report(const char *name, int err, uint32_t ticks)
+{
+	TC_PRINT("%-24s %6d %12u\n", name, err, ticks);
+}
+
+ZTEST(ds3231_counter, test_channels)
+{
+	zassert_equal(counter_get_num_of_channels(counter), 2, "two channels");
+}
+
+/* Channel 0 fires on its second, channel 1 at the start of the next minute */
+ZTEST(ds3231_counter, test_relative)
+{
+	struct emul_ds3231_stats stats;
+	uint32_t now;
+	int err;
+
+	zassert_ok(counter_get_value(counter, &now), "counter value");
+	zassert_equal(now, start_time, "counter value");
+
+	emul_ds3231_reset_stats(emul);
+	err = set_alarm(0, 3, 0);
+	emul_ds3231_get_stats(emul, &stats);
+	zassert_ok(err, "channel 0 alarm");
+	zassert_equal(stats.transactions, 2, "time read and one alarm write");
+
+	zassert_ok(set_alarm(1, 1, 0), "channel 1 alarm");
+	zassert_equal(set_alarm(0, 5, 0), -EBUSY, "channel 0 busy");
+
+	/* The minute boundary comes first, 2 s after the start */
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(2500)), "channel 1 fired");
+	report("channel 1 +1", 0, alarm_ticks[1]);
+	zassert_equal(alarm_ticks[1], start_time + 2, "channel 1 on the minute");
+
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(1500)), "channel 0 fired");
+	report("channel 0 +3", 0, alarm_ticks[0]);
+	zassert_equal(alarm_ticks[0], start_time + 3, "channel 0 on its second");
+
+	zassert_ok(counter_get_value(counter, &now), "counter value");
+	zassert_true(now >= start_time + 3, "counter advanced");
+}
+
+/* A target weeks ahead matches on an earlier date first, which is not reported */
+ZTEST(ds3231_counter, test_far)
+{
+	int err;
+
+	err = set_alarm(0, far_time, COUNTER_ALARM_CFG_ABSOLUTE);
+	zassert_ok(err, "far alarm");
+
+	zassert_ok(ds3231_set_epoch(rtc, far_early_time - 2), "set time");
+	zassert_not_equal(k_sem_take(&alarm_sem, K_MSEC(3500)), 0, "earlier date ignored");
+
+	zassert_ok(ds3231_set_epoch(rtc, far_time - 2), "set time");
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(3500)), "far alarm fired");
+	report("channel 0 far", err, alarm_ticks[0]);
+	zassert_equal(alarm_ticks[0], far_time, "far alarm on its second");
+}
+
+/* An absolute alarm in the past fails, and expires at once if asked to */
+ZTEST(ds3231_counter, test_late)
+{
+	uint32_t now;
+	int err;
+
+	zassert_ok(counter_get_value(counter, &now), "counter value");
+
+	err = set_alarm(0, now - 10, COUNTER_ALARM_CFG_ABSOLUTE);
+	zassert_equal(err, -ETIME, "late alarm");
+	zassert_not_equal(k_sem_take(&alarm_sem, K_NO_WAIT), 0, "late alarm not fired");
+
+	err = set_alarm(0, now - 10, COUNTER_ALARM_CFG_ABSOLUTE |
+					     COUNTER_ALARM_CFG_EXPIRE_WHEN_LATE);
+	report("channel 0 late", err, alarm_ticks[0]);
+	zassert_equal(err, -ETIME, "late alarm");
+	zassert_ok(k_sem_take(&alarm_sem, K_NO_WAIT), "late alarm expired");
+}
+
+ZTEST(ds3231_counter, test_cancel)
+{
+	zassert_ok(set_alarm(0, 2, 0), "alarm");
+	zassert_ok(counter_cancel_channel_alarm(counter, 0), "cancel");
+	zassert_not_equal(k_sem_take(&alarm_sem, K_MSEC(3000)), 0, "cancelled alarm not fired");
+}
+
+/* A target past the wrap is ahead of a current value just before it */
+ZTEST(ds3231_counter, test_wrap)
+{
+	uint32_t now;
+	int err;
+
+	zassert_ok(ds3231_set_epoch(rtc, wrap_time), "set time");
+	zassert_ok(counter_get_value(counter, &now), "counter value");
+	zassert_equal(now, (uint32_t)wrap_time, "counter value");
+
+	err = set_alarm(0, 2, COUNTER_ALARM_CFG_ABSOLUTE);
+	zassert_ok(err, "alarm across the wrap");
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(9500)), "alarm across the wrap fired");
+	report("channel 0 wrap", err, alarm_ticks[0]);
+	zassert_equal(alarm_ticks[0], 2U, "alarm across the wrap on its second");
+
+	zassert_ok(counter_get_value(counter, &now), "counter value");
+	zassert_true(now >= 2U && now < 10U, "counter wrapped");
+}
+
+static void *ds3231_counter_setup(void)
+{
+	zassert_true(device_is_ready(counter), "device is not ready");
+
+	TC_PRINT("%-24s %6s %12s\n", "case", "result", "ticks");
+
+	return NULL;
+}
+
+static void ds3231_counter_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	(void)counter_cancel_channel_alarm(counter, 0);
+	(void)counter_cancel_channel_alarm(counter, 1);
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	k_sem_reset(&alarm_sem);
+}
+
+ZTEST_SUITE(ds3231_counter, NULL, ds3231_counter_setup, ds3231_counter_before, NULL, NULL);
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Per-instance devicetree settings of the DS3231 emulator. The overlay sets a 1.024 kHz
+ * battery-backed square wave, turns the 32 kHz output off, programs an aging offset, and
+ * leaves the instance without update callbacks and without a time cache. Checks that init
+ * writes them in one transaction, that INT/SQW goes back to the square wave once the alarms
+ * are off, and that the unused code is left out.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* CONTROL, STATUS and AGING_OFFSET, and the bits the overlay sets */
+#define REG_CONTROL       0x0e
+#define REG_STATUS        0x0f
+#define REG_AGING_OFFSET  0x10
+#define CONTROL_BBSQW     BIT(6)
+#define CONTROL_RS1       BIT(3)
+#define CONTROL_INTCN     BIT(2)
+#define CONTROL_A1IE      BIT(0)
+#define STATUS_EN32KHZ    BIT(3)
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* The bus traffic of init, before any test touches the chip */
+static struct emul_ds3231_stats init_stats;
+
+static void update_cb(const struct device *dev, void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(user_data);
+}
+
+static void report(const char *name, const struct ds3231_reg_dump *dump)
+{
+	TC_PRINT("%-16s control 0x%02x status 0x%02x aging %d\n", name, dump->regs[REG_CONTROL],
+		 dump->regs[REG_STATUS], (int8_t)dump->regs[REG_AGING_OFFSET]);
+}
+
+/* The burst read of init and one write of the three registers, nothing else */
+ZTEST(ds3231_dt_config, test_1_init)
+{
+	struct ds3231_reg_dump dump;
+
+	TC_PRINT("%-16s %u transactions, %u bytes written\n", "init", init_stats.transactions,
+		 init_stats.bytes_written);
+	zassert_equal(init_stats.transactions, 2, "burst read and one write");
+	zassert_equal(init_stats.bytes_written, 4, "three registers in one write");
+
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	report("after init", &dump);
+
+	zassert_equal(dump.regs[REG_CONTROL], CONTROL_BBSQW | CONTROL_RS1,
+		      "1.024 kHz square wave");
+	zassert_equal(dump.regs[REG_STATUS] & STATUS_EN32KHZ, 0U, "32 kHz output off");
+	zassert_equal((int8_t)dump.regs[REG_AGING_OFFSET], -5, "aging offset after power loss");
+}
+
+/* An enabled alarm takes INT/SQW, which returns to the square wave with the alarms off */
+ZTEST(ds3231_dt_config, test_2_alarm)
+{
+	const struct rtc_time alarm = {.tm_sec = 30};
+	const struct ds3231_alarm_cfg off = {0};
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(rtc_alarm_set_time(rtc, 0, RTC_ALARM_TIME_MASK_SECOND, &alarm), "alarm");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	report("alarm on", &dump);
+	zassert_equal(dump.regs[REG_CONTROL] & (CONTROL_INTCN | CONTROL_A1IE),
+		      CONTROL_INTCN | CONTROL_A1IE, "alarm interrupt");
+
+	zassert_ok(ds3231_alarms_program(rtc, &off, &off), "alarms off");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	report("alarm off", &dump);
+	zassert_equal(dump.regs[REG_CONTROL], CONTROL_BBSQW | CONTROL_RS1, "square wave again");
+}
+
+/* interrupt-mode "alarm" and time-cache-resync-ms of 0 leave that code out */
+ZTEST(ds3231_dt_config, test_3_unused)
+{
+	struct ds3231_time_cache_stats stats;
+
+	zassert_equal(rtc_update_set_callback(rtc, update_cb, NULL), -ENOSYS,
+		      "no update callbacks");
+	zassert_equal(ds3231_time_cache_get_stats(rtc, &stats), -ENOTSUP, "no time cache");
+}
+
+static void *ds3231_dt_config_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	emul_ds3231_get_stats(emul, &init_stats);
+
+	return NULL;
+}
+
+ZTEST_SUITE(ds3231_dt_config, NULL, ds3231_dt_config_setup, NULL, NULL, NULL);
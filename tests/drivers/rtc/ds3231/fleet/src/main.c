@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * A group of DS3231 emulators on three I2C controllers read with one call. Each device is
+ * read in one transaction and timestamped, consecutive reads alternate the order of the
+ * devices, the temperature comes with the same transaction, and a device whose oscillator
+ * stopped fails on its own.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* The emulators take as long as the bus would */
+#define BUS_HZ      100000
+#define RTC_COUNT   3
+
+/* Not in devicetree order, the group sorts them by bus */
+static const struct device *const rtcs[RTC_COUNT] = {
+	DEVICE_DT_GET(DT_NODELABEL(ds3231_c)),
+	DEVICE_DT_GET(DT_NODELABEL(ds3231_a)),
+	DEVICE_DT_GET(DT_NODELABEL(ds3231_b)),
+};
+
+static const struct emul *const emuls[RTC_COUNT] = {
+	EMUL_DT_GET(DT_NODELABEL(ds3231_c)),
+	EMUL_DT_GET(DT_NODELABEL(ds3231_a)),
+	EMUL_DT_GET(DT_NODELABEL(ds3231_b)),
+};
+
+/* 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+static struct ds3231_group group;
+static struct ds3231_group_sample samples[RTC_COUNT];
+
+static int64_t uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+/* Device read first and last, by timestamp */
+static void read_order(int *first, int *last)
+{
+	*first = 0;
+	*last = 0;
+
+	for (int i = 1; i < RTC_COUNT; i++) {
+		if (samples[i].uptime_ns < samples[*first].uptime_ns) {
+			*first = i;
+		}
+		if (samples[i].uptime_ns > samples[*last].uptime_ns) {
+			*last = i;
+		}
+	}
+}
+
+static void report(const char *name, int err, int64_t start_ns, int64_t end_ns)
+{
+	TC_PRINT("%-16s %6d %8lld us\n", name, err, (end_ns - start_ns) / NSEC_PER_USEC);
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		TC_PRINT("  %-8s %6d %12lld %8d %10lld us\n", rtcs[i]->name, samples[i].err,
+			 samples[i].seconds, samples[i].temp_mdegc,
+			 (samples[i].uptime_ns - start_ns) / NSEC_PER_USEC);
+	}
+}
+
+/* One transaction per device, all timestamped within the call */
+ZTEST(ds3231_fleet, test_time)
+{
+	struct emul_ds3231_stats stats;
+	int64_t start_ns;
+	int64_t end_ns;
+	int err;
+
+	start_ns = uptime_ns();
+	err = ds3231_group_read(&group, 0);
+	end_ns = uptime_ns();
+	report("time", err, start_ns, end_ns);
+
+	zassert_ok(err, "group read");
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		emul_ds3231_get_stats(emuls[i], &stats);
+		zassert_equal(stats.transactions, 1, "one transaction for %s", rtcs[i]->name);
+		zassert_ok(samples[i].err, "time of %s", rtcs[i]->name);
+		zassert_equal(samples[i].seconds, start_time, "time of %s", rtcs[i]->name);
+		zassert_between_inclusive(samples[i].uptime_ns, start_ns, end_ns,
+					  "timestamp of %s within the call", rtcs[i]->name);
+	}
+}
+
+/* The device read last is read first next time, so its mux channel stays selected */
+ZTEST(ds3231_fleet, test_order)
+{
+	int prev_last;
+	int first;
+	int last;
+
+	zassert_ok(ds3231_group_read(&group, 0), "group read");
+	read_order(&first, &prev_last);
+
+	zassert_ok(ds3231_group_read(&group, 0), "group read");
+	read_order(&first, &last);
+
+	TC_PRINT("%-16s %s last, then %s first\n", "order", rtcs[prev_last]->name,
+		 rtcs[first]->name);
+
+	zassert_equal(first, prev_last, "direction alternates");
+}
+
+/* The temperature comes from the same burst as the time */
+ZTEST(ds3231_fleet, test_temp)
+{
+	struct emul_ds3231_stats stats;
+	int64_t start_ns;
+	int64_t end_ns;
+	int err;
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		emul_ds3231_set_temp(emuls[i], 20000 + i * 1000);
+		emul_ds3231_reset_stats(emuls[i]);
+	}
+
+	start_ns = uptime_ns();
+	err = ds3231_group_read(&group, DS3231_GROUP_TEMP);
+	end_ns = uptime_ns();
+	report("time and temp", err, start_ns, end_ns);
+
+	zassert_ok(err, "group read with temperature");
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		emul_ds3231_get_stats(emuls[i], &stats);
+		zassert_equal(stats.transactions, 1, "one transaction for %s", rtcs[i]->name);
+		zassert_equal(samples[i].temp_mdegc, 20000 + i * 1000, "temperature of %s",
+			      rtcs[i]->name);
+	}
+}
+
+/* A stopped oscillator fails its own sample only */
+ZTEST(ds3231_fleet, test_osf)
+{
+	int64_t start_ns;
+	int err;
+
+	emul_ds3231_stop_osc(emuls[1]);
+
+	start_ns = uptime_ns();
+	err = ds3231_group_read(&group, DS3231_GROUP_TEMP);
+	report("stopped device", err, start_ns, uptime_ns());
+
+	zassert_equal(err, -ENODATA, "stopped oscillator reported");
+	zassert_equal(samples[1].err, -ENODATA, "stopped device failed");
+	zassert_ok(samples[0].err, "other devices read");
+	zassert_ok(samples[2].err, "other devices read");
+}
+
+static void *ds3231_fleet_setup(void)
+{
+	zassert_ok(ds3231_group_init(&group, rtcs, samples, RTC_COUNT), "group init");
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		emul_ds3231_set_bus_speed(emuls[i], BUS_HZ);
+	}
+
+	return NULL;
+}
+
+/* Setting the time also clears a stop flagged by an earlier case */
+static void ds3231_fleet_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	for (int i = 0; i < RTC_COUNT; i++) {
+		zassert_ok(ds3231_set_epoch(rtcs[i], start_time), "set time");
+		emul_ds3231_reset_stats(emuls[i]);
+	}
+}
+
+ZTEST_SUITE(ds3231_fleet, NULL, ds3231_fleet_setup, ds3231_fleet_before, NULL, NULL);
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Calibration and sync state of the DS3231 emulator kept in settings on the flash simulator.
+ * Records a sync and a frequency error, writes them, then loses power and loads them back,
+ * checking that the stop is counted once and the aging offset restored, and that a chip set
+ * before the last sync drops the state. The cases build on each other and run in order.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/ztest.h>
+
+/* AGING_OFFSET in the register dump */
+#define REG_AGING_OFFSET 0x10
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58, and a day earlier */
+static const int64_t sync_time = INT64_C(1709251198);
+static const int64_t early_time = INT64_C(1709164798);
+
+static void report(const char *name, const struct ds3231_persist *state)
+{
+	TC_PRINT("%-16s sync %10lld error %6d ppb%s aging %4d stops %u restored %d\n", name,
+		 (long long)state->sync_seconds, state->error_ppb, state->error_valid ? "" : "?",
+		 state->aging_offset, state->osf_count, state->restored);
+}
+
+/* A sync and an estimate, written at once rather than after the rate limit */
+ZTEST(ds3231_persist, test_1_save)
+{
+	struct ds3231_persist state;
+
+	/* The flash simulator may hold the state of an earlier run */
+	zassert_ok(ds3231_persist_get(rtc, &state), "state");
+	report("boot", &state);
+
+	zassert_ok(ds3231_set_epoch(rtc, sync_time), "set time");
+	zassert_ok(ds3231_persist_sync(rtc, sync_time), "sync");
+	zassert_ok(ds3231_aging_offset_set(rtc, 7), "aging offset");
+	zassert_ok(ds3231_persist_error(rtc, 1234), "error estimate");
+	zassert_ok(ds3231_persist_flush(), "flush");
+
+	zassert_ok(ds3231_persist_get(rtc, &state), "state");
+	report("saved", &state);
+	zassert_equal(state.sync_seconds, sync_time, "sync time");
+	zassert_true(state.error_valid, "error estimate");
+	zassert_equal(state.error_ppb, 1234, "error estimate");
+	zassert_equal(state.aging_offset, 7, "aging offset");
+}
+
+/* The chip lost power and its aging offset, loading again counts and repairs it */
+ZTEST(ds3231_persist, test_2_power_loss)
+{
+	struct ds3231_persist before;
+	struct ds3231_persist state;
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(ds3231_persist_get(rtc, &before), "state");
+
+	emul_ds3231_stop_osc(emul);
+	zassert_ok(ds3231_aging_offset_set(rtc, 0), "aging offset lost");
+
+	zassert_ok(settings_load_subtree("ds3231"), "load");
+	zassert_ok(ds3231_persist_get(rtc, &state), "state");
+	report("power loss", &state);
+	zassert_equal(state.osf_count, before.osf_count + 1, "stop counted");
+	zassert_equal(state.osf_sync_seconds, sync_time, "sync before the stop");
+	zassert_true(state.error_valid, "error estimate kept");
+	zassert_equal(state.error_ppb, 1234, "error estimate kept");
+
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_equal((int8_t)dump.regs[REG_AGING_OFFSET], 7, "aging offset restored");
+
+	/* The chip still flags the same stop */
+	zassert_ok(settings_load_subtree("ds3231"), "load");
+	zassert_ok(ds3231_persist_get(rtc, &state), "state");
+	zassert_equal(state.osf_count, before.osf_count + 1, "stop counted once");
+}
+
+/* A chip set before the last sync is not the one the state was learned on */
+ZTEST(ds3231_persist, test_3_other_chip)
+{
+	struct ds3231_persist state;
+
+	zassert_ok(ds3231_set_epoch(rtc, early_time), "set time");
+	zassert_ok(settings_load_subtree("ds3231"), "load");
+
+	zassert_ok(ds3231_persist_get(rtc, &state), "state");
+	report("other chip", &state);
+	zassert_equal(state.sync_seconds, 0, "sync dropped");
+	zassert_false(state.error_valid, "error estimate dropped");
+	zassert_equal(state.aging_offset, 7, "aging offset of the chip");
+
+	zassert_ok(ds3231_persist_flush(), "flush");
+}
+
+static void *ds3231_persist_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	return NULL;
+}
+
+ZTEST_SUITE(ds3231_persist, NULL, ds3231_persist_setup, NULL, NULL, NULL);
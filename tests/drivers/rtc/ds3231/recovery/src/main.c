@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Bus faults injected into the DS3231 emulator, and how the driver copes with them. Short
+ * NACK bursts are retried, persistent ones fail within the retry budget, the time cache
+ * stands in for an unreadable chip and keeps its alignment across resyncs, the milliseconds
+ * set are kept, and a bus held by another thread fails the call at its deadline.
+ */
+
+#include <stdlib.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* Slow enough for one time write to hold the bus far beyond the deadline */
+#define SLOW_BUS_HZ 100
+#define STACK_SIZE  2048
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+static K_THREAD_STACK_DEFINE(holder_stack, STACK_SIZE);
+static struct k_thread holder_thread;
+
+/* Read the time from the chip, returns the call latency in microseconds */
+static uint32_t timed_get(int *err, int64_t *ms)
+{
+	uint32_t start = k_cycle_get_32();
+
+	*err = ds3231_get_epoch_ms(rtc, ms);
+
+	return k_cyc_to_us_floor32(k_cycle_get_32() - start);
+}
+
+static void report(const char *name, int err, uint32_t us, uint32_t transactions)
+{
+	TC_PRINT("%-28s %8d %10u %12u\n", name, err, us, transactions);
+}
+
+/* A burst of NACKs shorter than the retry budget is invisible to the caller */
+ZTEST(ds3231_recovery, test_transient)
+{
+	struct emul_ds3231_stats stats;
+	uint32_t us;
+	int64_t ms;
+	int err;
+
+	emul_ds3231_inject_fault(emul, CONFIG_RTC_DS3231_RETRIES, -EIO);
+
+	us = timed_get(&err, &ms);
+	emul_ds3231_get_stats(emul, &stats);
+	report("transient NACK", err, us, stats.transactions);
+
+	zassert_ok(err, "transient NACK retried");
+	zassert_true(ms / MSEC_PER_SEC >= start_time, "time read");
+	zassert_equal(stats.transactions, CONFIG_RTC_DS3231_RETRIES + 1,
+		      "one attempt per retry");
+	zassert_equal(ds3231_time_cache_stale(rtc), 0, "time read from the chip");
+}
+
+/* A persistent NACK fails after the last retry, well within the deadline */
+ZTEST(ds3231_recovery, test_persistent)
+{
+	struct emul_ds3231_stats stats;
+	uint32_t us;
+	int64_t ms;
+	int err;
+
+	emul_ds3231_inject_fault(emul, UINT32_MAX, -EIO);
+
+	us = timed_get(&err, &ms);
+	emul_ds3231_get_stats(emul, &stats);
+	report("persistent NACK", err, us, stats.transactions);
+
+	zassert_equal(err, -EIO, "persistent NACK fails");
+	zassert_equal(stats.transactions, CONFIG_RTC_DS3231_RETRIES + 1, "retry budget kept");
+	zassert_true(us <= CONFIG_RTC_DS3231_DEADLINE_MS * USEC_PER_MSEC,
+		     "NACK latency %u us", us);
+}
+
+/* With the cache past its resync interval and the chip unreadable, the time is extrapolated */
+ZTEST(ds3231_recovery, test_stale)
+{
+	struct emul_ds3231_stats stats;
+	int64_t fresh_uptime;
+	int64_t fresh_ms;
+	uint32_t us;
+	int64_t ms;
+	int err;
+
+	zassert_ok(ds3231_get_epoch_ms(rtc, &fresh_ms), "fresh read");
+	fresh_uptime = k_uptime_get();
+
+	k_msleep(CONFIG_RTC_DS3231_TIME_CACHE_RESYNC_MS + 100);
+
+	emul_ds3231_reset_stats(emul);
+	emul_ds3231_inject_fault(emul, UINT32_MAX, -EIO);
+
+	us = timed_get(&err, &ms);
+	emul_ds3231_get_stats(emul, &stats);
+	emul_ds3231_inject_fault(emul, 0, 0);
+	report("stale cache", err, us, stats.transactions);
+
+	zassert_ok(err, "stale time returned");
+	zassert_equal(ds3231_time_cache_stale(rtc), 1, "stale time flagged");
+	zassert_true(llabs(ms - fresh_ms - (k_uptime_get() - fresh_uptime)) < MSEC_PER_SEC,
+		     "stale time extrapolated");
+
+	/* The next read past the resync interval reaches the chip again */
+	(void)timed_get(&err, &ms);
+	zassert_ok(err, "fresh read");
+	zassert_equal(ds3231_time_cache_stale(rtc), 0, "fresh again once readable");
+}
+
+/*
+ * Setting the time aligns the cache to the chip's seconds. Resyncs at any point in the second
+ * keep that alignment, and the cached time never goes back.
+ */
+ZTEST(ds3231_recovery, test_resync)
+{
+	int64_t set_uptime;
+	int64_t expected;
+	int64_t last_ms = 0;
+	int64_t ms;
+
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	set_uptime = k_uptime_get();
+
+	/* Resyncs land at a different point in the second each time */
+	for (int i = 0; i < 12; i++) {
+		k_msleep(CONFIG_RTC_DS3231_TIME_CACHE_RESYNC_MS / 4 + 70);
+
+		zassert_ok(ds3231_get_epoch_ms(rtc, &ms), "read %d", i);
+		expected = start_time * MSEC_PER_SEC + k_uptime_get() - set_uptime;
+
+		zassert_true(ms >= last_ms, "read %d went back by %lld ms", i,
+			     (long long)(last_ms - ms));
+		zassert_true(llabs(ms - expected) < 50, "read %d off by %lld ms", i,
+			     (long long)(ms - expected));
+		last_ms = ms;
+	}
+}
+
+/* The second starts on the boundary of the milliseconds set, which the cache reads back */
+ZTEST(ds3231_recovery, test_set_ms)
+{
+	const int64_t set_ms = start_time * MSEC_PER_SEC + 300;
+	int64_t set_uptime = k_uptime_get();
+	int64_t expected;
+	int64_t ms;
+
+	zassert_ok(ds3231_set_epoch_ms(rtc, set_ms), "set time");
+	zassert_true(k_uptime_get() - set_uptime <= MSEC_PER_SEC + 50, "set on the next second");
+
+	zassert_ok(ds3231_get_epoch_ms(rtc, &ms), "get time");
+	expected = set_ms + k_uptime_get() - set_uptime;
+	zassert_true(llabs(ms - expected) < 50, "off by %lld ms", (long long)(ms - expected));
+}
+
+static void holder(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	(void)ds3231_set_epoch(rtc, start_time);
+}
+
+/* Another thread holds the bus far beyond the deadline, the call gives up at the deadline */
+ZTEST(ds3231_recovery, test_deadline)
+{
+	uint32_t us;
+	int64_t ms;
+	int err;
+
+	emul_ds3231_set_bus_speed(emul, SLOW_BUS_HZ);
+	k_thread_create(&holder_thread, holder_stack, K_THREAD_STACK_SIZEOF(holder_stack), holder,
+			NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0, K_NO_WAIT);
+
+	/* Let the holder start its transfer */
+	k_msleep(10);
+
+	(void)ds3231_time_cache_invalidate(rtc);
+	us = timed_get(&err, &ms);
+	report("bus held by another thread", err, us, 0);
+
+	zassert_equal(err, -ETIMEDOUT, "deadline exceeded");
+	zassert_between_inclusive(us, (CONFIG_RTC_DS3231_DEADLINE_MS - 10) * USEC_PER_MSEC,
+				  (CONFIG_RTC_DS3231_DEADLINE_MS + 10) * USEC_PER_MSEC,
+				  "latency bounded by the deadline");
+
+	zassert_ok(k_thread_join(&holder_thread, K_SECONDS(5)), "holder exit");
+}
+
+static void *ds3231_recovery_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	TC_PRINT("%-28s %8s %10s %12s\n", "case", "result", "us", "transactions");
+
+	return NULL;
+}
+
+static void ds3231_recovery_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	(void)ds3231_time_cache_invalidate(rtc);
+	emul_ds3231_reset_stats(emul);
+}
+
+static void ds3231_recovery_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	emul_ds3231_inject_fault(emul, 0, 0);
+	emul_ds3231_set_bus_speed(emul, 0);
+}
+
+ZTEST_SUITE(ds3231_recovery, NULL, ds3231_recovery_setup, ds3231_recovery_before,
+	    ds3231_recovery_after, NULL);
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Recurring alarms compiled onto the DS3231 alarm match modes, against the emulator. Checks
+ * the match mask of each schedule, fires an every-second and a weekly schedule from the
+ * hardware alone, and a schedule every 15 minutes that is re-armed by writing only the
+ * minutes register, skipping the occurrences missed while the interrupt was held up. The
+ * re-arm case compares against the traffic of the weekly one, so the cases run in order.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* Alarm 1 minutes and day/date registers, and the day of the week mode */
+#define REG_ALARM_1_MINUTES 0x08
+#define REG_ALARM_1_DAY     0x0a
+#define ALARM_DYDT          BIT(6)
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* Thursday 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+/* 2024-03-01 00:10:28 and 00:25:28, two seconds before a schedule every 15 minutes at :30 */
+static const int64_t rearm_time = INT64_C(1709251828);
+static const int64_t rearm_next_time = INT64_C(1709252728);
+
+/* 2024-03-01 00:41:00, past the occurrences at 00:25:30 and 00:40:30 */
+static const int64_t rearm_late_time = INT64_C(1709253660);
+
+static K_SEM_DEFINE(alarm_sem, 0, K_SEM_MAX_LIMIT);
+
+/* Holds up the system work queue, which handles the alarm interrupts */
+static K_SEM_DEFINE(release_sem, 0, 1);
+static struct k_work blocker_work;
+
+/* Traffic of an alarm the hardware fires without re-arming */
+static struct emul_ds3231_stats hw_stats;
+
+static void alarm_cb(const struct device *dev, uint16_t id, void *user_data)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(id);
+	ARG_UNUSED(user_data);
+
+	k_sem_give(&alarm_sem);
+}
+
+static void blocker_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	(void)k_sem_take(&release_sem, K_SECONDS(10));
+}
+
+static const struct {
+	const char *name;
+	uint16_t id;
+	struct ds3231_schedule sched;
+	int err;
+	uint16_t mask;
+	uint32_t rearm_s;
+} compile_cases[] = {
+	{"every second", 0, {DS3231_SCHEDULE_EVERY_SECOND}, 0, 0x00, 0},
+	{"minutely :30", 0, {DS3231_SCHEDULE_MINUTELY, .second = 30}, 0, 0x01, 0},
+	{"hourly :15 (2)", 1, {DS3231_SCHEDULE_HOURLY, .minute = 15}, 0, 0x02, 0},
+	{"weekly fri 07:00", 0, {DS3231_SCHEDULE_WEEKLY, .hour = 7, .wday = 5}, 0, 0x47, 0},
+	{"monthly 31st", 0, {DS3231_SCHEDULE_MONTHLY, .mday = 31}, 0, 0x0f, 0},
+	{"every 15 min :30", 0, {DS3231_SCHEDULE_MINUTELY, 15, .second = 30}, 0, 0x03, 900},
+	{"every 2 days", 0, {DS3231_SCHEDULE_DAILY, 2}, 0, 0x0f, 172800},
+	{"every second (2)", 1, {DS3231_SCHEDULE_EVERY_SECOND}, -EINVAL, 0, 0},
+	{"minutely :30 (2)", 1, {DS3231_SCHEDULE_MINUTELY, .second = 30}, -EINVAL, 0, 0},
+	{"every 28 days", 0, {DS3231_SCHEDULE_DAILY, 28}, -EINVAL, 0, 0},
+	{"every 2 months", 0, {DS3231_SCHEDULE_MONTHLY, 2, .mday = 1}, -EINVAL, 0, 0},
+};
+
+/* The match mask of each schedule, RTC_ALARM_TIME_MASK_* */
+ZTEST(ds3231_schedule, test_1_compile)
+{
+	struct ds3231_schedule_plan plan;
+	int err;
+
+	TC_PRINT("%-20s %6s %6s %8s\n", "schedule", "result", "mask", "rearm s");
+
+	for (size_t i = 0; i < ARRAY_SIZE(compile_cases); i++) {
+		err = ds3231_schedule_compile(compile_cases[i].id, &compile_cases[i].sched,
+					      start_time, &plan);
+		TC_PRINT("%-20s %6d 0x%04x %8u\n", compile_cases[i].name, err,
+			 err == 0 ? plan.mask : 0U, err == 0 ? plan.rearm_s : 0U);
+
+		zassert_equal(err, compile_cases[i].err, "%s: result", compile_cases[i].name);
+		if (err == 0) {
+			zassert_equal(plan.mask, compile_cases[i].mask, "%s: mask",
+				      compile_cases[i].name);
+			zassert_equal(plan.rearm_s, compile_cases[i].rearm_s, "%s: re-arm interval",
+				      compile_cases[i].name);
+		}
+	}
+}
+
+/* Alarm 1 with all fields ignored fires every second */
+ZTEST(ds3231_schedule, test_2_every_second)
+{
+	const struct ds3231_schedule sched = {DS3231_SCHEDULE_EVERY_SECOND};
+	int fired = 0;
+
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	zassert_ok(ds3231_alarm_schedule(rtc, 0, &sched), "every second");
+
+	while (fired < 3 && k_sem_take(&alarm_sem, K_MSEC(1500)) == 0) {
+		fired++;
+	}
+
+	TC_PRINT("%-20s %6d fired\n", "every second", fired);
+	zassert_equal(fired, 3, "fired every second");
+}
+
+/* The day register in day of the week mode, no writes when the alarm fires */
+ZTEST(ds3231_schedule, test_3_weekly)
+{
+	const struct ds3231_schedule sched = {DS3231_SCHEDULE_WEEKLY, .wday = 5};
+	struct ds3231_reg_dump dump;
+	struct rtc_time now;
+
+	zassert_ok(ds3231_set_epoch(rtc, start_time), "set time");
+	zassert_ok(ds3231_alarm_schedule(rtc, 0, &sched), "weekly");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_not_equal(dump.regs[REG_ALARM_1_DAY] & ALARM_DYDT, 0U, "day of the week mode");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(2500)), "weekly fired");
+	emul_ds3231_get_stats(emul, &hw_stats);
+
+	zassert_ok(rtc_get_time(rtc, &now), "get time");
+	zassert_equal(now.tm_wday, 5, "fired on friday");
+	TC_PRINT("%-20s %6u transactions, %u bytes written\n", "weekly", hw_stats.transactions,
+		 hw_stats.bytes_written);
+}
+
+/* Each occurrence programs the next one, only the minutes register changes */
+ZTEST(ds3231_schedule, test_4_rearm)
+{
+	const struct ds3231_schedule sched = {DS3231_SCHEDULE_MINUTELY, 15, .second = 30};
+	struct emul_ds3231_stats stats;
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(ds3231_set_epoch(rtc, rearm_time), "set time");
+	zassert_ok(ds3231_alarm_schedule(rtc, 0, &sched), "every 15 minutes");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(2500)), "00:10:30 fired");
+	emul_ds3231_get_stats(emul, &stats);
+
+	TC_PRINT("%-20s %6u transactions, %u bytes written\n", "every 15 minutes",
+		 stats.transactions, stats.bytes_written);
+	zassert_equal(stats.transactions, hw_stats.transactions + 2,
+		      "one time read and one re-arm write");
+	zassert_equal(stats.bytes_written, hw_stats.bytes_written + 3,
+		      "time read address and minutes register only");
+
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_equal(dump.regs[REG_ALARM_1_MINUTES], 0x25, "re-armed for 00:25:30");
+
+	zassert_ok(ds3231_set_epoch(rtc, rearm_next_time), "set time");
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(2500)), "00:25:30 fired");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_equal(dump.regs[REG_ALARM_1_MINUTES], 0x40, "re-armed for 00:40:30");
+}
+
+/* An interrupt handled after later occurrences passed re-arms for the next one still ahead */
+ZTEST(ds3231_schedule, test_5_missed)
+{
+	const struct ds3231_schedule sched = {DS3231_SCHEDULE_MINUTELY, 15, .second = 30};
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(ds3231_set_epoch(rtc, rearm_time), "set time");
+	zassert_ok(ds3231_alarm_schedule(rtc, 0, &sched), "every 15 minutes");
+
+	/* 00:10:30 matches while the interrupt waits, then the time moves past two more */
+	k_work_submit(&blocker_work);
+	k_msleep(2500);
+	zassert_ok(ds3231_set_epoch(rtc, rearm_late_time), "set time");
+	k_sem_give(&release_sem);
+
+	zassert_ok(k_sem_take(&alarm_sem, K_MSEC(1000)), "late 00:10:30 handled");
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	zassert_equal(dump.regs[REG_ALARM_1_MINUTES], 0x55, "re-armed for 00:55:30");
+}
+
+static void *ds3231_schedule_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+	zassert_ok(rtc_alarm_set_callback(rtc, 0, alarm_cb, NULL), "alarm callback");
+	k_work_init(&blocker_work, blocker_handler);
+
+	return NULL;
+}
+
+static void ds3231_schedule_after(void *fixture)
+{
+	const struct ds3231_alarm_cfg off = {0};
+
+	ARG_UNUSED(fixture);
+
+	zassert_ok(ds3231_alarms_program(rtc, &off, &off), "alarms off");
+	k_sem_reset(&alarm_sem);
+}
+
+ZTEST_SUITE(ds3231_schedule, NULL, ds3231_schedule_setup, NULL, ds3231_schedule_after, NULL);
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * CLOCK_REALTIME kept in sync with the DS3231 emulator. The first sync steps the system clock
+ * onto the RTC's seconds edge, a drifted RTC is followed by slewing, without the clock going
+ * back when the RTC fell behind, a large jump is stepped,
+ * and the system time is written back on its second boundary. A reference time is set on its
+ * second boundary over a 100 kHz bus, with the write latency compensated. Each case starts
+ * from the clock state the previous one left, so they run in order.
+ */
+
+#include <stdlib.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/posix/time.h>
+#include <zephyr/ztest.h>
+
+/* Seconds edges are found by polling every few milliseconds */
+#define PHASE_TOLERANCE_NS (5 * NSEC_PER_MSEC)
+
+/* An aligned write lands within this of the reference's second boundary */
+#define ALIGN_TOLERANCE_NS (1 * NSEC_PER_MSEC)
+#define BUS_HZ             100000
+
+/* The RTC gains DRIFT_PPB * DRIFT_MS / 10^9 ms while drifting, 20 ms */
+#define DRIFT_PPB 5000000
+#define DRIFT_MS  4000
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:58 */
+static const int64_t start_time = INT64_C(1709251198);
+
+/* RTC time in ns is rtc_base_ns plus uptime while the emulator does not drift */
+static int64_t rtc_base_ns;
+
+static int64_t uptime_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
+
+static int64_t system_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* The emulator restarts its second when the time is written */
+static void set_rtc(int64_t seconds)
+{
+	zassert_ok(ds3231_set_epoch(rtc, seconds), "set time");
+	rtc_base_ns = seconds * NSEC_PER_SEC - uptime_ns();
+}
+
+/* Run a sync and wait for its result */
+static void sync_wait(struct ds3231_sysclock_status *status)
+{
+	struct ds3231_sysclock_status before;
+
+	(void)ds3231_sysclock_status_get(&before);
+	zassert_ok(ds3231_sysclock_sync(), "sync");
+
+	for (int i = 0; i < 30; i++) {
+		k_msleep(100);
+		(void)ds3231_sysclock_status_get(status);
+		if (status->syncs != before.syncs || status->errors != before.errors) {
+			break;
+		}
+	}
+
+	zassert_equal(status->syncs, before.syncs + 1, "sync completed");
+}
+
+static void report(const char *name, const struct ds3231_sysclock_status *status)
+{
+	TC_PRINT("%-20s %12lld %12lld %8u\n", name, status->offset_ns / NSEC_PER_USEC,
+		 (system_ns() - (rtc_base_ns + uptime_ns())) / NSEC_PER_USEC, status->steps);
+}
+
+/* The emulator powers up with the oscillator stop flagged, so the boot seed failed */
+ZTEST(ds3231_sysclock, test_1_first_sync)
+{
+	struct ds3231_sysclock_status status;
+
+	set_rtc(start_time);
+	sync_wait(&status);
+	report("first sync", &status);
+
+	zassert_equal(status.steps, 1, "first sync steps");
+	zassert_true(llabs(system_ns() - (rtc_base_ns + uptime_ns())) < PHASE_TOLERANCE_NS,
+		     "system clock on the RTC's edge");
+}
+
+/* Reading the system clock costs no bus traffic */
+ZTEST(ds3231_sysclock, test_2_reads)
+{
+	struct emul_ds3231_stats stats;
+	int64_t prev = 0;
+	int64_t now;
+
+	emul_ds3231_reset_stats(emul);
+	for (int i = 0; i < 1000; i++) {
+		now = system_ns();
+		zassert_true(now >= prev, "system clock monotonic between syncs");
+		prev = now;
+	}
+	emul_ds3231_get_stats(emul, &stats);
+
+	TC_PRINT("%-20s %12u transactions\n", "1000 reads", stats.transactions);
+	zassert_equal(stats.transactions, 0, "reads without bus traffic");
+}
+
+/* An RTC that gained a few milliseconds is followed by slewing, not stepping */
+ZTEST(ds3231_sysclock, test_3_slew)
+{
+	struct ds3231_sysclock_status status;
+	uint32_t steps;
+	int64_t gain;
+
+	(void)ds3231_sysclock_status_get(&status);
+	steps = status.steps;
+
+	emul_ds3231_set_drift(emul, DRIFT_PPB);
+	k_msleep(DRIFT_MS);
+	emul_ds3231_set_drift(emul, 0);
+	gain = (int64_t)DRIFT_PPB * DRIFT_MS / MSEC_PER_SEC;
+	rtc_base_ns += gain;
+
+	sync_wait(&status);
+	report("drifted RTC", &status);
+
+	zassert_equal(status.steps, steps, "small offset slewed");
+	zassert_true(llabs(status.offset_ns + gain) < PHASE_TOLERANCE_NS, "drift measured");
+
+	/* 20 ms at 10000 ppm take 2 s */
+	k_msleep(3000);
+	sync_wait(&status);
+	report("after slewing", &status);
+
+	zassert_equal(status.steps, steps, "no step after slewing");
+	zassert_true(llabs(status.offset_ns) < PHASE_TOLERANCE_NS, "drift slewed out");
+}
+
+/* An RTC that lost a few milliseconds is followed by slowing the clock, never going back */
+ZTEST(ds3231_sysclock, test_3_slew_back)
+{
+	struct ds3231_sysclock_status status;
+	int64_t prev = 0;
+	uint32_t steps;
+	int64_t loss;
+	int64_t now;
+
+	(void)ds3231_sysclock_status_get(&status);
+	steps = status.steps;
+
+	emul_ds3231_set_drift(emul, -DRIFT_PPB);
+	k_msleep(DRIFT_MS);
+	emul_ds3231_set_drift(emul, 0);
+	loss = (int64_t)DRIFT_PPB * DRIFT_MS / MSEC_PER_SEC;
+	rtc_base_ns -= loss;
+
+	sync_wait(&status);
+	report("RTC fell behind", &status);
+
+	zassert_equal(status.steps, steps, "small offset slewed");
+	zassert_true(llabs(status.offset_ns - loss) < PHASE_TOLERANCE_NS, "loss measured");
+
+	/* 20 ms at 10000 ppm take 2 s, the clock is read throughout */
+	for (int64_t end = k_uptime_get() + 3000; k_uptime_get() < end;) {
+		now = system_ns();
+		zassert_true(now >= prev, "clock went back by %lld ns", (long long)(prev - now));
+		prev = now;
+		k_usleep(200);
+	}
+
+	sync_wait(&status);
+	report("after slewing", &status);
+
+	zassert_equal(status.steps, steps, "no step after slewing");
+	zassert_true(llabs(status.offset_ns) < PHASE_TOLERANCE_NS, "loss slewed out");
+}
+
+/* A jump beyond CONFIG_RTC_DS3231_SYSCLOCK_STEP_MS is stepped */
+ZTEST(ds3231_sysclock, test_4_step)
+{
+	struct ds3231_sysclock_status status;
+	uint32_t steps;
+
+	(void)ds3231_sysclock_status_get(&status);
+	steps = status.steps;
+
+	set_rtc(start_time + 3600);
+	sync_wait(&status);
+	report("RTC set ahead", &status);
+
+	zassert_equal(status.steps, steps + 1, "large offset stepped");
+	zassert_true(llabs(system_ns() - (rtc_base_ns + uptime_ns())) < PHASE_TOLERANCE_NS,
+		     "system clock follows the RTC");
+}
+
+/* A reference time with sub-second precision is set on its second boundary */
+ZTEST(ds3231_sysclock, test_5_aligned)
+{
+	struct ds3231_align_result res = {0};
+	int64_t ref_uptime_ns;
+	int64_t ref_ns;
+	int err;
+
+	emul_ds3231_set_bus_speed(emul, BUS_HZ);
+
+	/* E.g. a GNSS time 300 ms into a second */
+	ref_uptime_ns = uptime_ns();
+	ref_ns = (start_time + 10800) * NSEC_PER_SEC + 300 * NSEC_PER_MSEC;
+
+	err = ds3231_set_time_aligned(rtc, ref_ns, ref_uptime_ns, &res);
+	emul_ds3231_set_bus_speed(emul, 0);
+	TC_PRINT("%-20s phase %lld +- %u us, write latency %lld us\n", "aligned set",
+		 res.phase_ns / NSEC_PER_USEC, res.phase_error_ns / NSEC_PER_USEC,
+		 res.latency_ns / NSEC_PER_USEC);
+
+	zassert_ok(err, "aligned set");
+	zassert_true(res.latency_ns > 0, "write latency measured");
+	zassert_true(llabs(res.phase_ns) < ALIGN_TOLERANCE_NS, "RTC on the reference's edge");
+}
+
+/* A system time from another reference is written to the chip on its second boundary */
+ZTEST(ds3231_sysclock, test_6_write_back)
+{
+	struct ds3231_sysclock_status status;
+	struct timespec ts = {
+		.tv_sec = start_time + 7200,
+		.tv_nsec = 300 * NSEC_PER_MSEC,
+	};
+	uint32_t steps;
+	int64_t base;
+
+	(void)clock_settime(CLOCK_REALTIME, &ts);
+	base = system_ns() - uptime_ns();
+
+	zassert_ok(ds3231_sysclock_write_back(), "write back");
+	rtc_base_ns = base;
+
+	(void)ds3231_sysclock_status_get(&status);
+	steps = status.steps;
+
+	sync_wait(&status);
+	report("written back", &status);
+
+	zassert_equal(status.steps, steps, "written back in phase");
+	zassert_true(llabs(status.offset_ns) < PHASE_TOLERANCE_NS, "RTC on the system's edge");
+}
+
+static void *ds3231_sysclock_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	TC_PRINT("%-20s %12s %12s %8s\n", "case", "offset us", "error us", "steps");
+
+	return NULL;
+}
+
+ZTEST_SUITE(ds3231_sysclock, NULL, ds3231_sysclock_setup, NULL, NULL, NULL);
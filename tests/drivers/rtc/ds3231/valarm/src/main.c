@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2024 Arribada Initiative CIC
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Virtual alarms queued on the DS3231 emulator. Several alarms fire in time order with one
+ * cancelled, alarm 1 is re-armed only when the earliest alarm changes, a missed match is
+ * caught by the alarm 2 fallback at the next full minute, and a match a month early is
+ * ignored. The time_cache variant checks that a cached time lagging the chip does not hold
+ * an alarm back until the fallback.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/rtc/ds3231.h>
+#include <zephyr/drivers/rtc/emul_ds3231.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+/* Alarm 1 seconds and minutes registers */
+#define REG_ALARM_1_SECONDS 0x07
+#define REG_ALARM_1_MINUTES 0x08
+
+/* Arming writes the address, both alarms, CONTROL and STATUS; a time read one address byte */
+#define ARM_BYTES        10
+#define TIME_READ_BYTES  7
+
+#define ALARM_COUNT 4
+
+static const struct device *const rtc = DEVICE_DT_GET(DT_NODELABEL(ds3231));
+static const struct emul *const emul = EMUL_DT_GET(DT_NODELABEL(ds3231));
+
+/* 2024-02-29 23:59:10, clear of the minute boundaries alarm 2 fires on */
+static const int64_t base_time = INT64_C(1709251150);
+
+/* 2024-02-29 23:59:30 */
+static const int64_t fallback_time = INT64_C(1709251170);
+
+/* 2024-04-15 12:00:00, and a month earlier on the same date */
+static const int64_t far_time = INT64_C(1713182400);
+static const int64_t far_early_time = INT64_C(1710504000);
+
+static struct ds3231_valarm alarms[ALARM_COUNT];
+
+static K_SEM_DEFINE(fired_sem, 0, K_SEM_MAX_LIMIT);
+static struct ds3231_valarm *fired[ALARM_COUNT];
+static atomic_t fired_count;
+
+static void valarm_cb(const struct device *dev, struct ds3231_valarm *alarm, void *user_data)
+{
+	atomic_val_t n = atomic_inc(&fired_count);
+
+	ARG_UNUSED(dev);
+	ARG_UNUSED(user_data);
+
+	if (n < ALARM_COUNT) {
+		fired[n] = alarm;
+	}
+
+	k_sem_give(&fired_sem);
+}
+
+static uint8_t bcd(int value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+/* Alarm 1 writes since the stats were reset, time reads of dispatching aside */
+static uint32_t arm_writes(void)
+{
+	struct emul_ds3231_stats stats;
+	uint32_t reads;
+
+	/* Let a dispatch started by a new earliest alarm finish */
+	k_msleep(50);
+	emul_ds3231_get_stats(emul, &stats);
+
+	reads = stats.bytes_read / TIME_READ_BYTES;
+	zassert_equal((stats.bytes_written - reads) % ARM_BYTES, 0U, "unexpected writes");
+
+	return (stats.bytes_written - reads) / ARM_BYTES;
+}
+
+static void start(int i, int64_t time)
+{
+	zassert_ok(ds3231_valarm_start(rtc, &alarms[i], time, valarm_cb, NULL), "start %d", i);
+}
+
+/* The alarm that fires next, and the RTC time it fired at as read from the chip */
+static struct ds3231_valarm *wait_fired(k_timeout_t timeout, int64_t *now)
+{
+	atomic_val_t n = atomic_get(&fired_count);
+	struct ds3231_reg_dump dump;
+
+	zassert_ok(k_sem_take(&fired_sem, timeout), "alarm %d fired", (int)n);
+	zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+	*now = dump.seconds;
+
+	return fired[n];
+}
+
+/* Queued out of order with one cancelled, they fire in time order and re-arm alarm 1 */
+ZTEST(ds3231_valarm, test_order)
+{
+	static const int64_t offsets[] = {5, 2, 8, 3};
+	static const int order[] = {1, 0, 2};
+	struct ds3231_reg_dump dump;
+	struct ds3231_valarm *alarm;
+	int64_t due;
+	int64_t now;
+
+	for (int i = 0; i < ALARM_COUNT; i++) {
+		start(i, base_time + offsets[i]);
+	}
+	zassert_ok(ds3231_valarm_cancel(rtc, &alarms[3]), "cancel");
+
+	for (int i = 0; i < ARRAY_SIZE(order); i++) {
+		alarm = wait_fired(K_SECONDS(4), &now);
+		due = base_time + offsets[order[i]];
+
+		TC_PRINT("alarm %d due %lld fired %lld\n", (int)(alarm - alarms), (long long)due,
+			 (long long)now);
+		zassert_equal_ptr(alarm, &alarms[order[i]], "firing order");
+		zassert_between_inclusive(now, due, due + 1, "fired on its second");
+
+		/* Alarm 1 holds the next one, if any */
+		if (i + 1 < ARRAY_SIZE(order)) {
+			due = base_time + offsets[order[i + 1]];
+			zassert_ok(ds3231_reg_dump(rtc, &dump), "register dump");
+			zassert_equal(dump.regs[REG_ALARM_1_SECONDS], bcd(due % 60), "re-armed");
+			zassert_equal(dump.regs[REG_ALARM_1_MINUTES], bcd(due / 60 % 60),
+				      "re-armed");
+		}
+	}
+
+	zassert_not_equal(k_sem_take(&fired_sem, K_SECONDS(2)), 0, "cancelled alarm fired");
+	zassert_equal(atomic_get(&fired_count), ARRAY_SIZE(order), "alarms fired once");
+}
+
+/* Alarm 1 is written only when the earliest alarm changes */
+ZTEST(ds3231_valarm, test_rearm_writes)
+{
+	struct emul_ds3231_stats stats;
+
+	emul_ds3231_reset_stats(emul);
+	start(0, base_time + 30);
+	zassert_equal(arm_writes(), 1, "first alarm armed");
+
+	emul_ds3231_reset_stats(emul);
+	start(1, base_time + 40);
+	emul_ds3231_get_stats(emul, &stats);
+	zassert_equal(stats.transactions, 0, "later alarm queued without bus traffic");
+
+	emul_ds3231_reset_stats(emul);
+	start(2, base_time + 20);
+	zassert_equal(arm_writes(), 1, "new earliest alarm armed");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_ok(ds3231_valarm_cancel(rtc, &alarms[1]), "cancel");
+	zassert_ok(ds3231_valarm_cancel(rtc, &alarms[3]), "cancel unqueued");
+	emul_ds3231_get_stats(emul, &stats);
+	zassert_equal(stats.transactions, 0, "later alarms cancelled without bus traffic");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_ok(ds3231_valarm_cancel(rtc, &alarms[2]), "cancel");
+	zassert_equal(arm_writes(), 1, "next alarm armed");
+
+	emul_ds3231_reset_stats(emul);
+	zassert_ok(ds3231_valarm_cancel(rtc, &alarms[0]), "cancel");
+	zassert_equal(arm_writes(), 1, "alarms disarmed");
+}
+
+/* The time jumps past an alarm, alarm 2 catches it at the next full minute */
+ZTEST(ds3231_valarm, test_fallback)
+{
+	struct ds3231_valarm *alarm;
+	int64_t now;
+
+	zassert_ok(ds3231_set_epoch(rtc, fallback_time), "set time");
+	start(0, fallback_time + 5);
+	zassert_ok(ds3231_set_epoch(rtc, fallback_time + 10), "set time");
+
+	/* 20 s until 00:00:00 */
+	zassert_not_equal(k_sem_take(&fired_sem, K_SECONDS(15)), 0, "fired before the minute");
+
+	alarm = wait_fired(K_SECONDS(10), &now);
+	zassert_equal_ptr(alarm, &alarms[0], "missed alarm fired");
+	zassert_true(now >= fallback_time + 30, "fired at the full minute");
+}
+
+/* Alarm 1 matches a month early on the same date and time, which is not reported */
+ZTEST(ds3231_valarm, test_early_match)
+{
+	struct ds3231_valarm *alarm;
+	int64_t now;
+
+	start(0, far_time);
+
+	zassert_ok(ds3231_set_epoch(rtc, far_early_time - 2), "set time");
+	zassert_not_equal(k_sem_take(&fired_sem, K_MSEC(3500)), 0, "earlier date ignored");
+
+	zassert_ok(ds3231_set_epoch(rtc, far_time - 2), "set time");
+	alarm = wait_fired(K_MSEC(3500), &now);
+	zassert_equal_ptr(alarm, &alarms[0], "far alarm fired");
+	zassert_between_inclusive(now, far_time, far_time + 1, "fired on its second");
+}
+
+/*
+ * The cache is anchored by a read late in the second and lags the chip by most of a second.
+ * Dispatching reads the chip, so the alarm fires when alarm 1 matches and not a minute later.
+ */
+ZTEST(ds3231_valarm, test_cached_time)
+{
+	const int64_t due = base_time + 2;
+	struct ds3231_valarm *alarm;
+	int64_t now;
+
+	/* -ENOTSUP without the cache, where the reads below go to the chip */
+	(void)ds3231_time_cache_invalidate(rtc);
+	k_msleep(900);
+	zassert_ok(ds3231_get_epoch(rtc, &now), "get time");
+	zassert_equal(now, base_time, "read late in the first second");
+
+	start(0, due);
+	alarm = wait_fired(K_MSEC(2500), &now);
+	zassert_equal_ptr(alarm, &alarms[0], "alarm fired");
+	zassert_between_inclusive(now, due, due + 1, "fired on its second");
+}
+
+static void *ds3231_valarm_setup(void)
+{
+	zassert_true(device_is_ready(rtc), "device is not ready");
+
+	return NULL;
+}
+
+static void ds3231_valarm_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	for (int i = 0; i < ALARM_COUNT; i++) {
+		zassert_ok(ds3231_valarm_cancel(rtc, &alarms[i]), "cancel");
+	}
+
+	zassert_ok(ds3231_set_epoch(rtc, base_time), "set time");
+	k_sem_reset(&fired_sem);
+	atomic_clear(&fired_count);
+}
+
+ZTEST_SUITE(ds3231_valarm, NULL, ds3231_valarm_setup, ds3231_valarm_before, NULL, NULL);